@@ -13,6 +13,10 @@
 #include "air/Dialect/AIR/AIRDialect.h"
 #include "mlir/Pass/Pass.h"
 
+#include "llvm/ADT/DenseSet.h"
+
+#include <map>
+
 using namespace mlir;
 
 namespace xilinx {
@@ -47,6 +51,9 @@ bool areIdenticalVectors(std::vector<unsigned> &a, std::vector<unsigned> &b);
 int64_t get1DOffset(SmallVector<Value> memcpy_offsets,
                     SmallVector<Value> memcpy_strides);
 
+// Bytes moved at the L3 side of a memcpy op.
+int64_t getL3MemcpyVolumeInBytes(air::MemcpyInterface memcpyOp);
+
 // Given a vector of memcpy operations, return a map of their repeat counts,
 // relative to a common ancestor region.
 llvm::MapVector<int, llvm::SetVector<Operation *>>
@@ -152,9 +159,18 @@ class ShimDMAAllocator : public DMAAllocator {
 public:
   std::vector<int> dma_columns;
   int shim_dma_channels;
+  // When set, new shim DMA channels go to the shim column with the least
+  // traffic allocated so far, rather than first-fit from the requested
+  // column.
+  bool balanceLoad = false;
+  std::map<int, int64_t> columnBytes;
 
   ShimDMAAllocator(AIE::DeviceOp device);
 
+  // Emit a remark on the device summarizing the bytes allocated to each shim
+  // column.
+  void emitLoadBalanceRemark();
+
   allocation_info_t allocNewDmaChannel(air::MemcpyInterface &memcpyOp, int col,
                                        int row,
                                        std::vector<Operation *> &dma_ops,
@@ -170,6 +186,10 @@ public:
   std::optional<air::allocation_info_t>
   foundFlowReuseOpportunity(std::vector<MemcpyBundleAsFlow> memcpy_flows,
                             air::allocation_info_t alloc, bool isMM2S);
+
+private:
+  void accountTraffic(air::MemcpyInterface &memcpyOp, int col);
+  llvm::DenseSet<Operation *> accountedOps;
 };
 
 class MemTileDMAAllocator : public DMAAllocator {
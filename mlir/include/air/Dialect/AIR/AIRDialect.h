@@ -19,9 +19,12 @@
 #include "mlir/IR/Types.h"
 #include "mlir/Interfaces/ControlFlowInterfaces.h"
 #include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/StringRef.h"
 
 #include <map>
+#include <memory>
 
 using namespace mlir;
 
@@ -43,6 +46,42 @@ void addAsyncDependency(Operation *op, Value token);
 // Erases a `air.async.token` at position index of the argument list.
 void eraseAsyncDependency(Operation *op, unsigned index);
 
+// Memrefs read and written by an async op, including the accesses nested in
+// its regions to memrefs defined above them. The summary of an air.wait_all
+// also covers the ops waiting on it.
+struct AsyncMemoryEffects {
+  llvm::SetVector<Value> reads;
+  llvm::SetVector<Value> writes;
+
+  bool empty() const { return reads.empty() && writes.empty(); }
+};
+
+// Memoizes the AsyncMemoryEffects of ops, so that pruning the dependencies of
+// many ops analyzes each dependency producer once.
+class AsyncDependencyCache {
+public:
+  // The reference stays valid until the summary is invalidated.
+  const AsyncMemoryEffects &getEffects(Operation *op);
+
+  // Forgets every summary covering `op`: its own, its ancestors' and those of
+  // the air.wait_all ops it waits on. Call it before and after changing `op`.
+  void invalidate(Operation *op);
+
+  void clear() { effects.clear(); }
+
+private:
+  llvm::DenseMap<Operation *, std::unique_ptr<AsyncMemoryEffects>> effects;
+};
+
+// Computes the async dependencies `op` actually needs. Dependencies on
+// air.wait_all ops are looked through, dependencies without a RAW, WAR or WAW
+// hazard on a memref are dropped, and so are dependencies of other
+// dependencies. Returns failure if the number of dependencies would not
+// change.
+LogicalResult getPrunedAsyncDependencies(Operation *op,
+                                         AsyncDependencyCache &cache,
+                                         SmallVectorImpl<Value> &newDeps);
+
 } // namespace air
 } // namespace xilinx
 
@@ -19,6 +19,8 @@ namespace air {
 
 std::unique_ptr<mlir::Pass> createAIRDependencyCanonicalizePass();
 
+std::unique_ptr<mlir::Pass> createAIRPruneAsyncDepsPass();
+
 } // namespace air
 } // namespace xilinx
 
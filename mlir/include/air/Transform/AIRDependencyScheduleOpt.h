@@ -39,6 +39,12 @@ std::unique_ptr<OperationPass<ModuleOp>> createAIRPingPongTransformationPattern(
 
 std::unique_ptr<mlir::Pass> createAIRLabelScfForLoopForPingPongPattern();
 
+std::unique_ptr<mlir::Pass> createAIRMultiBuffer();
+std::unique_ptr<OperationPass<ModuleOp>>
+createAIRMultiBuffer(const AIRMultiBufferOptions &);
+
+std::unique_ptr<mlir::Pass> createAIRSoftwarePipeline();
+
 std::unique_ptr<mlir::Pass> createAIRLabelScfForLoopInAIRSegmentPattern();
 
 std::unique_ptr<mlir::Pass> createAIRSpecializeChannelWrapAndStridePattern();
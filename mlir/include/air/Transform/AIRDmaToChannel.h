@@ -17,6 +17,8 @@ namespace xilinx {
 namespace air {
 
 std::unique_ptr<mlir::Pass> createDmaToChannelPass();
+std::unique_ptr<mlir::Pass>
+createDmaToChannelPass(DmaToChannelOptions options);
 
 } // namespace air
 } // namespace xilinx
@@ -55,6 +55,7 @@ namespace air {
 #define GEN_PASS_DEF_AIRPINGPONGTRANSFORMATIONPATTERN
 #define GEN_PASS_DEF_AIRPIPELINEREDUCEPASS
 #define GEN_PASS_DEF_AIRPROMOTEUNIFORML1DMA
+#define GEN_PASS_DEF_AIRPRUNEASYNCDEPS
 #define GEN_PASS_DEF_AIRPRUNELINALGGENERICINPUTDMA
 #define GEN_PASS_DEF_AIRREGULARIZELOOP
 #define GEN_PASS_DEF_AIRREMOVELINALGNAMEPASS
@@ -0,0 +1,95 @@
+//===- ChannelSymbolIndex.h -------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef AIR_UTIL_CHANNEL_SYMBOL_INDEX_H
+#define AIR_UTIL_CHANNEL_SYMBOL_INDEX_H
+
+#include "air/Dialect/AIR/AIRDialect.h"
+
+#include "mlir/IR/PatternMatch.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <vector>
+
+namespace xilinx {
+namespace air {
+
+// Maps channel symbols to the air.channel.put and air.channel.get ops using
+// them under a root op. It is built with one walk, and answers the same
+// queries as getChannelPutOpThroughSymbol and friends in Util.h without
+// walking the IR again, returning ops in program order.
+//
+// Passes get it with getAnalysis<ChannelSymbolIndex>(). Ops inserted, erased
+// or renamed afterwards must be reported to the index, either by creating and
+// erasing them through a builder or rewriter with a Listener attached, or
+// with the insert, erase and replaceSymbol methods.
+class ChannelSymbolIndex {
+public:
+  explicit ChannelSymbolIndex(Operation *root);
+
+  // Puts and gets of `channel` nested in `scope`, which defaults to the
+  // module declaring the channel. `scope` must be nested in the root.
+  std::vector<ChannelPutOp> getChannelPutOps(ChannelOp channel,
+                                             Operation *scope = nullptr);
+  std::vector<ChannelGetOp> getChannelGetOps(ChannelOp channel,
+                                             Operation *scope = nullptr);
+
+  std::vector<ChannelGetOp> getTheOtherChannelOps(ChannelPutOp put);
+  std::vector<ChannelPutOp> getTheOtherChannelOps(ChannelGetOp get);
+  std::vector<ChannelInterface> getTheOtherChannelOps(ChannelInterface op);
+
+  // Adds the puts and gets in `op`, including `op` itself. Ops already in
+  // the index are considered moved.
+  void insert(Operation *op);
+  // Removes the puts and gets in `op`, including `op` itself.
+  void erase(Operation *op);
+  // Re-reads the channel name of a put or get whose name changed in place.
+  void update(Operation *op);
+  // Moves the puts and gets of `oldName` to `newName`, after their uses
+  // were replaced with SymbolTable::replaceAllSymbolUses.
+  void replaceSymbol(StringAttr oldName, StringAttr newName);
+  // Re-indexes the root, e.g. after running a greedy rewrite on it.
+  void rebuild();
+
+  // Keeps the index up to date with the ops a builder or rewriter creates,
+  // moves, modifies and erases.
+  class Listener : public RewriterBase::Listener {
+  public:
+    explicit Listener(ChannelSymbolIndex &index) : index(index) {}
+
+    void notifyOperationInserted(Operation *op,
+                                 OpBuilder::InsertPoint previous) override;
+    void notifyOperationModified(Operation *op) override;
+    void notifyOperationErased(Operation *op) override;
+
+  private:
+    ChannelSymbolIndex &index;
+  };
+
+private:
+  struct ChannelUsers {
+    SmallVector<Operation *> puts;
+    SmallVector<Operation *> gets;
+    // Cleared when ops are added out of program order
+    bool sorted = true;
+  };
+
+  void add(Operation *op, StringAttr name);
+  void remove(Operation *op);
+  ChannelUsers *lookup(StringAttr name);
+  std::vector<Operation *> getUsers(StringAttr name, Operation *scope,
+                                    bool puts);
+
+  Operation *root;
+  llvm::DenseMap<StringAttr, ChannelUsers> users;
+  llvm::DenseMap<Operation *, StringAttr> names;
+};
+
+} // namespace air
+} // namespace xilinx
+
+#endif // AIR_UTIL_CHANNEL_SYMBOL_INDEX_H
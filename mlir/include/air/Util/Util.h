@@ -35,6 +35,9 @@ SmallVector<int> getTensorShape(const ShapedType ty);
 SmallVector<int> getTensorShape(const Type ty);
 std::string getElementTypeAsString(const mlir::Type ty);
 uint64_t getElementSizeInBytes(const mlir::Type ty);
+// Bytes moved at the source (or destination) side of a memcpy op, including
+// the repetitions from enclosing scf.for loops with constant bounds.
+int64_t getMemcpyVolumeInBytes(MemcpyInterface memcpyOp, bool isSrc);
 
 // Get the parent scf.for op of an iter_arg
 scf::ForOp getForRegionIterArgsOwner(Value val);
@@ -82,7 +85,8 @@ DmaMemcpyNdOp getAIRDmaInBlock(mlir::Block *block);
 
 // Get channel declaration through channel symbol
 ChannelOp getChannelDeclarationThroughSymbol(ChannelInterface op);
-// Get ChannelPutOps from ChannelOp
+// Get ChannelPutOps from ChannelOp. These walk the scope on every call; use a
+// ChannelSymbolIndex when querying many channels.
 std::vector<ChannelPutOp>
 getChannelPutOpThroughSymbol(ChannelOp channel, Operation *scope = nullptr);
 // Get ChannelGetOps from ChannelOp
@@ -1298,6 +1298,9 @@ public:
       signalPassFailure();
     }
 
+    if (clUseContext)
+      useRuntimeContext(module);
+
     llvm::SmallSet<func::FuncOp, 1> erased_extern;
     for (auto func : module.getOps<func::FuncOp>()) {
       if (func.isExternal() && func.symbolKnownUseEmpty(module))
@@ -1311,6 +1314,71 @@ public:
   }
 
 private:
+  // Entry points whose runtime implementation works on a runtime context.
+  // The L2 allocation entry points have no runtime implementation yet.
+  static bool usesRuntimeContext(StringRef callee) {
+    return callee == "__airrt_segment_load" || callee == "__airrt_herd_load" ||
+           callee.starts_with("__airrt_dma_nd_memcpy_") ||
+           callee.starts_with("__airrt_nd_memcpy_") ||
+           callee.starts_with("__airrt_wait_all_");
+  }
+
+  // Rewrites calls to __airrt_X into calls to __airrt_ctx_X, which take the
+  // runtime context returned by __airrt_get_context as first operand. The
+  // context is looked up once at the entry of each calling function.
+  void useRuntimeContext(ModuleOp module) {
+    auto ctx = module.getContext();
+    Type ptrTy = LLVM::LLVMPointerType::get(ctx);
+    OpBuilder builder(ctx);
+
+    auto getOrCreateDecl = [&](StringRef name, FunctionType ty) {
+      auto fn = module.lookupSymbol<func::FuncOp>(name);
+      if (!fn) {
+        fn = func::FuncOp::create(builder.getUnknownLoc(), name, ty);
+        fn.setPrivate();
+        module.push_back(fn);
+      }
+      return fn;
+    };
+
+    SmallVector<func::FuncOp> funcs(module.getOps<func::FuncOp>());
+    for (auto func : funcs) {
+      if (func.isExternal())
+        continue;
+
+      SmallVector<func::CallOp> calls;
+      func.walk([&](func::CallOp call) {
+        if (usesRuntimeContext(call.getCallee()))
+          calls.push_back(call);
+      });
+      if (calls.empty())
+        continue;
+
+      auto getContextFn = getOrCreateDecl(
+          "__airrt_get_context", FunctionType::get(ctx, {}, {ptrTy}));
+      builder.setInsertionPointToStart(&func.front());
+      Value context = builder.create<func::CallOp>(func.getLoc(), getContextFn)
+                          .getResult(0);
+
+      for (auto call : calls) {
+        StringRef callee = call.getCallee();
+        callee.consume_front("__airrt_");
+        std::string name = ("__airrt_ctx_" + callee).str();
+        SmallVector<Type> argTys{ptrTy};
+        llvm::append_range(argTys, call.getOperandTypes());
+        auto fn = getOrCreateDecl(
+            name, FunctionType::get(ctx, argTys, call.getResultTypes()));
+
+        SmallVector<Value> operands{context};
+        llvm::append_range(operands, call.getOperands());
+        builder.setInsertionPoint(call);
+        auto ctxCall =
+            builder.create<func::CallOp>(call.getLoc(), fn, operands);
+        call.replaceAllUsesWith(ctxCall.getResults());
+        call.erase();
+      }
+    }
+  }
 };
 
 } // namespace
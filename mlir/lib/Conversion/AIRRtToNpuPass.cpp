@@ -19,6 +19,7 @@
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/Utils/Utils.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
@@ -30,6 +31,9 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cstddef>
+#include <deque>
+#include <map>
+#include <tuple>
 
 #define DEBUG_TYPE "airrt-to-npu-pass"
 
@@ -967,6 +971,13 @@ struct AIRRtToNpuPass : public impl::AIRRtToNpuBase<AIRRtToNpuPass> {
     air::populateBufferMemrefToFuncArgsPattern(castPattern);
     (void)applyPatternsGreedily(module, std::move(castPattern));
 
+    // Fold runs of BDs that differ only by a constant address step into
+    // repeated BDs.
+    numDmaOpsBefore += countNpuDmaOps(module);
+    if (clCompactInsts)
+      compactNpuDmaOps(module);
+    numDmaOpsAfter += countNpuDmaOps(module);
+
     // Insert sync op after copying data out to host
     insertNpuSyncOpForResults(module);
 
@@ -983,6 +994,118 @@ struct AIRRtToNpuPass : public impl::AIRRtToNpuBase<AIRRtToNpuPass> {
     if (failed(applyPartialConversion(module, target,
                                       std::move(funcToSeqPatterns))))
       signalPassFailure();
+
+    module.walk([&](Operation *op) {
+      if (isa<AIEX::NpuDmaMemcpyNdOp, AIEX::NpuSyncOp, AIEX::NpuWrite32Op,
+              AIEX::NpuAddressPatchOp>(op))
+        numInsts++;
+    });
+  }
+
+  int64_t countNpuDmaOps(ModuleOp module) {
+    int64_t count = 0;
+    module.walk([&](AIEX::NpuDmaMemcpyNdOp dma) { count++; });
+    return count;
+  }
+
+  // Linear element offset of a static npu.dma_memcpy_nd from its memref base.
+  int64_t getLinearOffset(AIEX::NpuDmaMemcpyNdOp dma) {
+    int64_t offset = 0;
+    for (auto [o, s] :
+         llvm::zip_equal(dma.getStaticOffsets(), dma.getStaticStrides()))
+      offset += o * s;
+    return offset;
+  }
+
+  // Two BDs can be issued as repetitions of one BD if they move the same
+  // pattern of data through the same shim channel, and only their base
+  // addresses differ.
+  bool isRepeatOf(AIEX::NpuDmaMemcpyNdOp head, AIEX::NpuDmaMemcpyNdOp dma) {
+    return head.getMetadata() == dma.getMetadata() &&
+           head.getMemref() == dma.getMemref() && head.getX() == dma.getX() &&
+           head.getY() == dma.getY() &&
+           head.getPacketAttr() == dma.getPacketAttr() &&
+           head.getStaticSizes() == dma.getStaticSizes() &&
+           head.getStaticStrides() == dma.getStaticStrides();
+  }
+
+  // Fold runs of aiex.npu.dma_memcpy_nd ops on the same shim channel into one
+  // op using the BD repeat dimension (dimension 0), when dimension 0 is
+  // unused and consecutive base addresses differ by a constant step. Runs are
+  // broken by any other side-effecting op, such as npu.sync or npu.write32,
+  // but not by BDs on other channels.
+  void compactNpuDmaOps(ModuleOp module) {
+    // BD repeat count and iteration stride (in 32-bit words) limits on AIE2.
+    const int64_t maxRepeat = 64;
+    const int64_t maxIterStride = 1 << 20;
+
+    struct Run {
+      AIEX::NpuDmaMemcpyNdOp head;
+      int64_t count = 1;
+      int64_t step = 0;
+    };
+
+    module.walk([&](func::FuncOp f) {
+      llvm::MapVector<StringRef, Run> runs;
+      SmallVector<Operation *> erased;
+      auto flush = [&](Run &run) {
+        if (run.count == 1)
+          return;
+        SmallVector<int64_t> sizes(run.head.getStaticSizes());
+        SmallVector<int64_t> strides(run.head.getStaticStrides());
+        sizes[0] = run.count;
+        strides[0] = run.step;
+        auto ctx = run.head->getContext();
+        run.head.setStaticSizesAttr(DenseI64ArrayAttr::get(ctx, sizes));
+        run.head.setStaticStridesAttr(DenseI64ArrayAttr::get(ctx, strides));
+      };
+      auto canStart = [&](AIEX::NpuDmaMemcpyNdOp dma) {
+        return dma.getOffsets().empty() && dma.getSizes().empty() &&
+               dma.getStrides().empty() && dma.getStaticSizes()[0] == 1;
+      };
+
+      for (auto &op : f.getBody().getOps()) {
+        auto dma = dyn_cast<AIEX::NpuDmaMemcpyNdOp>(op);
+        if (!dma) {
+          if (isPure(&op))
+            continue;
+          for (auto &entry : runs)
+            flush(entry.second);
+          runs.clear();
+          continue;
+        }
+
+        auto it = runs.find(dma.getMetadata());
+        if (it != runs.end() && canStart(dma) &&
+            isRepeatOf(it->second.head, dma)) {
+          Run &run = it->second;
+          auto elemBytes =
+              cast<BaseMemRefType>(dma.getMemref().getType())
+                  .getElementTypeBitWidth() /
+              8;
+          int64_t step = getLinearOffset(dma) - getLinearOffset(run.head) -
+                         (run.count - 1) * run.step;
+          bool stepOk = run.count == 1 ? step >= 0 : step == run.step;
+          if (stepOk && run.count < maxRepeat &&
+              step * elemBytes / 4 < maxIterStride) {
+            run.step = step;
+            run.count++;
+            erased.push_back(dma);
+            continue;
+          }
+        }
+        if (it != runs.end()) {
+          flush(it->second);
+          runs.erase(it);
+        }
+        if (canStart(dma))
+          runs.insert({dma.getMetadata(), Run{dma}});
+      }
+      for (auto &entry : runs)
+        flush(entry.second);
+      for (auto o : erased)
+        o->erase();
+    });
   }
 
   void moveFuncOpToEndOfDeviceOp(ModuleOp module) {
@@ -1238,6 +1361,10 @@ struct AIRRtToNpuPass : public impl::AIRRtToNpuBase<AIRRtToNpuPass> {
 
       if (!d)
         continue;
+      if (clMinimalSync) {
+        insertMinimalNpuSyncOps(f, getAllocOpForSymbolWithCaching);
+        continue;
+      }
       OpBuilder builder(f);
       for (auto dma : dmas) {
         auto infoOp = getAllocOpForSymbolWithCaching(dma.getMetadata());
@@ -1280,6 +1407,111 @@ struct AIRRtToNpuPass : public impl::AIRRtToNpuBase<AIRRtToNpuPass> {
     }
   }
 
+  // Insert npu.sync ops only where the program needs a shim DMA transfer to
+  // have completed: before a transfer that conflicts with an outstanding one
+  // on another channel over the same host buffer, and at the end of the
+  // sequence for S2MM transfers. Two transfers conflict if either of them
+  // writes the buffer (read-after-write, write-after-read and
+  // write-after-write), as in getPrunedAsyncDependencies. Transfers on one
+  // channel complete in issue order and never need a sync between them.
+  // Each sync consumes the task-complete token of the oldest outstanding BD
+  // on its channel, so waiting for one BD also drains the BDs queued before
+  // it on the same channel. MM2S BDs do not issue a token by default; the
+  // ones that are waited on are made to. An S2MM channel is also drained
+  // when its task queue is full, or when the column runs out of BD ids,
+  // which are reassigned after each sync.
+  void insertMinimalNpuSyncOps(
+      func::FuncOp f,
+      llvm::function_ref<std::optional<AIE::ShimDMAAllocationOp>(StringRef)>
+          getAllocOp) {
+    // Shim DMA task queue depth and BD count per column on AIE2.
+    const unsigned maxOutstandingPerChannel = 4;
+    const unsigned maxBdsPerColumn = 16;
+
+    // {column, direction, channel}, direction as in npu.sync: 0 is S2MM.
+    using ChannelKey = std::tuple<int, int, int>;
+    std::map<ChannelKey, std::deque<AIEX::NpuDmaMemcpyNdOp>> outstanding;
+    std::map<int, unsigned> bdsPerColumn;
+    OpBuilder builder(f);
+
+    // Wait for all BDs on `chan` up to and including `last`.
+    auto drain = [&](Operation *insertionPoint, ChannelKey chan,
+                     AIEX::NpuDmaMemcpyNdOp last) {
+      auto [col, dir, channel] = chan;
+      auto &queue = outstanding[chan];
+      builder.setInsertionPoint(insertionPoint);
+      while (!queue.empty()) {
+        auto dma = queue.front();
+        queue.pop_front();
+        if (dir == 1)
+          dma->setAttr("issue_token", builder.getBoolAttr(true));
+        builder.create<AIEX::NpuSyncOp>(
+            dma->getLoc(), builder.getI32IntegerAttr(col),
+            builder.getI32IntegerAttr(0), builder.getI32IntegerAttr(dir),
+            builder.getI32IntegerAttr(channel), builder.getI32IntegerAttr(1),
+            builder.getI32IntegerAttr(1));
+        numSyncs++;
+        bdsPerColumn.clear();
+        if (dma == last)
+          break;
+      }
+    };
+
+    SmallVector<AIEX::NpuDmaMemcpyNdOp> dmas;
+    f.walk([&](AIEX::NpuDmaMemcpyNdOp dma) { dmas.push_back(dma); });
+    for (auto dma : dmas) {
+      auto infoOp = getAllocOp(dma.getMetadata());
+      if (!infoOp)
+        continue;
+      bool isS2MM = infoOp->getChannelDir() == AIE::DMAChannelDir::S2MM;
+      ChannelKey chan = {infoOp->getCol(), isS2MM ? 0 : 1,
+                         infoOp->getChannelIndex()};
+
+      // Hazards on a host buffer with transfers on other channels. An S2MM
+      // transfer writes the host buffer and an MM2S transfer reads it.
+      for (auto &[key, queue] : outstanding) {
+        if (key == chan)
+          continue;
+        bool otherIsS2MM = std::get<1>(key) == 0;
+        if (!isS2MM && !otherIsS2MM)
+          continue;
+        auto lastConflict = llvm::find_if(
+            llvm::reverse(queue), [&](AIEX::NpuDmaMemcpyNdOp other) {
+              return other.getMemref() == dma.getMemref();
+            });
+        if (lastConflict != llvm::reverse(queue).end())
+          drain(dma, key, *lastConflict);
+      }
+
+      // Keep the hardware task queue and the column's BD ids from overflowing.
+      if (isS2MM && outstanding[chan].size() >= maxOutstandingPerChannel)
+        drain(dma, chan, outstanding[chan].front());
+      if (bdsPerColumn[std::get<0>(chan)] >= maxBdsPerColumn) {
+        for (auto &[key, queue] : outstanding)
+          if (std::get<0>(key) == std::get<0>(chan) &&
+              std::get<1>(key) == 0 && !queue.empty())
+            drain(dma, key, queue.back());
+      }
+
+      bdsPerColumn[std::get<0>(chan)]++;
+      outstanding[chan].push_back(dma);
+    }
+
+    // Results must be complete when the sequence returns. Drain the S2MM
+    // channels in issue order.
+    SmallVector<std::pair<ChannelKey, AIEX::NpuDmaMemcpyNdOp>> remaining;
+    for (auto &[key, queue] : outstanding)
+      if (std::get<1>(key) == 0)
+        for (auto dma : queue)
+          remaining.push_back({key, dma});
+    llvm::sort(remaining, [](auto &a, auto &b) {
+      return a.second->isBeforeInBlock(b.second);
+    });
+    Operation *terminator = f.getBody().back().getTerminator();
+    for (auto &[key, dma] : remaining)
+      drain(terminator, key, dma);
+  }
+
   // Each element of 'port' is a {Port_N_Master_Slave, Port_N_ID} pair. They
   // will be read sequentially to select up to 8 stream switch ports to monitor,
   // using the select register at address {col, row, offset}.
@@ -11,6 +11,7 @@
 #include "air/Dialect/AIRRt/AIRRtDialect.h"
 #include "air/Dialect/AIRRt/AIRRtOps.h"
 #include "air/Transform/AIRDependencyScheduleOpt.h"
+#include "air/Util/ChannelSymbolIndex.h"
 #include "air/Util/Dependency.h"
 #include "air/Util/Util.h"
 
@@ -29,6 +30,7 @@
 #include "mlir/IR/IRMapping.h"
 #include "mlir/IR/IntegerSet.h"
 #include "mlir/IR/Iterators.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
@@ -36,6 +38,7 @@
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <algorithm>
@@ -61,8 +64,17 @@ struct AIRToAIEConversionOptions {
   bool insert_trace_packet_flow;
   bool use_packet_flow_at_shim_dmas;
   AIE::AIEDevice device;
+  bool l1_buffer_reuse;
+  bool l1_bank_aware;
+  bool balance_shim_dma;
+  bool check_memtile_dma_resources;
+  bool report_memtile_dma_usage;
+  int64_t auto_pkt_flow_max_bytes;
 };
 
+// Packet ids are five bits wide in the stream switch packet header.
+const int maxNumPacketIds = 32;
+
 // get memcpy operation volumn (elements) as int
 int getMemcpySizesAsInt(Value memref, SmallVector<Value> sizes) {
   BaseMemRefType memTy = llvm::cast<BaseMemRefType>(memref.getType());
@@ -751,14 +763,82 @@ void lowerScfAirTokens(AIE::DeviceOp m) {
   (void)applyPatternsGreedily(m, std::move(patterns));
 }
 
+// Live range of an L1 buffer, in the pre-order numbering of the ops of the
+// core that uses it.
+struct L1LiveRange {
+  int64_t start = 0;
+  int64_t end = 0;
+  bool dmaAccessed = false;
+  bool overlaps(const L1LiveRange &other) const {
+    return start <= other.end && other.start <= end;
+  }
+};
+
+// Live ranges of the L1 memref.alloc ops in a device, and of the aie.buffer
+// ops that replace them.
+struct L1Liveness {
+  DenseMap<Operation *, L1LiveRange> allocRanges;
+  DenseMap<Operation *, L1LiveRange> bufferRanges;
+};
+
+// Compute the live range of each L1 memref.alloc in a core. A buffer is live
+// from its alloc to the end of the last op in the alloc's block using it,
+// directly or through a view. Buffers accessed by a data movement op, or that
+// escape through a terminator, are live for the whole core, since the tile
+// DMA accesses them asynchronously to the core program. Without `reuse`,
+// every buffer is live for the whole core.
+void computeL1LiveRanges(AIE::CoreOp core, L1Liveness &liveness, bool reuse) {
+  DenseMap<Operation *, L1LiveRange> span;
+  int64_t index = 0;
+  std::function<void(Operation *)> number = [&](Operation *op) {
+    int64_t start = index++;
+    for (auto &region : op->getRegions())
+      for (auto &block : region)
+        for (auto &o : block)
+          number(&o);
+    span[op] = {start, index - 1};
+  };
+  number(core.getOperation());
+
+  core.walk([&](memref::AllocOp alloc) {
+    if (alloc.getType().getMemorySpaceAsInt() != (int)air::MemorySpace::L1)
+      return;
+    L1LiveRange range = span[alloc.getOperation()];
+    bool liveThroughout = !reuse;
+    bool dmaAccessed = false;
+    SmallVector<Value> worklist{alloc.getMemref()};
+    while (!worklist.empty()) {
+      Value v = worklist.pop_back_val();
+      for (Operation *user : v.getUsers()) {
+        Operation *ancestor = alloc->getBlock()->findAncestorOpInBlock(*user);
+        if (isa<air::MemcpyInterface>(user))
+          dmaAccessed = true;
+        if (!ancestor || dmaAccessed ||
+            user->hasTrait<OpTrait::IsTerminator>()) {
+          liveThroughout = true;
+          continue;
+        }
+        range.end = std::max(range.end, span[ancestor].end);
+        for (auto r : user->getResults())
+          if (isa<MemRefType>(r.getType()))
+            worklist.push_back(r);
+      }
+    }
+    if (liveThroughout)
+      range = span[core.getOperation()];
+    range.dmaAccessed = dmaAccessed;
+    liveness.allocRanges[alloc.getOperation()] = range;
+  });
+}
+
 struct AllocL1BuffersPattern : public OpRewritePattern<memref::AllocOp> {
   using OpRewritePattern<memref::AllocOp>::OpRewritePattern;
 
   AllocL1BuffersPattern(MLIRContext *ctx,
                         std::map<AIE::TileOp, air::HerdOp> &tileToHerdMap,
-                        uint64_t &bufferId)
+                        uint64_t &bufferId, L1Liveness *liveness = nullptr)
       : OpRewritePattern(ctx), tileToHerdMap(tileToHerdMap),
-        BufferId(bufferId) {}
+        BufferId(bufferId), liveness(liveness) {}
 
   LogicalResult matchAndRewrite(memref::AllocOp alloc,
                                 PatternRewriter &rewriter) const override {
@@ -793,6 +873,12 @@ struct AllocL1BuffersPattern : public OpRewritePattern<memref::AllocOp> {
         alloc->getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName()),
         tile.getCol() - col_offset, tile.getRow() - row_offset);
 
+    if (liveness) {
+      auto it = liveness->allocRanges.find(alloc.getOperation());
+      if (it != liveness->allocRanges.end())
+        liveness->bufferRanges[buffer.getOperation()] = it->second;
+    }
+
     rewriter.setInsertionPoint(alloc);
     rewriter.replaceOp(alloc, buffer->getResults());
     return success();
@@ -801,6 +887,7 @@ struct AllocL1BuffersPattern : public OpRewritePattern<memref::AllocOp> {
 private:
   std::map<AIE::TileOp, air::HerdOp> &tileToHerdMap;
   uint64_t &BufferId;
+  L1Liveness *liveness;
 };
 
 struct AllocL2BuffersPattern : public OpRewritePattern<memref::AllocOp> {
@@ -865,14 +952,296 @@ private:
 
 void allocL1Buffers(AIE::DeviceOp m,
                     std::map<AIE::TileOp, air::HerdOp> &tileToHerdMap,
-                    uint64_t &BufferId) {
+                    uint64_t &BufferId, L1Liveness *liveness = nullptr,
+                    bool reuse = true) {
   auto ctx = m->getContext();
+  if (liveness)
+    m.walk([&](AIE::CoreOp core) {
+      computeL1LiveRanges(core, *liveness, reuse);
+    });
   RewritePatternSet patterns(ctx);
-  patterns.insert<AllocL1BuffersPattern>(ctx, tileToHerdMap, BufferId);
+  patterns.insert<AllocL1BuffersPattern>(ctx, tileToHerdMap, BufferId,
+                                         liveness);
   // AllocL1TensorsPattern
   (void)applyPatternsGreedily(m, std::move(patterns));
 }
 
+// Sizes and banks of L1 buffers placed on one tile.
+struct L1Placement {
+  int64_t base;
+  int64_t bankSize;
+  DenseMap<Operation *, int64_t> addresses;
+
+  static int64_t sizeOf(AIE::BufferOp b) {
+    auto ty = llvm::cast<MemRefType>(b.getType());
+    return getElementSizeInBytes(ty) * getTensorVolume(ty);
+  }
+  bool sharesBank(int64_t addrA, int64_t sizeA, int64_t addrB,
+                  int64_t sizeB) const {
+    if (!bankSize)
+      return true;
+    return addrA / bankSize <= (addrB + sizeB - 1) / bankSize &&
+           addrB / bankSize <= (addrA + sizeA - 1) / bankSize;
+  }
+};
+
+// Two buffers contend for a memory bank if they are live at the same time and
+// at least one of them is accessed by a tile DMA, which runs concurrently with
+// the core and with the other DMA channels.
+bool contend(const L1LiveRange &a, const L1LiveRange &b) {
+  return (a.dmaAccessed || b.dmaAccessed) && a.overlaps(b);
+}
+
+// Place buffers at the lowest aligned offset at or above `lowerBound` that
+// does not overlap any already placed buffer with an overlapping live range.
+// A buffer no larger than a memory bank is never placed across a bank
+// boundary. With `bank` set, the buffer must fit inside that bank and must not
+// share it with a contending buffer. Returns the address, or -1 if the buffer
+// cannot be placed.
+int64_t findL1Address(AIE::BufferOp buffer, ArrayRef<AIE::BufferOp> placed,
+                      const L1Liveness &liveness,
+                      const L1Placement &placement,
+                      std::optional<int64_t> bank) {
+  const int64_t alignment = 16;
+  int64_t bankSize = placement.bankSize;
+  int64_t size = L1Placement::sizeOf(buffer);
+  L1LiveRange range = liveness.bufferRanges.lookup(buffer.getOperation());
+  int64_t addr = placement.base;
+  if (bank) {
+    for (auto other : placed) {
+      int64_t otherAddr = placement.addresses.lookup(other.getOperation());
+      if (contend(range,
+                  liveness.bufferRanges.lookup(other.getOperation())) &&
+          placement.sharesBank(*bank * bankSize, bankSize, otherAddr,
+                               L1Placement::sizeOf(other)))
+        return -1;
+    }
+    addr = std::max(addr, *bank * bankSize);
+  }
+  bool moved = true;
+  while (moved) {
+    moved = false;
+    addr = llvm::alignTo(addr, alignment);
+    if (bankSize && size <= bankSize &&
+        addr / bankSize != (addr + size - 1) / bankSize)
+      addr = llvm::alignTo(addr, bankSize);
+    for (auto other : placed) {
+      if (!range.overlaps(liveness.bufferRanges.lookup(other.getOperation())))
+        continue;
+      int64_t otherAddr = placement.addresses.lookup(other.getOperation());
+      int64_t otherEnd = otherAddr + L1Placement::sizeOf(other);
+      if (addr < otherEnd && otherAddr < addr + size) {
+        addr = otherEnd;
+        moved = true;
+        break;
+      }
+    }
+  }
+  if (bank && addr + size > (*bank + 1) * bankSize)
+    return -1;
+  return addr;
+}
+
+// Place the buffers of one tile, largest first. With `bankAware` set, each
+// buffer that fits in a bank first goes to the lowest bank holding no
+// contending buffer, and falls back to first-fit placement when every bank is
+// taken. Returns the peak L1 usage in bytes.
+int64_t placeL1Buffers(ArrayRef<AIE::BufferOp> buffers,
+                       const L1Liveness &liveness, int64_t numBanks,
+                       bool bankAware, L1Placement &placement) {
+  auto rangeOf = [&](AIE::BufferOp b) {
+    return liveness.bufferRanges.lookup(b.getOperation());
+  };
+  SmallVector<AIE::BufferOp> order(buffers.begin(), buffers.end());
+  std::stable_sort(order.begin(), order.end(),
+                   [&](AIE::BufferOp a, AIE::BufferOp b) {
+                     int64_t sizeA = L1Placement::sizeOf(a);
+                     int64_t sizeB = L1Placement::sizeOf(b);
+                     if (sizeA != sizeB)
+                       return sizeA > sizeB;
+                     return rangeOf(a).start < rangeOf(b).start;
+                   });
+
+  SmallVector<AIE::BufferOp> placed;
+  int64_t peak = placement.base;
+  for (auto buffer : order) {
+    int64_t size = L1Placement::sizeOf(buffer);
+    int64_t addr = -1;
+    if (bankAware && placement.bankSize && size <= placement.bankSize)
+      for (int64_t bank = 0; bank < numBanks && addr < 0; bank++)
+        addr = findL1Address(buffer, placed, liveness, placement, bank);
+    if (addr < 0)
+      addr = findL1Address(buffer, placed, liveness, placement, std::nullopt);
+    placement.addresses[buffer.getOperation()] = addr;
+    placed.push_back(buffer);
+    peak = std::max(peak, addr + size);
+  }
+  return peak;
+}
+
+// Estimate the fraction of contending buffer pairs that share a memory bank.
+double estimateL1BankConflictRate(ArrayRef<AIE::BufferOp> buffers,
+                                  const L1Liveness &liveness,
+                                  const L1Placement &placement) {
+  int64_t pairs = 0;
+  int64_t conflicts = 0;
+  for (unsigned i = 0; i < buffers.size(); i++) {
+    for (unsigned j = i + 1; j < buffers.size(); j++) {
+      Operation *a = buffers[i].getOperation();
+      Operation *b = buffers[j].getOperation();
+      if (!contend(liveness.bufferRanges.lookup(a),
+                   liveness.bufferRanges.lookup(b)))
+        continue;
+      pairs++;
+      if (placement.sharesBank(placement.addresses.lookup(a),
+                               L1Placement::sizeOf(buffers[i]),
+                               placement.addresses.lookup(b),
+                               L1Placement::sizeOf(buffers[j])))
+        conflicts++;
+    }
+  }
+  return pairs ? (double)conflicts / pairs : 0.0;
+}
+
+// Assign addresses to the L1 buffers of each core. Buffers whose live ranges
+// never overlap may share memory, and with `bankAware` set, buffers accessed
+// by a tile DMA are kept out of the banks of buffers live at the same time.
+// The peak L1 usage and the estimated bank conflict rate of each tile are
+// reported as a remark.
+LogicalResult assignL1BufferAddresses(AIE::DeviceOp m,
+                                      const L1Liveness &liveness,
+                                      bool bankAware) {
+  const auto &targetModel = m.getTargetModel();
+  int64_t memSize = targetModel.getLocalMemorySize();
+  auto result = m.walk([&](AIE::CoreOp core) {
+    AIE::TileOp tile = core.getTileOp();
+    SmallVector<AIE::BufferOp> buffers;
+    for (auto user : tile->getUsers())
+      if (auto b = dyn_cast<AIE::BufferOp>(user))
+        if (liveness.bufferRanges.count(b.getOperation()))
+          buffers.push_back(b);
+    if (buffers.empty())
+      return WalkResult::advance();
+
+    int64_t numBanks = targetModel.getNumBanks(tile.getCol(), tile.getRow());
+    L1Placement placement;
+    placement.base = core.getStackSize();
+    placement.bankSize = numBanks ? memSize / numBanks : 0;
+    int64_t peak =
+        placeL1Buffers(buffers, liveness, numBanks, bankAware, placement);
+    if (peak > memSize) {
+      tile.emitOpError("L1 buffers need ")
+          << peak << " bytes, but only " << memSize << " are available";
+      return WalkResult::interrupt();
+    }
+    auto i32Ty = IntegerType::get(m->getContext(), 32);
+    for (auto b : buffers)
+      b->setAttr("address", IntegerAttr::get(i32Ty, placement.addresses.lookup(
+                                                        b.getOperation())));
+    double conflictRate =
+        estimateL1BankConflictRate(buffers, liveness, placement);
+    tile.emitRemark("peak L1 usage: ")
+        << peak << " of " << memSize << " bytes, estimated bank conflict rate: "
+        << llvm::format("%.2f", conflictRate);
+    return WalkResult::advance();
+  });
+  return failure(result.wasInterrupted());
+}
+
+// Check the BD programs and locks of each memtile DMA against the physical
+// resources of the memtile. BD ids form pools shared by all channels which can
+// reach them; on AIE2 memtiles, even and odd channels reach disjoint halves of
+// the BD ids. Emits an error naming the exhausted resource and, with `report`
+// set, a remark summarizing the usage of each memtile.
+LogicalResult checkMemTileDmaResources(AIE::DeviceOp m, bool report) {
+  using DMAChannelKey = std::pair<AIE::DMAChannelDir, int>;
+  const auto &targetModel = m.getTargetModel();
+  auto chanToString = [](DMAChannelKey chan) {
+    return (chan.first == AIE::DMAChannelDir::MM2S ? "MM2S " : "S2MM ") +
+           std::to_string(chan.second);
+  };
+  for (auto memTileDMA : m.getOps<AIE::MemTileDMAOp>()) {
+    auto tile = memTileDMA.getTile().getDefiningOp<AIE::TileOp>();
+    int col = tile.getCol();
+    int row = tile.getRow();
+
+    // Number of BDs chained from each channel's dma_start.
+    std::map<DMAChannelKey, int> channelBDs;
+    memTileDMA.walk([&](AIE::DMAStartOp start) {
+      DMAChannelKey chan = {start.getChannelDir(), start.getChannelIndex()};
+      llvm::SmallPtrSet<Block *, 8> visited;
+      for (Block *bd = start.getDest(); bd && visited.insert(bd).second;) {
+        channelBDs[chan] += llvm::range_size(bd->getOps<AIE::DMABDOp>());
+        auto next = dyn_cast<AIE::NextBDOp>(bd->getTerminator());
+        bd = next ? next.getDest() : nullptr;
+      }
+    });
+
+    // Channels reaching the same set of BD ids draw from one pool.
+    int numBDs = targetModel.getNumBDs(col, row);
+    std::map<std::vector<bool>, SmallVector<DMAChannelKey>> pools;
+    for (auto &entry : channelBDs) {
+      std::vector<bool> reachable(numBDs);
+      for (int bd = 0; bd < numBDs; bd++)
+        reachable[bd] = targetModel.isBdChannelAccessible(col, row, bd,
+                                                          entry.first.second);
+      pools[reachable].push_back(entry.first);
+    }
+    int usedBDs = 0;
+    for (auto &[reachable, chans] : pools) {
+      int available = llvm::count(reachable, true);
+      int needed = 0;
+      for (auto chan : chans)
+        needed += channelBDs[chan];
+      usedBDs += needed;
+      if (needed <= available)
+        continue;
+      auto diag = tile.emitOpError("memtile DMA needs ")
+                  << needed << " BDs on channels";
+      for (auto chan : chans)
+        diag << " " << chanToString(chan) << " (" << channelBDs[chan] << ")";
+      diag << ", but only " << available << " BD ids are reachable from them";
+      return failure();
+    }
+
+    int usedLocks = 0;
+    for (auto lock : m.getOps<AIE::LockOp>())
+      if (lock.getTile() == tile.getResult())
+        usedLocks++;
+    int numLocks = targetModel.getNumLocks(col, row);
+    if (usedLocks > numLocks)
+      return tile.emitOpError("memtile DMA needs ")
+             << usedLocks << " locks, but only " << numLocks
+             << " are available";
+
+    std::set<int> s2mmChans, mm2sChans;
+    for (auto &entry : channelBDs)
+      (entry.first.first == AIE::DMAChannelDir::MM2S ? mm2sChans : s2mmChans)
+          .insert(entry.first.second);
+    int numS2MM = tile.getNumDestConnections(AIE::WireBundle::DMA);
+    int numMM2S = tile.getNumSourceConnections(AIE::WireBundle::DMA);
+    auto checkChannels = [&](const std::set<int> &used, int available,
+                             StringRef dir) -> LogicalResult {
+      if (used.empty() || *used.rbegin() < available)
+        return success();
+      return tile.emitOpError("memtile DMA uses ")
+             << dir << " channel " << *used.rbegin() << ", but only "
+             << available << " are available";
+    };
+    if (failed(checkChannels(s2mmChans, numS2MM, "S2MM")) ||
+        failed(checkChannels(mm2sChans, numMM2S, "MM2S")))
+      return failure();
+
+    if (report)
+      tile.emitRemark("memtile DMA usage: BDs ")
+          << usedBDs << " of " << numBDs << ", locks " << usedLocks << " of "
+          << numLocks << ", S2MM channels " << s2mmChans.size() << " of "
+          << numS2MM << ", MM2S channels " << mm2sChans.size() << " of "
+          << numMM2S;
+  }
+  return success();
+}
+
 bool areReferencedByTheSameAIRChannel(Value memref_a, Value memref_b) {
   for (auto user_a : memref_a.getUsers()) {
     for (auto user_b : memref_b.getUsers()) {
@@ -985,10 +1354,11 @@ struct LowerAIRChannelsPattern : public OpRewritePattern<air::ChannelOp> {
   LowerAIRChannelsPattern(
       MLIRContext *ctx, ShimTileAllocator &shimTileAlloc,
       std::map<AIE::BufferOp, AIE::TileOp> &bufferToMemtileMap,
-      std::map<Operation *, AIE::ObjectFifoCreateOp> &linksToComplete)
+      std::map<Operation *, AIE::ObjectFifoCreateOp> &linksToComplete,
+      air::ChannelSymbolIndex &chanIndex)
       : OpRewritePattern(ctx), shimTileAlloc(shimTileAlloc),
         bufferToMemtileMap(bufferToMemtileMap),
-        linksToComplete(linksToComplete) {}
+        linksToComplete(linksToComplete), chanIndex(chanIndex) {}
 
   LogicalResult matchAndRewrite(air::ChannelOp channel,
                                 PatternRewriter &rewriter) const override {
@@ -1003,9 +1373,9 @@ struct LowerAIRChannelsPattern : public OpRewritePattern<air::ChannelOp> {
 
     AIE::AIEObjectFifoType datatype;
     std::vector<ChannelPutOp> channelPuts =
-        getChannelPutOpThroughSymbol(channel, device);
+        chanIndex.getChannelPutOps(channel, device);
     std::vector<ChannelGetOp> channelGets =
-        getChannelGetOpThroughSymbol(channel, device);
+        chanIndex.getChannelGetOps(channel, device);
 
     channel->print(llvm::outs());
     llvm::outs() << "channelPuts" << channelPuts.size() << "\n";
@@ -1165,10 +1535,14 @@ struct LowerAIRChannelsPattern : public OpRewritePattern<air::ChannelOp> {
     for (auto o : erased_deallocs)
       rewriter.eraseOp(o);
     // erase channel puts and gets
-    for (auto get : channelGets)
+    for (auto get : channelGets) {
+      chanIndex.erase(get);
       rewriter.eraseOp(get);
-    for (auto put : channelPuts)
+    }
+    for (auto put : channelPuts) {
+      chanIndex.erase(put);
       rewriter.eraseOp(put);
+    }
     // erase the channel
     rewriter.eraseOp(channel);
     // erase dangling allocs
@@ -1282,6 +1656,9 @@ private:
   ShimTileAllocator &shimTileAlloc;
   std::map<AIE::BufferOp, AIE::TileOp> &bufferToMemtileMap;
   std::map<Operation *, AIE::ObjectFifoCreateOp> &linksToComplete;
+  // The greedy driver does not take a listener here, so erased puts and gets
+  // are removed from the index by the pattern itself
+  air::ChannelSymbolIndex &chanIndex;
 };
 
 // This function replaces ChannelPutOp/ChannelGetOp with AIE_CreateObjectFifoOps
@@ -1294,8 +1671,10 @@ void lowerAIRChannels(
   auto ctx = d->getContext();
   RewritePatternSet patterns(ctx);
   std::map<Operation *, AIE::ObjectFifoCreateOp> linksToComplete;
+  // Indexed here rather than per pass, as the device is populated by the pass
+  air::ChannelSymbolIndex chanIndex(d);
   patterns.insert<LowerAIRChannelsPattern>(ctx, s, bufferToMemtileMap,
-                                           linksToComplete);
+                                           linksToComplete, chanIndex);
   (void)applyPatternsGreedily(d, std::move(patterns));
 }
 
@@ -1566,6 +1945,83 @@ void LowerAIRPingPong(AIE::DeviceOp &d) {
   (void)applyPatternsGreedily(d, std::move(patterns));
 }
 
+// Select the flow connections to route as packet-switched flows: those whose
+// source and destination DMA ports each move at most `maxBytes` bytes. A DMA
+// port cannot mix circuit- and packet-switched connections, so a port touched
+// by any circuit-switched connection keeps all of its connections circuit
+// switched. Every packet-switched source port takes a packet id; when there
+// are more than `numPacketIds` of them, the least loaded ports are kept.
+// Returns the selected connections as (flow index, S2MM index) pairs.
+std::set<std::pair<unsigned, int>>
+selectPacketFlowConnections(std::vector<MemcpyBundleAsFlow> &memcpy_flows,
+                            int64_t maxBytes, int numPacketIds) {
+  using DMAPort = std::tuple<Operation *, AIE::DMAChannelDir, int>;
+  auto getPort = [](allocation_info_t &alloc) {
+    return DMAPort{alloc.getDmaTile().getOperation(),
+                   alloc.dma_channel.direction, alloc.dma_channel.channel};
+  };
+  struct Connection {
+    unsigned flow;
+    int dest;
+    DMAPort srcPort, dstPort;
+  };
+  std::vector<Connection> connections;
+  std::map<DMAPort, int64_t> portBytes;
+  for (auto [idx, f] : llvm::enumerate(memcpy_flows)) {
+    if (!f.numS2MMAllocs)
+      continue;
+    int64_t bytes = 0;
+    for (auto o : f.MM2S)
+      bytes += getMemcpyVolumeInBytes(cast<air::MemcpyInterface>(o),
+                                      /*isSrc=*/true);
+    portBytes[getPort(f.MM2S_alloc)] += bytes;
+    for (int i = 0; i < f.numS2MMAllocs; i++) {
+      connections.push_back(
+          {(unsigned)idx, i, getPort(f.MM2S_alloc), getPort(f.S2MM_alloc[i])});
+      portBytes[connections.back().dstPort] += bytes;
+    }
+  }
+
+  std::set<DMAPort> circuitPorts;
+  for (auto &[port, bytes] : portBytes)
+    if (bytes > maxBytes)
+      circuitPorts.insert(port);
+  auto propagate = [&]() {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (auto &c : connections) {
+        if (circuitPorts.count(c.srcPort) == circuitPorts.count(c.dstPort))
+          continue;
+        circuitPorts.insert(c.srcPort);
+        circuitPorts.insert(c.dstPort);
+        changed = true;
+      }
+    }
+  };
+  propagate();
+
+  SmallVector<DMAPort> pktSources;
+  for (auto &c : connections)
+    if (!circuitPorts.count(c.srcPort) &&
+        !llvm::is_contained(pktSources, c.srcPort))
+      pktSources.push_back(c.srcPort);
+  if ((int)pktSources.size() > numPacketIds) {
+    llvm::stable_sort(pktSources, [&](DMAPort a, DMAPort b) {
+      return portBytes[a] < portBytes[b];
+    });
+    for (auto port : llvm::drop_begin(pktSources, std::max(numPacketIds, 0)))
+      circuitPorts.insert(port);
+    propagate();
+  }
+
+  std::set<std::pair<unsigned, int>> selected;
+  for (auto &c : connections)
+    if (!circuitPorts.count(c.srcPort))
+      selected.insert({c.flow, c.dest});
+  return selected;
+}
+
 template <typename OpT>
 struct OpRemovalPattern : public OpConversionPattern<OpT> {
   using OpConversionPattern<OpT>::OpConversionPattern;
@@ -1598,6 +2054,31 @@ class AIRToAIEPass : public air::impl::AIRToAIEBase<AIRToAIEPass> {
 
   uint64_t BufferId = 0;
 
+  struct DeviceCounters {
+    uint64_t BufferId = 0;
+    // Flow id to ensure unique packet header per packet flow.
+    int flowID = 0;
+  };
+
+  // Everything written while lowering one aie.device.
+  struct DeviceLoweringState {
+    DeviceLoweringState(AIE::DeviceOp device, air::HerdOp herd)
+        : device(device), herd(herd), shimDmaAlloc(device),
+          shimTileAlloc(device.getTargetModel()) {}
+
+    AIE::DeviceOp device;
+    air::HerdOp herd;
+    std::map<AIE::TileOp, air::HerdOp> tileToHerdMap;
+    std::map<AIE::BufferOp, AIE::TileOp> bufferToMemtileMap;
+    std::map<int, int> chan_renumber_reverse_map;
+    std::map<std::string, std::string> chan_to_chan_map;
+    ShimDMAAllocator shimDmaAlloc;
+    ShimTileAllocator shimTileAlloc;
+    // Values defined above the device, indexed by the placeholders standing
+    // in for them while the device is lowered.
+    SmallVector<Value> externalValues;
+  };
+
 public:
   AIRToAIEPass() = default;
   AIRToAIEPass(const AIRToAIEPass &pass) {}
@@ -2119,18 +2600,29 @@ public:
     // ping-pong deadlock.
     tile_dma_alloc.sortMemcpyOps(dma_memcpy_ops);
 
-    // Step 4: Connect flows
-    for (auto &f : memcpy_flows) {
+    // Step 4: Connect flows. With auto_pkt_flow_max_bytes set, connections
+    // moving little data are packet switched, so that they share switchbox
+    // ports instead of each holding a circuit.
+    auto &counters = getDeviceCounters(aie_device);
+    std::set<std::pair<unsigned, int>> pktConnections;
+    if (options.auto_pkt_flow_max_bytes > 0)
+      pktConnections = selectPacketFlowConnections(
+          memcpy_flows, options.auto_pkt_flow_max_bytes,
+          maxNumPacketIds - counters.flowID);
+    for (auto [idx, f] : llvm::enumerate(memcpy_flows)) {
       for (int i = 0; i < f.numS2MMAllocs; i++) {
-        if (options.use_packet_flow_at_shim_dmas &&
-            f.MM2S_alloc.getDmaTile().isShimNOCorPLTile())
+        if ((options.use_packet_flow_at_shim_dmas &&
+             f.MM2S_alloc.getDmaTile().isShimNOCorPLTile()) ||
+            pktConnections.count({(unsigned)idx, i}))
           // use_packet_flow_at_shim_dmas mode: use packet flow for all shim dma
-          // mm2s, to enable dma channel sharing with control packets
+          // mm2s, to enable dma channel sharing with control packets;
+          // otherwise, only for the low-bandwidth connections selected above.
           getPacketFlowOp(
               aie_device, f.MM2S_alloc.getDmaTile(), AIE::WireBundle::DMA,
               (uint32_t)f.MM2S_alloc.dma_channel.channel,
               f.S2MM_alloc[i].getDmaTile(), AIE::WireBundle::DMA,
-              (uint32_t)f.S2MM_alloc[i].dma_channel.channel, flowID);
+              (uint32_t)f.S2MM_alloc[i].dma_channel.channel,
+              counters.flowID);
         else
           getFlowOp(aie_device, f.MM2S_alloc.getDmaTile(), AIE::WireBundle::DMA,
                     (uint32_t)f.MM2S_alloc.dma_channel.channel,
@@ -2649,7 +3141,10 @@ public:
         targetModel.hasProperty(AIE::AIETargetModel::UsesSemaphoreLocks);
     AIE::DMAChannel tile_channel =
         tileDmaAlloc.lookupDMAAllocation(x, y, memcpyOpIf).dma_channel;
-    AIE::BufferOp bufferOp = tileDmaAlloc.getBuffer(BufferId, x, y, memcpyOpIf);
+    auto &counters =
+        getDeviceCounters(memcpyOpIf->getParentOfType<AIE::DeviceOp>());
+    AIE::BufferOp bufferOp =
+        tileDmaAlloc.getBuffer(counters.BufferId, x, y, memcpyOpIf);
     auto locks =
         tileDmaAlloc.getLockForDMA(memcpyOpIf, x, y, bufferOp.getOperation());
     auto acqLockOp = isMM2S(tile_channel) ? locks.second : locks.first;
@@ -2716,6 +3211,8 @@ public:
           dma_memcpys,
       dmaAllocatorTy dmaAlloc, mlir::Location loc, memOpTy mem, int x, int y) {
 
+    auto &counters = getDeviceCounters(cast<AIE::DeviceOp>(mem->getParentOp()));
+
     // The first block
     Block *channel_head = nullptr;
     Block *end_bb = nullptr;
@@ -2771,7 +3268,8 @@ public:
             next_bd->insertBefore(end_bb);
             b.create<AIE::NextBDOp>(loc, next_bd);
           }
-          bufferOpTy bufferOp = dmaAlloc.getBuffer(BufferId, x, y, memcpyOp);
+          bufferOpTy bufferOp =
+              dmaAlloc.getBuffer(counters.BufferId, x, y, memcpyOp);
           auto locks =
               dmaAlloc.getLockForDMA(memcpyOp, x, y, bufferOp.getOperation());
           auto newBD = generateDmaBd<bufferOpTy>(
@@ -3213,7 +3711,8 @@ public:
         builder.setInsertionPoint(device.getBody()->getTerminator());
         auto keep_pkt_header = builder.getBoolAttr(true);
         (void)createPacketFlowOp(
-            builder, flowID, srcTile, AIE::WireBundle::Trace, 0, destTile,
+            builder, getDeviceCounters(device).flowID, srcTile,
+            AIE::WireBundle::Trace, 0, destTile,
             AIE::WireBundle::DMA, destChan, keep_pkt_header);
       }
     }
@@ -3272,8 +3771,10 @@ public:
           renumberChannelOps(&d.getBodyRegion().front(),
                              chan_renumber_reverse_map);
         }
-        if (options.insert_trace_packet_flow)
+        if (options.insert_trace_packet_flow) {
+          deviceCounters.try_emplace(d);
           createTracePacketFlow(d);
+        }
       }
     }
 
@@ -3289,9 +3790,11 @@ public:
 
     ShimTileAllocator shimTileAlloc(AIE::getTargetModel(*device));
     std::map<Operation *, AIE::ObjectFifoCreateOp> linksToComplete;
+    std::optional<air::ChannelSymbolIndex> chanIndex;
     if (clTestPatterns.find("lower-air-channels") != std::string::npos) {
+      chanIndex.emplace(m);
       patterns.insert<LowerAIRChannelsPattern>(
-          ctx, shimTileAlloc, bufferToMemtileMap, linksToComplete);
+          ctx, shimTileAlloc, bufferToMemtileMap, linksToComplete, *chanIndex);
     }
     if (clTestPatterns.find("lower-air-ping-pong") != std::string::npos) {
       patterns.insert<LowerAIRPingPongPattern>(ctx);
@@ -3330,7 +3833,6 @@ public:
     std::vector<std::pair<AIE::DeviceOp, air::HerdOp>> aie_devices;
 
     std::map<AIE::TileOp, air::HerdOp> tileToHerdMap;
-    std::map<AIE::BufferOp, AIE::TileOp> bufferToMemtileMap;
     auto device = AIE::symbolizeAIEDevice(clDevice);
     if (!device) {
       module.emitOpError("Invalid aie.device option");
@@ -3345,15 +3847,25 @@ public:
         /* .generate_shim_dma = */ clGenerateShimDMA,
         /* .insert_trace_packet_flow = */ clInsertTracePacketFlow,
         /* .use_packet_flow_at_shim_dmas = */ clUsePktFlowsAtShimDma,
-        /* .device = */ *device};
+        /* .device = */ *device,
+        /* .l1_buffer_reuse = */ clL1BufferReuse,
+        /* .l1_bank_aware = */ clL1BankAware,
+        /* .balance_shim_dma = */ clBalanceShimDma,
+        /* .check_memtile_dma_resources = */ clCheckMemTileDmaResources,
+        /* .report_memtile_dma_usage = */ clReportMemTileDmaUsage,
+        /* .auto_pkt_flow_max_bytes = */ clAutoPktFlowMaxBytes};
     createAIEModulesAndOutlineCores(module, aie_devices, tileToHerdMap,
                                     options);
 
+    // Phase 1 (sequential): create the per-device state and clone the L2/L3
+    // data movement into each device. Cloning adds uses to values defined in
+    // the host functions, so it cannot run concurrently.
+    std::vector<std::unique_ptr<DeviceLoweringState>> states;
+    deviceCounters.clear();
     std::set<AIE::DeviceOp> seen;
     for (auto &p : aie_devices) {
       auto device = std::get<0>(p);
       xilinx::air::HerdOp h = std::get<1>(p);
-      auto ctx = device->getContext();
 
       if (seen.find(device) != seen.end())
         continue;
@@ -3375,52 +3887,48 @@ public:
         return;
       }
 
-      ShimDMAAllocator shimDmaAlloc(device);
-      std::map<int, int> chan_renumber_reverse_map;
-      ShimTileAllocator shimTileAlloc(device.getTargetModel());
-      std::map<std::string, std::string> chan_to_chan_map;
-
-      if (clUseObjFifo) {
-        cloneL2AndL3MemcpysToDeviceOp(builder, device, module, true, false);
-        specializeHerdAffineIf(device);
-        lowerAirExecute(device);
-        lowerScfAirTokens(device);
-        specializeChannelBundle(device, chan_to_chan_map);
-        renumberChannelOps(device.getBody());
-        LowerAIRPingPong(device);
-        allocL2Buffers(device, bufferToMemtileMap, BufferId);
-        lowerAIRChannels(device, shimTileAlloc, bufferToMemtileMap);
-        allocL1Buffers(device, tileToHerdMap, BufferId);
-      } else {
-        cloneL2AndL3MemcpysToDeviceOp(builder, device, module, true, true);
-        specializeHerdAffineIf(device);
-        lowerAirExecute(device);
-        lowerScfAirTokens(device);
-        specializeChannelBundle(device, chan_to_chan_map);
-        specializeL2MemrefsIntoMemtiles(device);
-        allocL1Buffers(device, tileToHerdMap, BufferId);
-        allocL2Buffers(device, bufferToMemtileMap, BufferId);
-        renumberChannelOps(&device.getBodyRegion().front(),
-                           chan_renumber_reverse_map);
-        if (failed(lowerAIRMemcpyOp<air::ChannelInterface>(device, shimDmaAlloc,
-                                                           options))) {
-          signalPassFailure();
-          return;
-        }
-      }
+      auto state = std::make_unique<DeviceLoweringState>(device, h);
+      for (auto &[tile, herd] : tileToHerdMap)
+        if (tile->getParentOfType<AIE::DeviceOp>() == device)
+          state->tileToHerdMap[tile] = herd;
+      deviceCounters.try_emplace(device);
 
-      if (failed(lowerAIRMemcpyOp<air::DmaMemcpyNdOp>(device, shimDmaAlloc,
-                                                      options))) {
-        signalPassFailure();
-        return;
-      }
+      cloneL2AndL3MemcpysToDeviceOp(builder, device, module, true,
+                                    !clUseObjFifo);
+      isolateDeviceFromAbove(*state);
+      states.push_back(std::move(state));
+    }
 
-      if (options.insert_trace_packet_flow)
-        createTracePacketFlow(device);
+    // Phase 2 (parallel): lower each device. Every op touched here lives in
+    // its own aie.device, and all state written is held in the device's
+    // DeviceLoweringState, so devices are lowered independently. Diagnostics
+    // are reported in device order to keep the output deterministic.
+    auto ctx = module.getContext();
+    ParallelDiagnosticHandler diagHandler(ctx);
+    if (failed(failableParallelForEach(
+            ctx, llvm::seq<size_t>(0, states.size()), [&](size_t i) {
+              diagHandler.setOrderIDForThread(i);
+              LogicalResult r = lowerDevice(*states[i], options);
+              diagHandler.eraseOrderIDForThread();
+              return r;
+            }))) {
+      signalPassFailure();
+      return;
+    }
+
+    // Phase 3 (sequential, in device order): reconnect the devices to the
+    // host IR and merge per-device results into the module-level metadata
+    // and the host-side air ops.
+    for (auto &state : states) {
+      restoreExternalValues(*state);
+
+      auto device = state->device;
+      xilinx::air::HerdOp h = state->herd;
+      auto &shimDmaAlloc = state->shimDmaAlloc;
+      auto &chan_renumber_reverse_map = state->chan_renumber_reverse_map;
 
       SmallVector<air::HerdOp, 4> herds;
       SmallVector<air::SegmentOp, 4> segs;
-      std::set<int64_t> dma_ids;
       if (auto p = h->getParentOfType<air::SegmentOp>()) {
         auto hops = p.getOps<air::HerdOp>();
         herds.append(hops.begin(), hops.end());
@@ -3506,34 +4014,145 @@ public:
         if (!o->getParentOfType<air::HerdOp>())
           channel_ops.push_back(o);
       });
-      for (auto &t : shimTileAlloc.s2mm_allocs)
+      for (auto &t : state->shimTileAlloc.s2mm_allocs)
         for (auto n : t.chan_names)
-          labelAIRDmaOpsWithMetadata(channel_ops, n, chan_to_chan_map);
-      for (auto &t : shimTileAlloc.mm2s_allocs)
+          labelAIRDmaOpsWithMetadata(channel_ops, n, state->chan_to_chan_map);
+      for (auto &t : state->shimTileAlloc.mm2s_allocs)
         for (auto n : t.chan_names)
-          labelAIRDmaOpsWithMetadata(channel_ops, n, chan_to_chan_map);
+          labelAIRDmaOpsWithMetadata(channel_ops, n, state->chan_to_chan_map);
+    }
+  }
 
-      RewritePatternSet patterns(ctx);
-      air::WaitAllOp::getCanonicalizationPatterns(patterns, ctx);
-      (void)applyPatternsGreedily(device, std::move(patterns));
+  // Lower the air ops cloned or outlined into one aie.device. Must only touch
+  // ops nested in state.device and the fields of state, as it runs
+  // concurrently for different devices.
+  LogicalResult lowerDevice(DeviceLoweringState &state,
+                            AIRToAIEConversionOptions options) {
+    auto device = state.device;
+    auto ctx = device->getContext();
+    auto &counters = getDeviceCounters(device);
+    state.shimDmaAlloc.balanceLoad = options.balance_shim_dma;
+    L1Liveness liveness;
+    L1Liveness *l1Liveness =
+        options.l1_buffer_reuse || options.l1_bank_aware ? &liveness : nullptr;
+
+    if (clUseObjFifo) {
+      specializeHerdAffineIf(device);
+      lowerAirExecute(device);
+      lowerScfAirTokens(device);
+      specializeChannelBundle(device, state.chan_to_chan_map);
+      renumberChannelOps(device.getBody());
+      LowerAIRPingPong(device);
+      allocL2Buffers(device, state.bufferToMemtileMap, counters.BufferId);
+      lowerAIRChannels(device, state.shimTileAlloc, state.bufferToMemtileMap);
+      allocL1Buffers(device, state.tileToHerdMap, counters.BufferId,
+                     l1Liveness, options.l1_buffer_reuse);
+    } else {
+      specializeHerdAffineIf(device);
+      lowerAirExecute(device);
+      lowerScfAirTokens(device);
+      specializeChannelBundle(device, state.chan_to_chan_map);
+      specializeL2MemrefsIntoMemtiles(device);
+      allocL1Buffers(device, state.tileToHerdMap, counters.BufferId,
+                     l1Liveness, options.l1_buffer_reuse);
+      allocL2Buffers(device, state.bufferToMemtileMap, counters.BufferId);
+      renumberChannelOps(&device.getBodyRegion().front(),
+                         state.chan_renumber_reverse_map);
+      if (failed(lowerAIRMemcpyOp<air::ChannelInterface>(
+              device, state.shimDmaAlloc, options)))
+        return failure();
+    }
 
-      // Remove ops via rewrite patterns.
-      RewritePatternSet removepatterns(ctx);
-      removepatterns.add<OpRemovalPattern<memref::DeallocOp>,
-                         OpRemovalPattern<air::WaitAllOp>,
-                         OpRemovalPattern<memref::CopyOp>,
-                         OpRemovalPattern<memref::AssumeAlignmentOp>>(ctx);
-      ConversionTarget target(*ctx);
-      target.addIllegalOp<memref::DeallocOp, air::WaitAllOp, memref::CopyOp,
-                          memref::AssumeAlignmentOp>();
-      if (failed(applyPartialConversion(device, target,
-                                        std::move(removepatterns))))
-        signalPassFailure();
+    if (failed(lowerAIRMemcpyOp<air::DmaMemcpyNdOp>(device, state.shimDmaAlloc,
+                                                    options)))
+      return failure();
+
+    if (options.balance_shim_dma)
+      state.shimDmaAlloc.emitLoadBalanceRemark();
+
+    if ((options.check_memtile_dma_resources ||
+         options.report_memtile_dma_usage) &&
+        failed(checkMemTileDmaResources(device,
+                                        options.report_memtile_dma_usage)))
+      return failure();
+
+    if (l1Liveness && failed(assignL1BufferAddresses(device, liveness,
+                                                     options.l1_bank_aware)))
+      return failure();
+
+    if (options.insert_trace_packet_flow)
+      createTracePacketFlow(device);
+
+    RewritePatternSet patterns(ctx);
+    air::WaitAllOp::getCanonicalizationPatterns(patterns, ctx);
+    (void)applyPatternsGreedily(device, std::move(patterns));
+
+    // Remove ops via rewrite patterns.
+    RewritePatternSet removepatterns(ctx);
+    removepatterns.add<OpRemovalPattern<memref::DeallocOp>,
+                       OpRemovalPattern<air::WaitAllOp>,
+                       OpRemovalPattern<memref::CopyOp>,
+                       OpRemovalPattern<memref::AssumeAlignmentOp>>(ctx);
+    ConversionTarget target(*ctx);
+    target.addIllegalOp<memref::DeallocOp, air::WaitAllOp, memref::CopyOp,
+                        memref::AssumeAlignmentOp>();
+    return applyPartialConversion(device, target, std::move(removepatterns));
+  }
+
+  // Ops cloned into a device may still use values defined above it, such as
+  // L3 memrefs and tokens of the enclosing launch. Erasing those ops edits the
+  // use-lists of values shared between devices, which is not thread-safe, so
+  // each such value is replaced inside the device by a placeholder while the
+  // device is lowered.
+  void isolateDeviceFromAbove(DeviceLoweringState &state) {
+    auto device = state.device;
+    Region &body = device.getBodyRegion();
+    llvm::MapVector<Value, SmallVector<OpOperand *>> externalUses;
+    device.walk([&](Operation *op) {
+      for (OpOperand &operand : op->getOpOperands())
+        if (!body.isAncestor(operand.get().getParentRegion()))
+          externalUses[operand.get()].push_back(&operand);
+    });
+    auto builder = OpBuilder::atBlockBegin(device.getBody());
+    for (auto &[v, uses] : externalUses) {
+      auto placeholder = builder.create<UnrealizedConversionCastOp>(
+          device.getLoc(), TypeRange{v.getType()}, ValueRange{});
+      placeholder->setAttr(
+          "air.external_value",
+          builder.getI64IntegerAttr(state.externalValues.size()));
+      for (auto *use : uses)
+        use->set(placeholder.getResult(0));
+      state.externalValues.push_back(v);
+    }
+  }
+
+  // Undo isolateDeviceFromAbove for any placeholder still in use. Unused
+  // placeholders may already have been erased as dead code.
+  void restoreExternalValues(DeviceLoweringState &state) {
+    SmallVector<UnrealizedConversionCastOp> placeholders;
+    state.device.walk([&](UnrealizedConversionCastOp op) {
+      if (op->hasAttr("air.external_value"))
+        placeholders.push_back(op);
+    });
+    for (auto op : placeholders) {
+      auto idx = op->getAttrOfType<IntegerAttr>("air.external_value").getInt();
+      op.getResult(0).replaceAllUsesWith(state.externalValues[idx]);
+      op.erase();
     }
+    state.externalValues.clear();
+  }
+
+  DeviceCounters &getDeviceCounters(AIE::DeviceOp device) {
+    auto it = deviceCounters.find(device);
+    assert(it != deviceCounters.end() &&
+           "counters must be registered before the device is lowered");
+    return it->second;
   }
 
-  // Static flow id to ensure unique packet header per packet flow.
-  int flowID = 0;
+  // Buffer and packet flow ids are numbered per aie.device, so that devices
+  // can be lowered concurrently. Entries are created before lowering starts,
+  // and each entry is only updated while lowering its own device.
+  DenseMap<Operation *, DeviceCounters> deviceCounters;
 };
 
 class SplitAIEDevicesPass
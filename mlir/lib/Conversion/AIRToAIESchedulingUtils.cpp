@@ -12,6 +12,7 @@
 #include "mlir/IR/BuiltinOps.h"
 
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/Support/Format.h"
 
 #include <mutex>
 #include <set>
@@ -177,6 +178,11 @@ int64_t air::get1DOffset(SmallVector<Value> memcpy_offsets,
   return one_d_offset;
 }
 
+int64_t air::getL3MemcpyVolumeInBytes(air::MemcpyInterface memcpyOp) {
+  return getMemcpyVolumeInBytes(
+      memcpyOp, isTileOutbound(memcpyOp, (int)air::MemorySpace::L3));
+}
+
 // Given a vector of memcpy operations, return a map of their repeat counts,
 // relative to a common ancestor region.
 llvm::MapVector<int, llvm::SetVector<Operation *>>
@@ -367,10 +373,13 @@ air::getLockValuePair(const AIE::AIETargetModel &targetModel,
     return getLockValuePair(targetModel, buffer_memref);
 
   // Infer semaphore lock values using air.channel. This method enables
-  // ping-pong compute-communication overlap.
+  // ping-pong compute-communication overlap. Only the device owning the
+  // buffer is searched: devices are lowered in parallel, and a channel of the
+  // same name in another device is a different channel.
+  auto device = buffer_memref.getDefiningOp()->getParentOfType<AIE::DeviceOp>();
   llvm::SmallSet<Operation *, 2> unique_write_buffers;
   llvm::SmallSet<Operation *, 2> unique_read_buffers;
-  for (auto get : getChannelGetOpThroughSymbol(air_chan)) {
+  for (auto get : getChannelGetOpThroughSymbol(air_chan, device)) {
     if (isa<AIE::ExternalBufferOp>(buffer_memref.getDefiningOp())) {
       // Shim DMA locks
       unique_write_buffers.clear();
@@ -383,7 +392,7 @@ air::getLockValuePair(const AIE::AIETargetModel &targetModel,
       }
     }
   }
-  for (auto put : getChannelPutOpThroughSymbol(air_chan)) {
+  for (auto put : getChannelPutOpThroughSymbol(air_chan, device)) {
     if (isa<AIE::ExternalBufferOp>(buffer_memref.getDefiningOp())) {
       // Shim DMA locks
       unique_read_buffers.clear();
@@ -711,38 +720,68 @@ allocation_info_t ShimDMAAllocator::allocNewDmaChannel(
     if (t.foundAlloc(getChannelDeclarationThroughSymbol(
             dyn_cast<air::ChannelInterface>(memcpyOp.getOperation())))) {
       t.memcpyOps.push_back(memcpyOp.getOperation());
+      accountTraffic(memcpyOp, t.getDmaTile().getCol());
       return t;
     }
   }
   AIE::TileOp tile = nullptr;
-  int colIdx = 0;
-  if (colAllocConstraint == "same_column") {
-    // Attempt to use shim dma channels within the same column.
-    auto it = find(dma_columns.begin(), dma_columns.end(), col);
-    if (it != dma_columns.end())
-      colIdx = it - dma_columns.begin();
-  }
-  int dma_col = dma_columns[colIdx];
+  int dma_col = dma_columns[0];
   int dma_channel = 0;
-  int colTripCount = 0;
-  while (any_of(allocs->begin(), allocs->end(), [&](allocation_info_t &a) {
-    return a.foundAlloc(dma_col, 0, AIE::DMAChannel{dir, dma_channel});
-  })) {
-    dma_channel++;
-    if (dma_channel >= shim_dma_channels) {
-      dma_channel = 0;
-      dma_col = dma_columns[colIdx++ % dma_columns.size()];
-      colTripCount++;
-      if (colTripCount > (int)dma_columns.size()) {
-        memcpyOp->emitOpError(
-            "failed to map to shim dma channels: out of channels.");
-        return {};
+  if (balanceLoad) {
+    // Pick a free channel on the least loaded shim column, preferring columns
+    // close to the requested one. MM2S and S2MM traffic share the column's
+    // NoC interface, so both directions count towards the load.
+    std::optional<std::pair<int, int>> best;
+    auto cost = [&](int c) {
+      return std::make_pair(columnBytes[c], std::abs(c - col));
+    };
+    for (int c : dma_columns) {
+      for (int ch = 0; ch < shim_dma_channels; ch++) {
+        if (any_of(allocs->begin(), allocs->end(), [&](allocation_info_t &a) {
+              return a.foundAlloc(c, 0, AIE::DMAChannel{dir, ch});
+            }))
+          continue;
+        if (!best || cost(c) < cost(best->first))
+          best = {c, ch};
+        break;
+      }
+    }
+    if (!best) {
+      memcpyOp->emitOpError(
+          "failed to map to shim dma channels: out of channels.");
+      return {};
+    }
+    std::tie(dma_col, dma_channel) = *best;
+  } else {
+    int colIdx = 0;
+    if (colAllocConstraint == "same_column") {
+      // Attempt to use shim dma channels within the same column.
+      auto it = find(dma_columns.begin(), dma_columns.end(), col);
+      if (it != dma_columns.end())
+        colIdx = it - dma_columns.begin();
+    }
+    dma_col = dma_columns[colIdx];
+    int colTripCount = 0;
+    while (any_of(allocs->begin(), allocs->end(), [&](allocation_info_t &a) {
+      return a.foundAlloc(dma_col, 0, AIE::DMAChannel{dir, dma_channel});
+    })) {
+      dma_channel++;
+      if (dma_channel >= shim_dma_channels) {
+        dma_channel = 0;
+        dma_col = dma_columns[colIdx++ % dma_columns.size()];
+        colTripCount++;
+        if (colTripCount > (int)dma_columns.size()) {
+          memcpyOp->emitOpError(
+              "failed to map to shim dma channels: out of channels.");
+          return {};
+        }
       }
     }
   }
   assert(dma_channel < shim_dma_channels);
   tile = getPhysTileOp(device, dma_col, 0);
   assert(tile);
+  accountTraffic(memcpyOp, dma_col);
   // For shim dma allocations, the col, row and dma_id fields record the other
   // side of the flows, for airrt metadata
   std::vector<int> dma_ops_get_id;
@@ -776,6 +815,7 @@ ShimDMAAllocator::allocNewDmaChannel(air::MemcpyInterface &memcpyOp,
       t.memcpyOps.push_back(memcpyOp.getOperation());
       for (auto id : dma_ops_get_id)
         t.dma_id.push_back(id);
+      accountTraffic(memcpyOp, t.getDmaTile().getCol());
       return t;
     }
   }
@@ -803,6 +843,30 @@ ShimDMAAllocator::getBuffer(uint64_t &BufferId, int64_t col, int64_t row,
   return bufferOp;
 }
 
+void ShimDMAAllocator::accountTraffic(air::MemcpyInterface &memcpyOp,
+                                      int col) {
+  if (!accountedOps.insert(memcpyOp.getOperation()).second)
+    return;
+  columnBytes[col] += getL3MemcpyVolumeInBytes(memcpyOp);
+}
+
+void ShimDMAAllocator::emitLoadBalanceRemark() {
+  if (columnBytes.empty())
+    return;
+  int64_t total = 0;
+  int64_t peak = 0;
+  for (int c : dma_columns) {
+    total += columnBytes[c];
+    peak = std::max(peak, columnBytes[c]);
+  }
+  auto diag = device.emitRemark("shim DMA traffic per column (bytes):");
+  for (int c : dma_columns)
+    diag << " " << c << ":" << columnBytes[c];
+  // Ratio of the busiest column to the ideal, evenly spread, load.
+  double mean = (double)total / dma_columns.size();
+  diag << "; peak/mean " << llvm::format("%.2f", mean ? peak / mean : 0.0);
+}
+
 // Search for opportunities where air channels can reuse flow op via time
 // multiplexing
 std::optional<air::allocation_info_t>
@@ -1134,7 +1198,28 @@ air::simpleDMAChannelAllocation(std::vector<MemcpyBundleAsFlow> &memcpy_flows,
       }
     }
   }
-  for (auto &f : memcpy_flows) {
+  // When balancing shim traffic, place the heaviest flows first.
+  std::vector<MemcpyBundleAsFlow *> l3_flows;
+  for (auto &f : memcpy_flows)
+    l3_flows.push_back(&f);
+  if (shim_dma_alloc.balanceLoad) {
+    auto l3Volume = [](MemcpyBundleAsFlow *f) {
+      int64_t volume = 0;
+      if (f->MM2S_memspace_as_int == (int)air::MemorySpace::L3)
+        for (auto o : f->MM2S)
+          volume += getL3MemcpyVolumeInBytes(cast<air::MemcpyInterface>(o));
+      else if (f->S2MM_memspace_as_int == (int)air::MemorySpace::L3)
+        for (auto o : f->S2MM[0])
+          volume += getL3MemcpyVolumeInBytes(cast<air::MemcpyInterface>(o));
+      return volume;
+    };
+    llvm::stable_sort(l3_flows,
+                      [&](MemcpyBundleAsFlow *a, MemcpyBundleAsFlow *b) {
+                        return l3Volume(a) > l3Volume(b);
+                      });
+  }
+  for (auto fp : l3_flows) {
+    auto &f = *fp;
     if (f.MM2S_memspace_as_int == (int)air::MemorySpace::L3) {
       for (size_t i = 0; i < f.S2MM.size(); i++) {
         for (auto o : f.MM2S) {
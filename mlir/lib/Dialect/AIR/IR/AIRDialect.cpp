@@ -20,6 +20,7 @@
 #include "mlir/IR/PatternMatch.h"
 #include "mlir/Transforms/RegionUtils.h"
 
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/TypeSwitch.h"
 
 #include <iostream>
@@ -194,186 +195,165 @@ static void printAsyncDependencies(OpAsmPrinter &printer, Operation *op,
   printer << "] ";
 }
 
-template <class OpT>
-static LogicalResult CanonicalizeAsyncOpDeps(OpT op,
-                                             PatternRewriter &rewriter) {
-  auto getAllReadAccess = [](Operation *op) {
-    SmallVector<Value> operands;
-    if (auto linalgop = dyn_cast<linalg::LinalgOp>(op)) {
-      for (auto oper : linalgop.getDpsInputs())
-        operands.push_back(oper);
-    } else if (auto memref_copy = dyn_cast<memref::CopyOp>(op)) {
-      operands.push_back(memref_copy.getSource());
-    } else if (auto memcpy = mlir::dyn_cast<xilinx::air::MemcpyInterface>(op)) {
-      if (memcpy.getSrcMemref())
-        operands.push_back(memcpy.getSrcMemref());
-    } else { // If unknown op, then assume all operands are read.
-      for (auto oper : op->getOperands()) {
-        if (!isa<MemRefType>(oper.getType()))
-          continue;
-        operands.push_back(oper);
-      }
-    }
-    return operands;
-  };
-  auto getAllMemrefsReadByOp = [getAllReadAccess](Operation *o) {
-    llvm::SetVector<Value> memrefs;
-    auto opReadAccesses = getAllReadAccess(o);
-    memrefs.insert(opReadAccesses.begin(), opReadAccesses.end());
-    SmallVector<Region *> regions;
-    for (auto &region : o->getRegions())
-      regions.push_back(&region);
-    // If air.wait_all, then we analyze the dependency by collecting all
-    // operations that depend on it.
-    auto waitAllOp = dyn_cast_if_present<air::WaitAllOp>(o);
-    if (waitAllOp && waitAllOp.getAsyncToken()) {
-      for (auto user : waitAllOp.getAsyncToken().getUsers()) {
-        auto userReadAccesses = getAllReadAccess(user);
-        memrefs.insert(userReadAccesses.begin(), userReadAccesses.end());
-        for (auto &region : user->getRegions())
-          regions.push_back(&region);
-      }
-    }
-    for (auto region : regions) {
-      visitUsedValuesDefinedAbove(*region, [&memrefs,
-                                            getAllReadAccess](OpOperand *use) {
-        if (llvm::is_contained(getAllReadAccess(use->getOwner()), use->get()))
-          memrefs.insert(use->get());
-      });
-    }
-    return memrefs;
-  };
-  auto getAllWriteAccess = [](Operation *op) {
-    SmallVector<Value> operands;
-    if (auto linalgop = dyn_cast<linalg::LinalgOp>(op)) {
-      for (auto oper :
-           llvm::concat<Value>(linalgop.getDpsInits(), linalgop->getResults()))
-        operands.push_back(oper);
-    } else if (auto memref_copy = dyn_cast<memref::CopyOp>(op)) {
-      operands.push_back(memref_copy.getTarget());
-    } else if (auto memcpy = mlir::dyn_cast<xilinx::air::MemcpyInterface>(op)) {
-      if (memcpy.getDstMemref())
-        operands.push_back(memcpy.getDstMemref());
-    } else { // If unknown op, then assume all operands and results are written
-             // to.
-      for (auto oper :
-           llvm::concat<Value>(op->getOperands(), op->getResults())) {
-        if (!isa<MemRefType>(oper.getType()))
-          continue;
-        operands.push_back(oper);
-      }
-    }
-    return operands;
-  };
-  auto getAllMemrefsWrittenByOp = [getAllWriteAccess](Operation *o) {
-    llvm::SetVector<Value> memrefs;
-    auto opWriteAccesses = getAllWriteAccess(o);
-    memrefs.insert(opWriteAccesses.begin(), opWriteAccesses.end());
-    SmallVector<Region *> regions;
-    for (auto &region : o->getRegions())
-      regions.push_back(&region);
-    // If air.wait_all, then we analyze the dependency by collecting all
-    // operations that depend on it.
-    auto waitAllOp = dyn_cast_if_present<air::WaitAllOp>(o);
-    if (waitAllOp && waitAllOp.getAsyncToken()) {
-      for (auto user : waitAllOp.getAsyncToken().getUsers()) {
-        auto userWriteAccesses = getAllWriteAccess(user);
-        memrefs.insert(userWriteAccesses.begin(), userWriteAccesses.end());
-        for (auto &region : user->getRegions())
-          regions.push_back(&region);
-      }
-    }
-    for (auto region : regions) {
-      visitUsedValuesDefinedAbove(*region, [&memrefs,
-                                            getAllWriteAccess](OpOperand *use) {
-        if (llvm::is_contained(getAllWriteAccess(use->getOwner()), use->get()))
-          memrefs.insert(use->get());
-      });
+//===----------------------------------------------------------------------===//
+// Async dependency pruning
+//===----------------------------------------------------------------------===//
+
+// Memref operands `op` reads and writes. Unknown ops are assumed to read all
+// of their memref operands, and to write them and their memref results.
+static void getMemrefAccesses(Operation *op, SmallVectorImpl<Value> &reads,
+                              SmallVectorImpl<Value> &writes) {
+  if (auto linalgop = dyn_cast<linalg::LinalgOp>(op)) {
+    for (auto oper : linalgop.getDpsInputs())
+      reads.push_back(oper);
+    for (auto oper :
+         llvm::concat<Value>(linalgop.getDpsInits(), linalgop->getResults()))
+      writes.push_back(oper);
+  } else if (auto memref_copy = dyn_cast<memref::CopyOp>(op)) {
+    reads.push_back(memref_copy.getSource());
+    writes.push_back(memref_copy.getTarget());
+  } else if (auto memcpy = mlir::dyn_cast<xilinx::air::MemcpyInterface>(op)) {
+    if (memcpy.getSrcMemref())
+      reads.push_back(memcpy.getSrcMemref());
+    if (memcpy.getDstMemref())
+      writes.push_back(memcpy.getDstMemref());
+  } else {
+    for (auto oper : op->getOperands()) {
+      if (!isa<MemRefType>(oper.getType()))
+        continue;
+      reads.push_back(oper);
+      writes.push_back(oper);
     }
-    return memrefs;
-  };
-  auto memrefsReadBySinkOp = getAllMemrefsReadByOp(op.getOperation());
-  auto memrefsWrittenBySinkOp = getAllMemrefsWrittenByOp(op.getOperation());
-  // make a list of new async token operands
-  std::function<void(SmallVector<Value>, SmallVector<Value> &)>
-      getDirectDependenciesGreedily;
-  getDirectDependenciesGreedily = [&getDirectDependenciesGreedily](
-                                      SmallVector<Value> depList,
-                                      SmallVector<Value> &directDeps) {
-    for (auto v : depList) {
-      if (auto wa = dyn_cast_if_present<air::WaitAllOp>(v.getDefiningOp()))
-        getDirectDependenciesGreedily(wa.getAsyncDependencies(), directDeps);
-      else
-        directDeps.push_back(v);
+    for (auto res : op->getResults())
+      if (isa<MemRefType>(res.getType()))
+        writes.push_back(res);
+  }
+}
+
+const AsyncMemoryEffects &AsyncDependencyCache::getEffects(Operation *op) {
+  auto it = effects.find(op);
+  if (it != effects.end())
+    return *it->second;
+
+  auto summary = std::make_unique<AsyncMemoryEffects>();
+  SmallVector<Value> reads, writes;
+  getMemrefAccesses(op, reads, writes);
+  SmallVector<Region *> regions;
+  for (auto &region : op->getRegions())
+    regions.push_back(&region);
+  // If air.wait_all, then we analyze the dependency by collecting all
+  // operations that depend on it.
+  auto waitAllOp = dyn_cast<air::WaitAllOp>(op);
+  if (waitAllOp && waitAllOp.getAsyncToken()) {
+    for (auto user : waitAllOp.getAsyncToken().getUsers()) {
+      getMemrefAccesses(user, reads, writes);
+      for (auto &region : user->getRegions())
+        regions.push_back(&region);
     }
-    return;
-  };
-  llvm::SetVector<Value> newAsyncDeps; // don't include duplicates
+  }
+  summary->reads.insert(reads.begin(), reads.end());
+  summary->writes.insert(writes.begin(), writes.end());
+
+  // Accesses within the regions to memrefs defined above them
+  for (auto region : regions) {
+    region->walk([&](Operation *nested) {
+      SmallVector<Value> nestedReads, nestedWrites;
+      getMemrefAccesses(nested, nestedReads, nestedWrites);
+      auto definedAbove = [region](Value v) {
+        return !region->isAncestor(v.getParentRegion());
+      };
+      for (auto v : nestedReads)
+        if (definedAbove(v))
+          summary->reads.insert(v);
+      for (auto v : nestedWrites)
+        if (definedAbove(v))
+          summary->writes.insert(v);
+    });
+  }
+  return *(effects[op] = std::move(summary));
+}
+
+void AsyncDependencyCache::invalidate(Operation *op) {
+  for (Operation *o = op; o; o = o->getParentOp())
+    effects.erase(o);
+  for (auto oper : op->getOperands())
+    if (auto waitAllOp =
+            dyn_cast_if_present<air::WaitAllOp>(oper.getDefiningOp()))
+      effects.erase(waitAllOp);
+}
+
+LogicalResult air::getPrunedAsyncDependencies(Operation *op,
+                                              AsyncDependencyCache &cache,
+                                              SmallVectorImpl<Value> &newDeps) {
+  auto asyncOp = dyn_cast<air::AsyncOpInterface>(op);
+  if (!asyncOp || asyncOp.getAsyncDependencies().empty())
+    return failure();
+
+  // Look through air.wait_all dependencies
   SmallVector<Value> directDeps;
-  getDirectDependenciesGreedily(op.getAsyncDependencies(), directDeps);
+  SmallVector<Value> worklist(llvm::reverse(asyncOp.getAsyncDependencies()));
+  while (!worklist.empty()) {
+    Value v = worklist.pop_back_val();
+    if (auto wa = dyn_cast_if_present<air::WaitAllOp>(v.getDefiningOp()))
+      llvm::append_range(worklist, llvm::reverse(wa.getAsyncDependencies()));
+    else
+      directDeps.push_back(v);
+  }
+
+  const AsyncMemoryEffects &sink = cache.getEffects(op);
+  llvm::SetVector<Value> deps; // don't include duplicates
   for (auto v : directDeps) {
     // don't include any false dependencies, i.e. sink does not depend on source
     // in RAW, WAR or WAW; RAR is a false dependency
-    if (v.getDefiningOp()) {
-      auto memrefsReadBySourceOp = getAllMemrefsReadByOp(v.getDefiningOp());
-      auto memrefsWrittenBySourceOp =
-          getAllMemrefsWrittenByOp(v.getDefiningOp());
-      bool sourceOpTouchesMemref =
-          llvm::range_size(llvm::concat<Value>(memrefsReadBySourceOp,
-                                               memrefsWrittenBySourceOp)) != 0;
-      bool sinkOpTouchesMemref =
-          llvm::range_size(llvm::concat<Value>(memrefsReadBySinkOp,
-                                               memrefsWrittenBySinkOp)) != 0;
-      if (sourceOpTouchesMemref && sinkOpTouchesMemref) {
-        bool RAWNotFound = llvm::none_of(
-            memrefsWrittenBySourceOp, [&memrefsReadBySinkOp](Value v) {
-              return llvm::is_contained(memrefsReadBySinkOp, v);
-            });
-        bool WARNotFound = llvm::none_of(
-            memrefsReadBySourceOp, [&memrefsWrittenBySinkOp](Value v) {
-              return llvm::is_contained(memrefsWrittenBySinkOp, v);
-            });
-        bool WAWNotFound = llvm::none_of(
-            memrefsWrittenBySourceOp, [&memrefsWrittenBySinkOp](Value v) {
-              return llvm::is_contained(memrefsWrittenBySinkOp, v);
-            });
-        if (RAWNotFound && WARNotFound && WAWNotFound)
-          continue;
-      }
+    if (!sink.empty() && v.getDefiningOp()) {
+      const AsyncMemoryEffects &source = cache.getEffects(v.getDefiningOp());
+      bool hazard = llvm::any_of(source.writes, [&](Value m) {
+        return sink.reads.contains(m) || sink.writes.contains(m);
+      });
+      hazard |= llvm::any_of(source.reads,
+                             [&](Value m) { return sink.writes.contains(m); });
+      if (!source.empty() && !hazard)
+        continue;
     }
-    newAsyncDeps.insert(v);
+    deps.insert(v);
   }
 
   // don't include a dependency of another dependency
-  auto getDepsOfDeps = [](llvm::SetVector<Value> deps) {
-    llvm::SetVector<Value> depsOfDeps;
-    for (auto v : deps) {
-      if (auto asyncOperand =
-              dyn_cast_if_present<AsyncOpInterface>(v.getDefiningOp())) {
-        auto deps = asyncOperand.getAsyncDependencies();
-        depsOfDeps.insert(deps.begin(), deps.end());
-      }
-    }
-    return depsOfDeps;
-  };
-  llvm::SetVector<Value> erased;
-  for (auto v : newAsyncDeps) {
-    if (llvm::is_contained(getDepsOfDeps(newAsyncDeps), v))
-      erased.insert(v);
-  }
-  for (auto e : erased)
-    newAsyncDeps.remove(e);
+  llvm::SmallDenseSet<Value> depsOfDeps;
+  for (auto v : deps)
+    if (auto asyncDep =
+            dyn_cast_if_present<air::AsyncOpInterface>(v.getDefiningOp()))
+      depsOfDeps.insert(asyncDep.getAsyncDependencies().begin(),
+                        asyncDep.getAsyncDependencies().end());
+
+  newDeps.clear();
+  for (auto v : deps)
+    if (!depsOfDeps.contains(v))
+      newDeps.push_back(v);
 
   // if the operands won't change, return
-  if (newAsyncDeps.size() == op.getAsyncDependencies().size())
+  if (newDeps.size() == asyncOp.getAsyncDependencies().size())
     return failure();
+  return success();
+}
 
-  while (op.getAsyncDependencies().size())
-    op.eraseAsyncDependency(0);
-  for (auto v : newAsyncDeps)
-    op.addAsyncDependency(v);
-  auto newOp = rewriter.clone(*op.getOperation());
-  rewriter.replaceOp(op, newOp->getResults());
+template <class OpT>
+static LogicalResult CanonicalizeAsyncOpDeps(OpT op,
+                                             PatternRewriter &rewriter) {
+  // The greedy driver cannot tell which ops changed between two
+  // applications, so summaries are only shared within one. Prefer
+  // -air-prune-async-deps on large async IR.
+  AsyncDependencyCache cache;
+  SmallVector<Value> newAsyncDeps;
+  if (failed(getPrunedAsyncDependencies(op, cache, newAsyncDeps)))
+    return failure();
+
+  rewriter.modifyOpInPlace(op, [&]() {
+    while (op.getAsyncDependencies().size())
+      op.eraseAsyncDependency(0);
+    for (auto v : newAsyncDeps)
+      op.addAsyncDependency(v);
+  });
   return success();
 }
 
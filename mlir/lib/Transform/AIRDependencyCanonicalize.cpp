@@ -10,6 +10,8 @@
 #include "air/Dialect/AIR/AIRDialect.h"
 #include "air/Util/Dependency.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
+
 using namespace mlir;
 using namespace xilinx;
 using namespace xilinx::air;
@@ -65,6 +67,65 @@ private:
   xilinx::air::dependencyContext dep_ctx;
 };
 
+class AIRPruneAsyncDeps
+    : public xilinx::air::impl::AIRPruneAsyncDepsBase<AIRPruneAsyncDeps> {
+
+public:
+  AIRPruneAsyncDeps() = default;
+  AIRPruneAsyncDeps(const AIRPruneAsyncDeps &pass) {}
+
+  void getDependentDialects(::mlir::DialectRegistry &registry) const override {
+    registry.insert<scf::SCFDialect, air::airDialect>();
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+
+    SmallVector<air::AsyncOpInterface> asyncOps;
+    module.walk<WalkOrder::PreOrder>(
+        [&](air::AsyncOpInterface op) { asyncOps.push_back(op); });
+
+    // Summaries are shared across the sweep, and only those covering an op
+    // whose dependencies changed are dropped
+    air::AsyncDependencyCache cache;
+    llvm::SetVector<Operation *> waitAlls;
+    SmallVector<Value> newDeps;
+    for (auto op : asyncOps) {
+      if (failed(air::getPrunedAsyncDependencies(op, cache, newDeps)))
+        continue;
+      cache.invalidate(op);
+      for (auto v : op.getAsyncDependencies())
+        if (auto wa = dyn_cast_if_present<air::WaitAllOp>(v.getDefiningOp()))
+          waitAlls.insert(wa);
+      while (op.getAsyncDependencies().size())
+        op.eraseAsyncDependency(0);
+      for (auto v : newDeps)
+        op.addAsyncDependency(v);
+      cache.invalidate(op);
+    }
+    cache.clear();
+
+    // Erase the air.wait_all ops nothing waits on anymore, and in turn the
+    // ones only they waited on
+    llvm::SmallPtrSet<Operation *, 8> erased;
+    SmallVector<Operation *> worklist(waitAlls.begin(), waitAlls.end());
+    while (!worklist.empty()) {
+      Operation *o = worklist.pop_back_val();
+      if (erased.contains(o))
+        continue;
+      auto wa = cast<air::WaitAllOp>(o);
+      if (!wa.getAsyncToken() || !wa.getAsyncToken().use_empty())
+        continue;
+      SmallVector<Value> deps = wa.getAsyncDependencies();
+      erased.insert(o);
+      wa->erase();
+      for (auto v : deps)
+        if (auto dep = dyn_cast_if_present<air::WaitAllOp>(v.getDefiningOp()))
+          worklist.push_back(dep);
+    }
+  }
+};
+
 } // namespace
 
 namespace xilinx {
@@ -74,5 +135,9 @@ std::unique_ptr<mlir::Pass> createAIRDependencyCanonicalizePass() {
   return std::make_unique<AIRDependencyCanonicalize>();
 }
 
+std::unique_ptr<mlir::Pass> createAIRPruneAsyncDepsPass() {
+  return std::make_unique<AIRPruneAsyncDeps>();
+}
+
 } // namespace air
 } // namespace xilinx
@@ -8,6 +8,7 @@
 
 #include "air/Transform/AIRDependencyScheduleOpt.h"
 #include "air/Dialect/AIR/AIRDialect.h"
+#include "air/Util/ChannelSymbolIndex.h"
 #include "air/Util/Dependency.h"
 
 #include "aie/Dialect/AIE/IR/AIEDialect.h"
@@ -32,6 +33,7 @@
 #include "mlir/IR/OperationSupport.h"
 #include "mlir/IR/PatternMatch.h"
 #include "mlir/Pass/Pass.h"
+#include "mlir/Pass/PassManager.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "mlir/Transforms/InliningUtils.h"
@@ -46,6 +48,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <algorithm>
+#include <limits>
 #include <map>
 #include <numeric>
 #include <string>
@@ -897,12 +900,13 @@ struct ConstructPingPongDependencyPattern
   LogicalResult matchAndRewrite(scf::ForOp for_op,
                                 PatternRewriter &rewriter) const override {
 
-    // Check if the loop has been unrolled by factor 2
+    // Check if the loop has been unrolled by the buffering depth, i.e. factor
+    // 2 for ping-pong, or more for multi-buffering.
     if (!for_op->hasAttr("unroll"))
       return failure();
     uint64_t unroll_factor =
         for_op->getAttrOfType<IntegerAttr>("unroll").getInt();
-    if (unroll_factor != 2)
+    if (unroll_factor < 2)
       return failure();
 
     // Find ping and pong allocs and deallocs
@@ -998,34 +1002,47 @@ struct ConstructPingPongDependencyPattern
     // Construct essential dep edges
 
     // Part 1: alloc to for
-
-    auto alloc_ping_exec = dyn_cast<air::ExecuteOp>(alloc_execs[0]);
-    auto alloc_pong_exec = dyn_cast<air::ExecuteOp>(alloc_execs[1]);
-    auto alloc_ping_token = alloc_ping_exec.getAsyncToken();
-    auto alloc_pong_token = alloc_pong_exec.getAsyncToken();
-    SmallVector<Value> upstream_tokens = alloc_pong_exec.getAsyncDependencies();
-    clearAsyncDependenciesOfAsyncOp(alloc_ping_exec);
-    for (auto t : upstream_tokens) {
-      alloc_ping_exec.addAsyncDependency(t);
+    //
+    // The loop carries one token per buffer, signalling that the buffer is
+    // free to be produced into, followed by the consumer and producer chain
+    // tokens which serialize consumers and producers across iterations.
+
+    unsigned depth = unroll_factor;
+    SmallVector<Value, 1> iter_operands;
+    if (depth == 2) {
+      auto alloc_ping_exec = dyn_cast<air::ExecuteOp>(alloc_execs[0]);
+      auto alloc_pong_exec = dyn_cast<air::ExecuteOp>(alloc_execs[1]);
+      auto alloc_ping_token = alloc_ping_exec.getAsyncToken();
+      auto alloc_pong_token = alloc_pong_exec.getAsyncToken();
+      SmallVector<Value> upstream_tokens =
+          alloc_pong_exec.getAsyncDependencies();
+      clearAsyncDependenciesOfAsyncOp(alloc_ping_exec);
+      for (auto t : upstream_tokens) {
+        alloc_ping_exec.addAsyncDependency(t);
+      }
+      alloc_ping_exec->moveBefore(alloc_pong_exec);
+      iter_operands = {alloc_ping_token, alloc_pong_token, alloc_pong_token,
+                       alloc_pong_token};
+    } else {
+      // The hoisted allocs form a chain ending in the loop's init arg, whose
+      // token therefore implies that every buffer has been allocated.
+      auto alloc_token =
+          dyn_cast<air::ExecuteOp>(alloc_execs[0]).getAsyncToken();
+      iter_operands.assign(depth + 2, alloc_token);
     }
-    alloc_ping_exec->moveBefore(alloc_pong_exec);
-
-    SmallVector<Value, 1> iter_operands = {alloc_ping_token, alloc_pong_token,
-                                           alloc_pong_token, alloc_pong_token};
     scf::ForOp new_loop_op =
         replaceForLoopAndAddIterArgs(rewriter, for_op, iter_operands);
-    for_op.getResult(0).replaceAllUsesWith(new_loop_op.getResult(1));
-
-    // Collect ping/pong producer/consumer fronts and backs for ping pong
-    // dependency edge connection
-    SmallVector<Operation *> ping_producer_fronts;
-    SmallVector<Operation *> ping_producer_backs;
-    SmallVector<Operation *> ping_consumer_fronts;
-    SmallVector<Operation *> ping_consumer_backs;
-    SmallVector<Operation *> pong_producer_fronts;
-    SmallVector<Operation *> pong_producer_backs;
-    SmallVector<Operation *> pong_consumer_fronts;
-    SmallVector<Operation *> pong_consumer_backs;
+    for_op.getResult(0).replaceAllUsesWith(new_loop_op.getResult(depth - 1));
+    auto iter_args = new_loop_op.getRegionIterArgs();
+    Value consumer_chain = iter_args[depth];
+    Value producer_chain = iter_args[depth + 1];
+
+    // Collect producer/consumer fronts and backs of each buffer for
+    // multi-buffering dependency edge connection
+    SmallVector<SmallVector<Operation *>> producer_fronts(depth);
+    SmallVector<SmallVector<Operation *>> producer_backs(depth);
+    SmallVector<SmallVector<Operation *>> consumer_fronts(depth);
+    SmallVector<SmallVector<Operation *>> consumer_backs(depth);
 
     new_loop_op.getBody()->walk([&](Operation *op) {
       if (op->hasAttr("ping_pong") || op->hasAttr("unrolled_iteration")) {
@@ -1034,67 +1051,47 @@ struct ConstructPingPongDependencyPattern
                 ? (op->getAttrOfType<IntegerAttr>("ping_pong").getUInt())
                 : (op->getAttrOfType<IntegerAttr>("unrolled_iteration")
                        .getInt());
-        // "Ping" producer fronts
-        if (op->hasAttr("async_front") && ping_pong_id == 0) {
-          ping_producer_fronts.push_back(op);
-        }
-        // "Pong" producer fronts
-        else if (op->hasAttr("async_front") && ping_pong_id == 1) {
-          pong_producer_fronts.push_back(op);
-        }
-        // "Ping" consumer backs
-        else if (op->hasAttr("async_back") && ping_pong_id == 0) {
-          ping_consumer_backs.push_back(op);
-        }
-        // "Pong" consumer backs
-        else if (op->hasAttr("async_back") && ping_pong_id == 1) {
-          pong_consumer_backs.push_back(op);
-        }
-        // "Ping" producer backs
-        if (op->hasAttr("producer") && ping_pong_id == 0) {
-          ping_producer_backs.push_back(op);
-        }
-        // "Pong" producer backs
-        if (op->hasAttr("producer") && ping_pong_id == 1) {
-          pong_producer_backs.push_back(op);
-        }
-        // "Ping" consumer fronts
-        if (op->hasAttr("consumer") && ping_pong_id == 0) {
-          ping_consumer_fronts.push_back(op);
-        }
-        // "Pong" consumer fronts
-        if (op->hasAttr("consumer") && ping_pong_id == 1) {
-          pong_consumer_fronts.push_back(op);
-        }
+        if (ping_pong_id >= depth)
+          return;
+        if (op->hasAttr("async_front"))
+          producer_fronts[ping_pong_id].push_back(op);
+        else if (op->hasAttr("async_back"))
+          consumer_backs[ping_pong_id].push_back(op);
+        if (op->hasAttr("producer"))
+          producer_backs[ping_pong_id].push_back(op);
+        if (op->hasAttr("consumer"))
+          consumer_fronts[ping_pong_id].push_back(op);
       }
     });
 
-    // Part 2: Connect producers
-    for (auto sink : ping_producer_fronts) {
-      // "Ping" producers
-      addAsyncDependencyIfNew(sink, new_loop_op.getRegionIterArgs()[0]);
-      addAsyncDependencyIfNew(sink, new_loop_op.getRegionIterArgs()[3]);
-    }
-    for (auto sink : pong_producer_fronts) {
-      // "Pong" producers
-      clearAsyncDependenciesOfAsyncOp(sink);
-      addAsyncDependencyIfNew(sink, new_loop_op.getRegionIterArgs()[1]);
-      for (auto source : ping_producer_backs) {
-        Value token = getTokenFromOutermostParentAffineIfOp(source);
-        addAsyncDependencyIfNew(sink, token);
+    // Part 2: Connect producers. The first buffer's producers wait for the
+    // last buffer's producers of the previous iteration; every other buffer's
+    // producers wait for the previous buffer's producers.
+    for (auto sink : producer_fronts[0]) {
+      addAsyncDependencyIfNew(sink, iter_args[0]);
+      addAsyncDependencyIfNew(sink, producer_chain);
+    }
+    for (unsigned i = 1; i < depth; i++) {
+      for (auto sink : producer_fronts[i]) {
+        clearAsyncDependenciesOfAsyncOp(sink);
+        addAsyncDependencyIfNew(sink, iter_args[i]);
+        for (auto source : producer_backs[i - 1]) {
+          Value token = getTokenFromOutermostParentAffineIfOp(source);
+          addAsyncDependencyIfNew(sink, token);
+        }
       }
     }
 
-    // Part 3: Connect consumers
-    for (auto sink : ping_consumer_fronts) {
-      // "Ping" consumers
-      addAsyncDependencyIfNew(sink, new_loop_op.getRegionIterArgs()[2]);
+    // Part 3: Connect consumers, in the same round-robin order.
+    for (auto sink : consumer_fronts[0]) {
+      addAsyncDependencyIfNew(sink, consumer_chain);
     }
-    for (auto sink : pong_consumer_fronts) {
-      // "Pong" consumers
-      for (auto source : ping_consumer_backs) {
-        Value token = getTokenFromOutermostParentAffineIfOp(source);
-        addAsyncDependencyIfNew(sink, token);
+    for (unsigned i = 1; i < depth; i++) {
+      for (auto sink : consumer_fronts[i]) {
+        for (auto source : consumer_backs[i - 1]) {
+          Value token = getTokenFromOutermostParentAffineIfOp(source);
+          addAsyncDependencyIfNew(sink, token);
+        }
       }
     }
 
@@ -1102,11 +1099,14 @@ struct ConstructPingPongDependencyPattern
     // Note: currently only supports producer and consumer dep graphs with
     // single back
     rewriter.setInsertionPointToEnd(new_loop_op.getBody());
-    SmallVector<Value, 1> yield_operands = {
-        getJointTokenFromOps(rewriter, ping_consumer_backs),
-        getJointTokenFromOps(rewriter, pong_consumer_backs),
-        getJointTokenFromOps(rewriter, pong_consumer_backs),
-        getJointTokenFromOps(rewriter, pong_producer_backs)};
+    SmallVector<Value, 1> yield_operands;
+    for (unsigned i = 0; i < depth; i++)
+      yield_operands.push_back(
+          getJointTokenFromOps(rewriter, consumer_backs[i]));
+    yield_operands.push_back(
+        getJointTokenFromOps(rewriter, consumer_backs[depth - 1]));
+    yield_operands.push_back(
+        getJointTokenFromOps(rewriter, producer_backs[depth - 1]));
     for (auto v : yield_operands) {
       if (!v)
         return failure();
@@ -1435,6 +1435,15 @@ private:
 struct LabelScfForLoopForPingPongPattern : public OpRewritePattern<scf::ForOp> {
   using OpRewritePattern<scf::ForOp>::OpRewritePattern;
 
+  // A depth of zero picks the buffering depth per loop, from the L1 headroom
+  // and an estimate of the loop's DMA and compute latencies.
+  LabelScfForLoopForPingPongPattern(MLIRContext *ctx, unsigned depth = 2,
+                                    unsigned l1Size = 65536,
+                                    unsigned dmaBytesPerCycle = 4,
+                                    unsigned opsPerCycle = 64)
+      : OpRewritePattern(ctx), depth(depth), l1Size(l1Size),
+        dmaBytesPerCycle(dmaBytesPerCycle), opsPerCycle(opsPerCycle) {}
+
   LogicalResult matchAndRewrite(scf::ForOp for_op,
                                 PatternRewriter &rewriter) const override {
 
@@ -1453,8 +1462,15 @@ struct LabelScfForLoopForPingPongPattern : public OpRewritePattern<scf::ForOp> {
       return failure();
 
     // Label the scf.for loop and all its child memref.allocs
-    int unroll_factor = 2; // Unroll factor hardened as 2. TODO: add support for
-                           // an arbitrary factor.
+    int unroll_factor = depth ? depth : chooseDepth(for_op, alloc_ops);
+    // The loop is unrolled by the depth, which must divide its trip count.
+    if (auto tripCount = air::getStaticScfForTripCountAsInt(for_op)) {
+      for (unroll_factor = std::min(unroll_factor, (int)*tripCount);
+           unroll_factor > 2; unroll_factor--)
+        if (*tripCount % unroll_factor == 0)
+          break;
+      unroll_factor = std::max(unroll_factor, 2);
+    }
     for_op->setAttr("unroll", rewriter.getI32IntegerAttr(unroll_factor));
     for (auto op : alloc_ops) {
       op->setAttr("hoist_alloc", rewriter.getBoolAttr(true));
@@ -1464,6 +1480,54 @@ struct LabelScfForLoopForPingPongPattern : public OpRewritePattern<scf::ForOp> {
   }
 
 private:
+  unsigned depth;
+  unsigned l1Size;
+  unsigned dmaBytesPerCycle;
+  unsigned opsPerCycle;
+
+  static int64_t getMemrefBytes(Value memref) {
+    return air::getTensorVolume(memref.getType()) *
+           air::getElementSizeInBytes(memref.getType());
+  }
+
+  // Pick the number of buffers which hides the DMA latency of filling one
+  // buffer behind the compute of the others, as far as the L1 memory left
+  // over by the rest of the herd allows.
+  int chooseDepth(scf::ForOp for_op,
+                  SmallVector<Operation *> &alloc_ops) const {
+    int64_t bufferBytes = 0;
+    for (auto op : alloc_ops)
+      bufferBytes += getMemrefBytes(op->getResult(0));
+    int64_t maxDepthByMemory = std::numeric_limits<int>::max();
+    if (auto herd = for_op->getParentOfType<air::HerdOp>()) {
+      int64_t otherBytes = 0;
+      herd.walk([&](memref::AllocOp alloc) {
+        if (!llvm::is_contained(alloc_ops, alloc.getOperation()))
+          otherBytes += getMemrefBytes(alloc.getMemref());
+      });
+      if (bufferBytes)
+        maxDepthByMemory = ((int64_t)l1Size - otherBytes) / bufferBytes;
+    }
+
+    int64_t computeOps = 0;
+    for_op.getBody()->walk([&](linalg::LinalgOp linalgOp) {
+      int64_t ops = 1;
+      for (auto range : linalgOp.getStaticLoopRanges())
+        if (!ShapedType::isDynamic(range))
+          ops *= range;
+      computeOps += ops;
+    });
+    int64_t maxDepthByLatency = 2;
+    if (computeOps) {
+      int64_t dmaCycles =
+          llvm::divideCeilSigned(bufferBytes, (int64_t)dmaBytesPerCycle);
+      int64_t computeCycles =
+          llvm::divideCeilSigned(computeOps, (int64_t)opsPerCycle);
+      maxDepthByLatency = 1 + llvm::divideCeilSigned(dmaCycles, computeCycles);
+    }
+
+    return std::max((int64_t)2, std::min(maxDepthByLatency, maxDepthByMemory));
+  }
 };
 
 struct LabelScfForLoopInAIRSegment : public OpRewritePattern<scf::ForOp> {
@@ -3034,6 +3098,241 @@ public:
 private:
 };
 
+class AIRMultiBuffer
+    : public xilinx::air::impl::AIRMultiBufferBase<AIRMultiBuffer> {
+
+public:
+  AIRMultiBuffer() = default;
+  AIRMultiBuffer(const AIRMultiBuffer &pass){};
+  AIRMultiBuffer(const AIRMultiBufferOptions &options)
+      : AIRMultiBufferBase(options) {}
+
+  void getDependentDialects(::mlir::DialectRegistry &registry) const override {
+    registry.insert<scf::SCFDialect, air::airDialect>();
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+    auto ctx = &getContext();
+    RewritePatternSet patterns(ctx);
+    patterns.insert<LabelScfForLoopForPingPongPattern>(
+        ctx, clDepth, clL1Size, std::max((unsigned)clDmaBytesPerCycle, 1u),
+        std::max((unsigned)clOpsPerCycle, 1u));
+    (void)applyPatternsGreedily(module, std::move(patterns));
+
+    // Hoisting, unrolling and dependency construction follow the labelled
+    // unroll factor, so the ping-pong transformation handles any depth.
+    AIRPingPongTransformationPatternOptions options;
+    options.clKeepMemrefDealloc = clKeepMemrefDealloc;
+    OpPassManager pm(ModuleOp::getOperationName());
+    pm.addPass(createAIRPingPongTransformationPattern(options));
+    if (failed(runPipeline(pm, module)))
+      signalPassFailure();
+  }
+
+private:
+};
+
+// Software pipeline an scf.for loop in an air.herd body into two stages: the
+// channel gets and compute of an iteration (stage 0), and the channel puts
+// writing back its results (stage 1). The kernel overlaps stage 1 of iteration
+// i-1 with stage 0 of iteration i, after a prologue running stage 0 of the
+// first iteration, and before an epilogue running stage 1 of the last one.
+// Returns the initiation interval of the kernel, in operations on its busiest
+// resource.
+static FailureOr<unsigned> pipelineHerdLoop(scf::ForOp forOp) {
+  if (forOp.getNumRegionIterArgs() != 1 ||
+      !isa<air::AsyncTokenType>(forOp.getRegionIterArgs()[0].getType()))
+    return failure();
+  auto lb = getConstantIntValue(forOp.getLowerBound());
+  auto ub = getConstantIntValue(forOp.getUpperBound());
+  auto step = getConstantIntValue(forOp.getStep());
+  if (!lb || !ub || !step || *step <= 0 || (*ub - *lb) % *step ||
+      (*ub - *lb) / *step < 2)
+    return failure();
+
+  // Ops which are recomputed in whichever stage uses them.
+  auto isCloneable = [](Operation *op) {
+    return air::isPure(op) || isa<air::WaitAllOp>(op);
+  };
+  Block *body = forOp.getBody();
+  llvm::DenseMap<Operation *, unsigned> stage;
+  SmallVector<Value> getMemrefs, putMemrefs;
+  unsigned numGets = 0, numPuts = 0, numComputes = 0;
+  for (auto &op : body->without_terminator()) {
+    if (isCloneable(&op))
+      continue;
+    if (auto get = dyn_cast<air::ChannelGetOp>(op)) {
+      stage[&op] = 0;
+      getMemrefs.push_back(get.getMemref());
+      numGets++;
+    } else if (auto put = dyn_cast<air::ChannelPutOp>(op)) {
+      stage[&op] = 1;
+      putMemrefs.push_back(put.getMemref());
+      numPuts++;
+    } else if (auto exec = dyn_cast<air::ExecuteOp>(op)) {
+      if (llvm::any_of(exec.getChildOps(), [](Operation &child) {
+            return isa<memref::AllocOp, memref::DeallocOp>(child);
+          }))
+        return failure();
+      stage[&op] = 0;
+      numComputes++;
+    } else
+      return failure();
+  }
+  if (!numGets || !numPuts)
+    return failure();
+  // A buffer which is both loaded and written back cannot be overlapped.
+  if (llvm::any_of(getMemrefs, [&](Value memref) {
+        return llvm::is_contained(putMemrefs, memref);
+      }))
+    return failure();
+
+  // Cloneable ops needed by each stage, and the values which stage 1 uses
+  // from stage 0 of the same iteration. Stage 0 of an iteration runs before
+  // stage 1 of the previous one completes, so a stage 0 op cannot use a
+  // stage 1 value.
+  SmallVector<llvm::SetVector<Operation *>> needed(2);
+  llvm::DenseSet<Value> crossingSet;
+  for (unsigned s = 0; s < 2; s++) {
+    SmallVector<Operation *> worklist;
+    for (auto &op : body->without_terminator())
+      if (stage.count(&op) && stage[&op] == s)
+        worklist.push_back(&op);
+    while (!worklist.empty()) {
+      Operation *root = worklist.pop_back_val();
+      auto walkResult = root->walk([&](Operation *nested) {
+        for (Value v : nested->getOperands()) {
+          Operation *def = v.getDefiningOp();
+          if (!def || def->getBlock() != body)
+            continue;
+          if (isCloneable(def)) {
+            if (needed[s].insert(def))
+              worklist.push_back(def);
+          } else if (stage.lookup(def) > s) {
+            return WalkResult::interrupt();
+          } else if (stage.lookup(def) < s) {
+            crossingSet.insert(v);
+          }
+        }
+        return WalkResult::advance();
+      });
+      if (walkResult.wasInterrupted())
+        return failure();
+    }
+  }
+  // Carry the crossing values through iter_args in body order.
+  SmallVector<Value> crossing;
+  for (auto &op : body->without_terminator())
+    for (Value v : op.getResults())
+      if (crossingSet.contains(v))
+        crossing.push_back(v);
+
+  OpBuilder builder(forOp);
+  auto loc = forOp.getLoc();
+  auto ctx = forOp->getContext();
+  Value carried = forOp.getRegionIterArgs()[0];
+  Value iv = forOp.getInductionVar();
+  auto joinTokens = [&](SmallVector<Value> tokens) {
+    return builder
+        .create<air::WaitAllOp>(loc, air::AsyncTokenType::get(ctx), tokens)
+        .getAsyncToken();
+  };
+  // Clone one stage of the loop body; stage 0 ops other than the loads also
+  // wait for `writeBack`, when given.
+  auto cloneStage = [&](unsigned s, IRMapping &remap, Value writeBack) {
+    SmallVector<Value> tokens;
+    for (auto &op : body->without_terminator()) {
+      bool inStage = stage.count(&op) ? stage[&op] == s : needed[s].count(&op);
+      if (!inStage)
+        continue;
+      Operation *newOp = builder.clone(op, remap);
+      if (!stage.count(&op))
+        continue;
+      if (writeBack && !isa<air::ChannelGetOp>(newOp))
+        air::addAsyncDependencyIfNew(newOp, writeBack);
+      tokens.push_back(air::getAsyncTokenFromOp(newOp));
+    }
+    return tokens;
+  };
+
+  // Prologue: stage 0 of the first iteration.
+  IRMapping prologueMap;
+  prologueMap.map(iv, forOp.getLowerBound());
+  prologueMap.map(carried, forOp.getInitArgs()[0]);
+  Value prologueToken = joinTokens(cloneStage(0, prologueMap, nullptr));
+  SmallVector<Value> iterArgs = {prologueToken, forOp.getInitArgs()[0]};
+  for (Value v : crossing)
+    iterArgs.push_back(prologueMap.lookup(v));
+
+  // Kernel: stage 1 of the previous iteration, then stage 0 of this one. The
+  // loads only wait for the previous compute, through the first iter_arg.
+  auto kernel = builder.create<scf::ForOp>(
+      loc, builder.create<arith::ConstantIndexOp>(loc, *lb + *step),
+      forOp.getUpperBound(), forOp.getStep(), iterArgs);
+  builder.setInsertionPointToStart(kernel.getBody());
+  IRMapping writeBackMap;
+  writeBackMap.map(iv, builder.create<arith::SubIOp>(
+                           loc, kernel.getInductionVar(), forOp.getStep()));
+  writeBackMap.map(carried, kernel.getRegionIterArgs()[1]);
+  for (auto [i, v] : llvm::enumerate(crossing))
+    writeBackMap.map(v, kernel.getRegionIterArgs()[i + 2]);
+  Value writeBackToken = joinTokens(cloneStage(1, writeBackMap, nullptr));
+  IRMapping loadMap;
+  loadMap.map(iv, kernel.getInductionVar());
+  loadMap.map(carried, kernel.getRegionIterArgs()[0]);
+  Value loadToken = joinTokens(cloneStage(0, loadMap, writeBackToken));
+  SmallVector<Value> yieldOperands = {loadToken, writeBackToken};
+  for (Value v : crossing)
+    yieldOperands.push_back(loadMap.lookup(v));
+  builder.create<scf::YieldOp>(loc, yieldOperands);
+
+  // Epilogue: stage 1 of the last iteration.
+  builder.setInsertionPointAfter(kernel);
+  IRMapping epilogueMap;
+  epilogueMap.map(
+      iv, builder.create<arith::ConstantIndexOp>(loc, *ub - *step).getResult());
+  epilogueMap.map(carried, kernel.getResult(1));
+  for (auto [i, v] : llvm::enumerate(crossing))
+    epilogueMap.map(v, kernel.getResult(i + 2));
+  SmallVector<Value> epilogueTokens = cloneStage(1, epilogueMap, nullptr);
+  epilogueTokens.push_back(kernel.getResult(0));
+  forOp.getResult(0).replaceAllUsesWith(joinTokens(epilogueTokens));
+  forOp.erase();
+
+  return std::max({numGets, numPuts, numComputes});
+}
+
+class AIRSoftwarePipeline
+    : public xilinx::air::impl::AIRSoftwarePipelineBase<AIRSoftwarePipeline> {
+
+public:
+  AIRSoftwarePipeline() = default;
+  AIRSoftwarePipeline(const AIRSoftwarePipeline &pass){};
+
+  void getDependentDialects(::mlir::DialectRegistry &registry) const override {
+    registry.insert<scf::SCFDialect, arith::ArithDialect, air::airDialect>();
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+    SmallVector<scf::ForOp> candidates;
+    module.walk([&](air::HerdOp herd) {
+      herd.walk([&](scf::ForOp forOp) { candidates.push_back(forOp); });
+    });
+    for (auto forOp : candidates) {
+      auto ii = pipelineHerdLoop(forOp);
+      if (failed(ii))
+        continue;
+      ++numPipelinedLoops;
+      if (*ii > initiationInterval.getValue())
+        initiationInterval = *ii;
+    }
+  }
+
+private:
+};
+
 class AIRLabelScfForLoopInAIRSegmentPattern
     : public xilinx::air::impl::AIRLabelScfForLoopInAIRSegmentPatternBase<
           AIRLabelScfForLoopInAIRSegmentPattern> {
@@ -3451,18 +3750,21 @@ public:
     // Rename symbols
     // TODO: make this greedy
     auto renameSymbols =
-        [](std::vector<air::ChannelOp> &channelOps,
-           std::map<air::ChannelOp, air::ChannelOp> chan_merge_map) {
+        [this](std::vector<air::ChannelOp> &channelOps,
+               std::map<air::ChannelOp, air::ChannelOp> chan_merge_map) {
           for (unsigned i = 0; i < channelOps.size(); i++) {
             for (auto chanKey : channelOps) {
               if (!chan_merge_map.count(chanKey))
                 continue;
+              auto newName =
+                  mlir::SymbolTable::getSymbolName(chan_merge_map[chanKey]);
               auto error = mlir::SymbolTable::replaceAllSymbolUses(
-                  chanKey.getOperation(),
-                  mlir::SymbolTable::getSymbolName(chan_merge_map[chanKey]),
+                  chanKey.getOperation(), newName,
                   chanKey->getParentOfType<ModuleOp>());
               // FIXME: what if this fails?
               (void)error;
+              chanIndex->replaceSymbol(
+                  mlir::SymbolTable::getSymbolName(chanKey), newName);
             }
           }
         };
@@ -3498,13 +3800,43 @@ public:
     }
     renameSymbols(channelOps, chan_merge_map);
     if (!targetMemorySpaces.empty()) {
+      // Bytes carried by each channel, and the number of channels still
+      // competing for DMA channels in the aggressive-mode memory spaces.
+      std::map<air::ChannelOp, int64_t> channelBytes;
+      unsigned numLiveChannels = 0;
+      for (auto chan : channelOps) {
+        auto puts = chanIndex->getChannelPutOps(chan);
+        auto gets = chanIndex->getChannelGetOps(chan);
+        if (chan_merge_map.count(chan) ||
+            !hitsMemorySpaceForAggMode(puts, gets))
+          continue;
+        channelBytes[chan] = getChannelTrafficInBytes(puts);
+        numLiveChannels++;
+      }
       for (unsigned i = 0; i < channelOps.size() - 1; i++) {
         for (unsigned j = i + 1; j < channelOps.size(); j++) {
+          if (clChannelBudget && numLiveChannels <= clChannelBudget)
+            break;
+          // Under a budget, only fuse into channels which still own their
+          // traffic, so that the accounted bytes stay accurate.
+          if ((clBandwidthBudget || clChannelBudget) &&
+              chan_merge_map.count(channelOps[i]))
+            break;
           if (!checkIfMergeable(channelOps[i], channelOps[j]))
             continue;
+          int64_t fusedBytes =
+              channelBytes[channelOps[i]] + channelBytes[channelOps[j]];
+          if (clBandwidthBudget && fusedBytes > (int64_t)clBandwidthBudget) {
+            ++numFusionsOverBudget;
+            continue;
+          }
           // Aggressively fuse air.channels by time multiplexing.
           mergeChannels(channelOps[i], channelOps[j]);
+          if (!chan_merge_map.count(channelOps[j]))
+            numLiveChannels--;
           chan_merge_map[channelOps[j]] = channelOps[i];
+          channelBytes[channelOps[i]] = fusedBytes;
+          ++numAggressiveFusions;
         }
       }
     }
@@ -3574,6 +3906,10 @@ public:
     std::vector<air::ChannelOp> channelOps;
     module.walk([&](air::ChannelOp op) { channelOps.push_back(op); });
     module.walk([&](func::FuncOp op) { funcOps.push_back(op); });
+    auto &index = getAnalysis<air::ChannelSymbolIndex>();
+    air::ChannelSymbolIndex::Listener listener(index);
+    chanIndex = &index;
+    chanListener = &listener;
     for (auto f : funcOps) {
       runOnFunction(f, channelOps);
       // Canonicalization patterns.
@@ -3581,7 +3917,11 @@ public:
       air::WaitAllOp::getCanonicalizationPatterns(patterns, ctx);
       scf::ForOp::getCanonicalizationPatterns(patterns, ctx);
       (void)applyPatternsGreedily(f, std::move(patterns));
+      // Loop canonicalization may have erased channel ops
+      index.rebuild();
     }
+    chanIndex = nullptr;
+    chanListener = nullptr;
   }
 
   void init_options() {
@@ -3603,6 +3943,11 @@ public:
   SmallVector<unsigned> targetMemorySpaces;
 
 private:
+  // Puts and gets of each channel, kept up to date with the channel ops
+  // created and erased while fusing.
+  air::ChannelSymbolIndex *chanIndex = nullptr;
+  air::ChannelSymbolIndex::Listener *chanListener = nullptr;
+
   // Get a vector of channel ops which can be fused using a new for loop.
   template <typename T>
   bool areConsistentMemoryAccessPattern(std::vector<T> a_vec,
@@ -3627,8 +3972,8 @@ private:
   }
   std::vector<air::ChannelPutOp>
   getChannelPutsFusableByFor(air::ChannelOp chanA, air::ChannelOp chanB) {
-    std::vector<air::ChannelPutOp> a_puts = getChannelPutOpThroughSymbol(chanA);
-    std::vector<air::ChannelPutOp> b_puts = getChannelPutOpThroughSymbol(chanB);
+    std::vector<air::ChannelPutOp> a_puts = chanIndex->getChannelPutOps(chanA);
+    std::vector<air::ChannelPutOp> b_puts = chanIndex->getChannelPutOps(chanB);
 
     if (areConsistentMemoryAccessPattern<air::ChannelPutOp>(a_puts, b_puts))
       return a_puts;
@@ -3637,8 +3982,8 @@ private:
   }
   std::vector<air::ChannelGetOp>
   getChannelGetsFusableByFor(air::ChannelOp chanA, air::ChannelOp chanB) {
-    std::vector<air::ChannelGetOp> a_gets = getChannelGetOpThroughSymbol(chanA);
-    std::vector<air::ChannelGetOp> b_gets = getChannelGetOpThroughSymbol(chanB);
+    std::vector<air::ChannelGetOp> a_gets = chanIndex->getChannelGetOps(chanA);
+    std::vector<air::ChannelGetOp> b_gets = chanIndex->getChannelGetOps(chanB);
 
     if (areConsistentMemoryAccessPattern<air::ChannelGetOp>(a_gets, b_gets))
       return a_gets;
@@ -3650,7 +3995,7 @@ private:
   void createDummyForOpsAroundOps(std::vector<T> ops) {
     for (auto t_o : ops) {
       Operation *op = t_o.getOperation();
-      OpBuilder builder(op);
+      OpBuilder builder(op, chanListener);
       IRMapping remap;
       auto loc = op->getLoc();
       auto ctx = op->getContext();
@@ -3678,20 +4023,21 @@ private:
       } else
         builder.create<scf::YieldOp>(loc);
     }
+    IRRewriter rewriter(&getContext(), chanListener);
     for (auto e : ops)
-      e->erase();
+      rewriter.eraseOp(e);
     return;
   }
 
   void sortChannelsByLoopNests(air::ChannelOp &chan_a, air::ChannelOp &chan_b) {
     std::vector<air::ChannelPutOp> a_puts =
-        getChannelPutOpThroughSymbol(chan_a);
+        chanIndex->getChannelPutOps(chan_a);
     std::vector<air::ChannelPutOp> b_puts =
-        getChannelPutOpThroughSymbol(chan_b);
+        chanIndex->getChannelPutOps(chan_b);
     std::vector<air::ChannelGetOp> a_gets =
-        getChannelGetOpThroughSymbol(chan_a);
+        chanIndex->getChannelGetOps(chan_a);
     std::vector<air::ChannelGetOp> b_gets =
-        getChannelGetOpThroughSymbol(chan_b);
+        chanIndex->getChannelGetOps(chan_b);
     assert(a_puts.size() == 1);
     assert(b_puts.size() == 1);
     assert(a_gets.size() == 1);
@@ -3739,18 +4085,28 @@ private:
     return false;
   }
 
+  // Bytes moved through a channel by its puts, scaling each put's volume by
+  // the static trip counts of its enclosing scf.for loops.
+  int64_t getChannelTrafficInBytes(std::vector<air::ChannelPutOp> &puts) {
+    int64_t bytes = 0;
+    for (auto put : puts)
+      bytes += air::getMemcpyVolumeInBytes(
+          cast<air::MemcpyInterface>(put.getOperation()), /*isSrc=*/true);
+    return bytes;
+  }
+
   bool checkIfMergeable(air::ChannelOp chan_a, air::ChannelOp chan_b) {
     // Check which memory space to time-multiplex channels onto.
     if (targetMemorySpaces.empty())
       return false;
     std::vector<air::ChannelPutOp> a_puts =
-        getChannelPutOpThroughSymbol(chan_a);
+        chanIndex->getChannelPutOps(chan_a);
     std::vector<air::ChannelPutOp> b_puts =
-        getChannelPutOpThroughSymbol(chan_b);
+        chanIndex->getChannelPutOps(chan_b);
     std::vector<air::ChannelGetOp> a_gets =
-        getChannelGetOpThroughSymbol(chan_a);
+        chanIndex->getChannelGetOps(chan_a);
     std::vector<air::ChannelGetOp> b_gets =
-        getChannelGetOpThroughSymbol(chan_b);
+        chanIndex->getChannelGetOps(chan_b);
     if (a_puts.size() != b_puts.size())
       return false;
     if (a_gets.size() != b_gets.size())
@@ -3928,13 +4284,13 @@ private:
   std::tuple<bool, std::string>
   checkIfTemporalMergeable(air::ChannelOp chan_a, air::ChannelOp chan_b) {
     std::vector<air::ChannelPutOp> a_puts =
-        getChannelPutOpThroughSymbol(chan_a);
+        chanIndex->getChannelPutOps(chan_a);
     std::vector<air::ChannelPutOp> b_puts =
-        getChannelPutOpThroughSymbol(chan_b);
+        chanIndex->getChannelPutOps(chan_b);
     std::vector<air::ChannelGetOp> a_gets =
-        getChannelGetOpThroughSymbol(chan_a);
+        chanIndex->getChannelGetOps(chan_a);
     std::vector<air::ChannelGetOp> b_gets =
-        getChannelGetOpThroughSymbol(chan_b);
+        chanIndex->getChannelGetOps(chan_b);
     std::tuple<bool, std::string> notMergeable = {false, ""};
     std::tuple<bool, std::string> mergeableToLB = {true, "LB"};
     std::tuple<bool, std::string> mergeableToUB = {true, "UB"};
@@ -4150,7 +4506,7 @@ private:
       return;
     IRMapping remap;
     remapAllParentLoopArgs(remap, a, b);
-    OpBuilder builder(a);
+    OpBuilder builder(a, chanListener);
     builder.setInsertionPointAfter(a);
     auto new_b = cloneOpAndOperands(builder, remap, b);
     if (air::isAsyncOp(a) && air::isAsyncOp(new_b)) {
@@ -4168,7 +4524,7 @@ private:
       auto waitAll = air::replaceAsyncOpWithWaitAll(builder, waitAllRemap, b);
       air::getAsyncTokenFromOp(b).replaceAllUsesWith(waitAll.getAsyncToken());
     }
-    b->erase();
+    IRRewriter(builder).eraseOp(b);
   }
   // Fuse parent region nests to both a and b, interleaving pairs of
   // air::ChannelInterface ops, originating from a and b loop nests
@@ -4210,7 +4566,7 @@ private:
     if (!mismatchScfFor)
       return;
 
-    OpBuilder builder(mismatchScfFor);
+    OpBuilder builder(mismatchScfFor, chanListener);
     if (mergeByLBOrUB == "LB") {
       int originalLB = *getConstantIntValue(mismatchScfFor.getLowerBound());
       assert(originalLB > 0);
@@ -4233,17 +4589,17 @@ private:
       auto waitAll = air::replaceAsyncOpWithWaitAll(builder, remap, b);
       air::getAsyncTokenFromOp(b).replaceAllUsesWith(waitAll.getAsyncToken());
     }
-    b->erase();
+    IRRewriter(builder).eraseOp(b);
   }
   void mergeChannels(air::ChannelOp chan_a, air::ChannelOp chan_b) {
     std::vector<air::ChannelPutOp> a_puts =
-        getChannelPutOpThroughSymbol(chan_a);
+        chanIndex->getChannelPutOps(chan_a);
     std::vector<air::ChannelPutOp> b_puts =
-        getChannelPutOpThroughSymbol(chan_b);
+        chanIndex->getChannelPutOps(chan_b);
     std::vector<air::ChannelGetOp> a_gets =
-        getChannelGetOpThroughSymbol(chan_a);
+        chanIndex->getChannelGetOps(chan_a);
     std::vector<air::ChannelGetOp> b_gets =
-        getChannelGetOpThroughSymbol(chan_b);
+        chanIndex->getChannelGetOps(chan_b);
     // Interleave puts and gets
     for (unsigned i = 0; i < a_puts.size(); i++)
       fuseParentRegionNestByIneterleaving(a_puts[i], b_puts[i]);
@@ -4253,13 +4609,13 @@ private:
   void mergeChannelOpsTemporally(air::ChannelOp chan_a, air::ChannelOp chan_b,
                                  std::string mergeByLBOrUB) {
     std::vector<air::ChannelPutOp> a_puts =
-        getChannelPutOpThroughSymbol(chan_a);
+        chanIndex->getChannelPutOps(chan_a);
     std::vector<air::ChannelPutOp> b_puts =
-        getChannelPutOpThroughSymbol(chan_b);
+        chanIndex->getChannelPutOps(chan_b);
     std::vector<air::ChannelGetOp> a_gets =
-        getChannelGetOpThroughSymbol(chan_a);
+        chanIndex->getChannelGetOps(chan_a);
     std::vector<air::ChannelGetOp> b_gets =
-        getChannelGetOpThroughSymbol(chan_b);
+        chanIndex->getChannelGetOps(chan_b);
     if (!b_puts[0]->getParentOfType<air::HerdOp>()) {
       mergeChannelOpsTemporally(a_puts[0], b_puts[0], mergeByLBOrUB);
     }
@@ -6155,6 +6511,18 @@ std::unique_ptr<Pass> createAIRLabelScfForLoopForPingPongPattern() {
   return std::make_unique<AIRLabelScfForLoopForPingPongPattern>();
 }
 
+std::unique_ptr<Pass> createAIRMultiBuffer() {
+  return std::make_unique<AIRMultiBuffer>();
+}
+std::unique_ptr<OperationPass<ModuleOp>>
+createAIRMultiBuffer(const AIRMultiBufferOptions &options) {
+  return std::make_unique<AIRMultiBuffer>(options);
+}
+
+std::unique_ptr<Pass> createAIRSoftwarePipeline() {
+  return std::make_unique<AIRSoftwarePipeline>();
+}
+
 std::unique_ptr<Pass> createAIRLabelScfForLoopInAIRSegmentPattern() {
   return std::make_unique<AIRLabelScfForLoopInAIRSegmentPattern>();
 }
@@ -7,6 +7,7 @@
 
 #include "air/Transform/AIRDmaToChannel.h"
 #include "air/Dialect/AIR/AIRDialect.h"
+#include "air/Util/ChannelSymbolIndex.h"
 #include "air/Util/Dependency.h"
 
 #include "mlir/Analysis/SliceAnalysis.h"
@@ -15,6 +16,7 @@
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/IR/IntegerSet.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "mlir/Transforms/RegionUtils.h"
 
@@ -1369,10 +1371,173 @@ class AIRDemoteDmaToAIRHierarchyConversion
     return success();
   }
 };
+
+// Returns the ops in `par` which have side effects, other than `put`, the ops
+// nesting it, and token plumbing such as air.wait_all or scf.reduce.
+static SmallVector<Operation *> getOtherImpureOps(scf::ParallelOp par,
+                                                  Operation *put) {
+  SmallVector<Operation *> others;
+  par.getBody()->walk<WalkOrder::PreOrder>([&](Operation *o) {
+    if (o == put || o->isAncestor(put) ||
+        o->hasTrait<OpTrait::IsTerminator>() || isa<air::WaitAllOp>(o) ||
+        air::isPure(o))
+      return WalkResult::advance();
+    others.push_back(o);
+    return WalkResult::skip();
+  });
+  return others;
+}
+
+// Removes `op`, standing in an air.wait_all on its dependencies for its async
+// token, if any.
+static void eraseKeepingDeps(OpBuilder &builder, Operation *op) {
+  if (air::isAsyncOp(op)) {
+    builder.setInsertionPoint(op);
+    air::getAsyncTokenFromOp(op).replaceAllUsesWith(
+        builder
+            .create<air::WaitAllOp>(op->getLoc(),
+                                    air::AsyncTokenType::get(op->getContext()),
+                                    air::getAsyncDependenciesFromOp(op))
+            .getAsyncToken());
+  }
+  op->erase();
+}
+
+// Moves `put` out of `par` into a copy of `par` of its own, keeping all other
+// ops `others` of `par` with side effects where they are. The tokens of both
+// parallels are joined for the users of `par`. Returns the put in the new
+// parallel, or a null op if `par` can't be split.
+static air::ChannelPutOp
+hoistPutIntoOwnParallel(scf::ParallelOp par, air::ChannelPutOp put,
+                        ArrayRef<Operation *> others,
+                        air::ChannelSymbolIndex &chanIndex) {
+  auto isToken = [](Value v) { return isa<air::AsyncTokenType>(v.getType()); };
+  if (!llvm::all_of(par->getResults(), isToken))
+    return {};
+  for (auto o : others)
+    if (!llvm::all_of(o->getResults(),
+                      [&](Value v) { return isToken(v) || v.use_empty(); }))
+      return {};
+
+  OpBuilder builder(par);
+  builder.setInsertionPointAfter(par);
+  IRMapping remap;
+  auto newPar = cast<scf::ParallelOp>(builder.clone(*par, remap));
+  auto newPut = cast<air::ChannelPutOp>(remap.lookup(put.getOperation()));
+  for (auto o : others)
+    eraseKeepingDeps(builder, remap.lookup(o));
+  chanIndex.erase(put);
+  eraseKeepingDeps(builder, put);
+  chanIndex.insert(newPut);
+
+  builder.setInsertionPointAfter(newPar);
+  for (auto [res, newRes] :
+       llvm::zip_equal(par->getResults(), newPar->getResults())) {
+    if (res.use_empty())
+      continue;
+    auto join = builder.create<air::WaitAllOp>(
+        par->getLoc(), air::AsyncTokenType::get(par->getContext()),
+        SmallVector<Value>{res, newRes});
+    res.replaceAllUsesExcept(join.getAsyncToken(), join);
+  }
+  return newPut;
+}
+
+// Find channels whose only put is issued by every iteration of an scf.parallel
+// along a bundle dimension, but reads the same footprint in all of them: the
+// parallel induction variable for that dimension is used by nothing but the
+// put's channel index. Such a channel carries identical data to every
+// destination along that dimension, so it is turned into a broadcast channel
+// with a single put per destination group. The parallel is trimmed to one
+// iteration along that dimension, so any other op with side effects in it is
+// first left behind in a copy of the parallel without the put. Returns the
+// number of channels converted.
+static unsigned discoverChannelBroadcasts(ModuleOp module,
+                                          air::ChannelSymbolIndex &chanIndex) {
+  SmallVector<air::ChannelOp> channels;
+  module.walk([&](air::ChannelOp chan) {
+    if (!chan->hasAttr("broadcast_shape") && chan.getBundleSize() > 1)
+      channels.push_back(chan);
+  });
+
+  unsigned numBroadcasts = 0;
+  for (auto chan : channels) {
+    auto puts = chanIndex.getChannelPutOps(chan);
+    if (puts.size() != 1)
+      continue;
+    auto put = puts.front();
+    auto par = put->getParentOfType<scf::ParallelOp>();
+    if (!par)
+      continue;
+    auto sizes = extractFromIntegerArrayAttr<int64_t>(chan.getSize());
+    if (put.getIndices().size() != sizes.size())
+      continue;
+
+    // Pick the bundle dimension with the largest fan-out whose index is a
+    // parallel induction variable used only by the put's channel index. Uses
+    // by ops left behind when hoisting the put, or only feeding those, don't
+    // count.
+    auto others = getOtherImpureOps(par, put);
+    std::function<bool(Operation *)> isLeftBehind = [&](Operation *o) {
+      if (llvm::any_of(others, [&](Operation *other) {
+            return other->isAncestor(o);
+          }))
+        return true;
+      return air::isPure(o) && !o->getUsers().empty() &&
+             llvm::all_of(o->getUsers(), isLeftBehind);
+    };
+    std::optional<unsigned> bcastDim, parDim;
+    for (auto [dim, index] : llvm::enumerate(put.getIndices())) {
+      auto ivs = par.getInductionVars();
+      auto it = llvm::find(ivs, index);
+      if (it == ivs.end() || sizes[dim] <= 1)
+        continue;
+      OpOperand &indexOperand = put.getIndicesMutable()[dim];
+      if (!llvm::all_of(index.getUses(), [&](OpOperand &use) {
+            return &use == &indexOperand ||
+                   isOpTriviallyDead(use.getOwner()) ||
+                   isLeftBehind(use.getOwner());
+          }))
+        continue;
+      unsigned d = it - ivs.begin();
+      if (getConstantIntValue(par.getLowerBound()[d]) != 0 ||
+          getConstantIntValue(par.getStep()[d]) != 1 ||
+          getConstantIntValue(par.getUpperBound()[d]) != sizes[dim])
+        continue;
+      if (!bcastDim || sizes[dim] > sizes[*bcastDim]) {
+        bcastDim = dim;
+        parDim = d;
+      }
+    }
+    if (!bcastDim)
+      continue;
+
+    if (!others.empty()) {
+      put = hoistPutIntoOwnParallel(par, put, others, chanIndex);
+      if (!put)
+        continue;
+      par = put->getParentOfType<scf::ParallelOp>();
+    }
+
+    OpBuilder builder(par);
+    auto c1 = builder.create<arith::ConstantIndexOp>(par->getLoc(), 1);
+    put.getIndicesMutable()[*bcastDim].set(par.getLowerBound()[*parDim]);
+    par.getUpperBoundMutable()[*parDim].set(c1);
+    chan->setAttr("broadcast_shape", chan.getSize());
+    SmallVector<int64_t> newSizes(sizes);
+    newSizes[*bcastDim] = 1;
+    chan.setSizeAttr(builder.getI64ArrayAttr(newSizes));
+    numBroadcasts++;
+  }
+  return numBroadcasts;
+}
+
 struct DmaToChannelPass : public air::impl::DmaToChannelBase<DmaToChannelPass> {
 
   DmaToChannelPass() = default;
   DmaToChannelPass(const DmaToChannelPass &pass) {}
+  DmaToChannelPass(const ::xilinx::air::DmaToChannelOptions &options)
+      : DmaToChannelBase(options) {}
 
   void getDependentDialects(::mlir::DialectRegistry &registry) const override {
     registry.insert<air::airDialect>();
@@ -1502,6 +1667,11 @@ struct DmaToChannelPass : public air::impl::DmaToChannelBase<DmaToChannelPass> {
         op->removeAttr("hoist");
       });
     }
+
+    // Channels are only created above, so the index is built here
+    if (clDiscoverBroadcast)
+      numBroadcastChannels += discoverChannelBroadcasts(
+          module, getAnalysis<air::ChannelSymbolIndex>());
   }
 
   void updateDependencyOnFunction(func::FuncOp f) {
@@ -1595,5 +1765,10 @@ std::unique_ptr<mlir::Pass> createDmaToChannelPass() {
   return std::make_unique<DmaToChannelPass>();
 }
 
+std::unique_ptr<mlir::Pass>
+createDmaToChannelPass(DmaToChannelOptions options) {
+  return std::make_unique<DmaToChannelPass>(options);
+}
+
 } // namespace air
 } // namespace xilinx
@@ -1446,6 +1446,23 @@ AIRSplitL2MemrefForBufferConstraintPass::getTargetMemrefAllocs(
     int tilingFactor =
         std::max(getChanCount(MM2SChannels), getChanCount(S2MMChannels));
 
+    // Demand-driven mode: a memref whose concurrent streams fit within one
+    // memtile's DMA channels, and whose data fits within the memtile, gains
+    // nothing from being split.
+    std::string streamDir = getChanCount(MM2SChannels) > 1 ? "MM2S" : "S2MM";
+    int64_t memrefBytes = air::getTensorVolume(memref.getType()) *
+                          air::getElementSizeInBytes(memref.getType());
+    if (clMemtileDmaChannels && tilingFactor <= (int)clMemtileDmaChannels &&
+        memrefBytes <= (int64_t)clMemtileSize) {
+      if (clReportPartitioning)
+        allocOp->emitRemark()
+            << "kept whole: " << tilingFactor << " " << streamDir
+            << " streams fit within " << clMemtileDmaChannels
+            << " memtile channels, " << memrefBytes << " bytes fit within "
+            << clMemtileSize << " memtile bytes";
+      continue;
+    }
+
     llvm::MapVector<int, SmallVector<infoEntryTy>> infoEntryMap;
     std::optional<int> splitDimOffset = std::nullopt;
     std::optional<int> splitDimSize = std::nullopt;
@@ -1471,6 +1488,18 @@ AIRSplitL2MemrefForBufferConstraintPass::getTargetMemrefAllocs(
           "memref splitting analysis failed to get the split dimension.");
       return failure();
     }
+    int64_t subBufferBytes = llvm::divideCeilSigned(memrefBytes, tilingFactor);
+    if (clReportPartitioning)
+      allocOp->emitRemark()
+          << "split into " << tilingFactor
+          << " sub-buffers along dimension " << *splitDim << " for "
+          << tilingFactor << " " << streamDir << " streams, "
+          << subBufferBytes << " bytes each";
+    if (clMemtileDmaChannels && subBufferBytes > (int64_t)clMemtileSize)
+      allocOp->emitWarning()
+          << "sub-buffers of " << subBufferBytes
+          << " bytes still exceed the memtile capacity of " << clMemtileSize
+          << " bytes";
 
     // Methods to get root offset/size/stride from air.channel's operands, where
     // root is either a constant, or a loop's induction variable.
@@ -1590,12 +1619,49 @@ void AIRSplitL2MemrefForBufferConstraintPass::runOnOperation() {
       tileCount += count;
     return tileCount;
   };
-  if (llvm::none_of(allocOps, [&](memref::AllocOp a) {
-        if (auto s = a->getParentOfType<air::SegmentOp>()) {
-          return getTileCountInSegment(s) > clNumTilesPerL2Tile;
-        } else
-          return false;
-      }))
+  // In demand-driven mode, check instead whether any L2 memref may need more
+  // streams than a memtile has DMA channels, counting every instance of an
+  // scf.parallel as a stream (an upper bound until the loops are unrolled),
+  // or may not fit within a memtile.
+  auto mayExceedMemtile = [&](memref::AllocOp a) {
+    Value memref = a.getMemref();
+    if (auto exec = dyn_cast<air::ExecuteOp>(a->getParentOp()))
+      memref = exec->getResult(1);
+    int64_t bytes = air::getTensorVolume(memref.getType()) *
+                    air::getElementSizeInBytes(memref.getType());
+    if (bytes > (int64_t)clMemtileSize)
+      return true;
+    int64_t numPuts = 0, numGets = 0;
+    for (auto user : memref.getUsers()) {
+      if (!isa<air::ChannelInterface>(user))
+        continue;
+      int64_t instances = 1;
+      for (auto par = user->getParentOfType<scf::ParallelOp>(); par;
+           par = par->getParentOfType<scf::ParallelOp>())
+        for (auto [lb, ub, step] : llvm::zip_equal(
+                 par.getLowerBound(), par.getUpperBound(), par.getStep())) {
+          auto lbInt = getConstantIntValue(lb);
+          auto ubInt = getConstantIntValue(ub);
+          auto stepInt = getConstantIntValue(step);
+          if (lbInt && ubInt && stepInt && *stepInt > 0)
+            instances *= llvm::divideCeilSigned(*ubInt - *lbInt, *stepInt);
+        }
+      if (isa<air::ChannelPutOp>(user))
+        numPuts += instances;
+      else
+        numGets += instances;
+    }
+    return std::max(numPuts, numGets) > (int64_t)clMemtileDmaChannels;
+  };
+  if (clMemtileDmaChannels) {
+    if (llvm::none_of(allocOps, mayExceedMemtile))
+      return;
+  } else if (llvm::none_of(allocOps, [&](memref::AllocOp a) {
+               if (auto s = a->getParentOfType<air::SegmentOp>()) {
+                 return getTileCountInSegment(s) > clNumTilesPerL2Tile;
+               } else
+                 return false;
+             }))
     return;
 
   // STEP 1: Unroll scf.parallels in segment
@@ -0,0 +1,237 @@
+//===- ChannelSymbolIndex.cpp -----------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+#include "air/Util/ChannelSymbolIndex.h"
+#include "air/Util/Util.h"
+
+#include "mlir/IR/Iterators.h"
+#include "mlir/IR/RegionGraphTraits.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+
+#include <algorithm>
+
+using namespace mlir;
+using namespace xilinx;
+using namespace xilinx::air;
+
+// Channel name of a put or get, or a null attribute for any other op
+static StringAttr getChannelName(Operation *op) {
+  if (auto put = dyn_cast<ChannelPutOp>(op))
+    return put.getChanNameAttr().getAttr();
+  if (auto get = dyn_cast<ChannelGetOp>(op))
+    return get.getChanNameAttr().getAttr();
+  return StringAttr();
+}
+
+// Whether `a` comes before `b` in a pre-order walk of the IR with
+// ForwardDominanceIterator, which visits the blocks of a region depth-first
+// from the entry block. Blocks unreachable from the entry block, which that
+// walk skips, come last in the order they appear in the region.
+static bool isBeforeInProgramOrder(Operation *a, Operation *b) {
+  if (a->getBlock() == b->getBlock())
+    return a->isBeforeInBlock(b);
+
+  // Find the distinct ancestors of `a` and `b` below their common ancestor
+  SmallVector<Operation *> aChain, bChain;
+  for (Operation *o = a; o; o = o->getParentOp())
+    aChain.push_back(o);
+  for (Operation *o = b; o; o = o->getParentOp())
+    bChain.push_back(o);
+  auto aIt = aChain.rbegin(), bIt = bChain.rbegin();
+  while (aIt != aChain.rend() && bIt != bChain.rend() && *aIt == *bIt) {
+    ++aIt;
+    ++bIt;
+  }
+  if (aIt == aChain.rend())
+    return true;
+  if (bIt == bChain.rend())
+    return false;
+
+  Operation *x = *aIt, *y = *bIt;
+  if (x->getBlock() == y->getBlock())
+    return x->isBeforeInBlock(y);
+  Region *xRegion = x->getParentRegion(), *yRegion = y->getParentRegion();
+  if (xRegion != yRegion)
+    return xRegion->getRegionNumber() < yRegion->getRegionNumber();
+  for (Block *block : llvm::depth_first(&xRegion->front())) {
+    if (block == x->getBlock())
+      return true;
+    if (block == y->getBlock())
+      return false;
+  }
+  for (Block &block : *xRegion) {
+    if (&block == x->getBlock())
+      return true;
+    if (&block == y->getBlock())
+      return false;
+  }
+  return false;
+}
+
+ChannelSymbolIndex::ChannelSymbolIndex(Operation *root) : root(root) {
+  rebuild();
+}
+
+void ChannelSymbolIndex::rebuild() {
+  users.clear();
+  names.clear();
+  // Same order as getChannelPutOpThroughSymbol and isBeforeInProgramOrder
+  root->walk<WalkOrder::PreOrder, ForwardDominanceIterator<>>(
+      [&](Operation *op) {
+        if (auto name = getChannelName(op))
+          add(op, name);
+      });
+  for (auto &it : users)
+    it.second.sorted = true;
+}
+
+void ChannelSymbolIndex::add(Operation *op, StringAttr name) {
+  ChannelUsers &u = users[name];
+  if (isa<ChannelPutOp>(op))
+    u.puts.push_back(op);
+  else
+    u.gets.push_back(op);
+  u.sorted = false;
+  names[op] = name;
+}
+
+void ChannelSymbolIndex::remove(Operation *op) {
+  auto it = names.find(op);
+  if (it == names.end())
+    return;
+  if (ChannelUsers *u = lookup(it->second)) {
+    auto &vec = isa<ChannelPutOp>(op) ? u->puts : u->gets;
+    vec.erase(std::remove(vec.begin(), vec.end(), op), vec.end());
+  }
+  names.erase(it);
+}
+
+ChannelSymbolIndex::ChannelUsers *ChannelSymbolIndex::lookup(StringAttr name) {
+  auto it = users.find(name);
+  return it == users.end() ? nullptr : &it->second;
+}
+
+void ChannelSymbolIndex::insert(Operation *op) {
+  op->walk([&](Operation *o) {
+    auto name = getChannelName(o);
+    if (!name)
+      return;
+    auto it = names.find(o);
+    if (it == names.end())
+      add(o, name);
+    else if (ChannelUsers *u = lookup(it->second))
+      u->sorted = false;
+  });
+}
+
+void ChannelSymbolIndex::erase(Operation *op) {
+  op->walk([&](Operation *o) { remove(o); });
+}
+
+void ChannelSymbolIndex::update(Operation *op) {
+  auto name = getChannelName(op);
+  auto it = names.find(op);
+  if (!name || it == names.end() || it->second == name)
+    return;
+  remove(op);
+  add(op, name);
+}
+
+void ChannelSymbolIndex::replaceSymbol(StringAttr oldName,
+                                       StringAttr newName) {
+  if (oldName == newName)
+    return;
+  auto it = users.find(oldName);
+  if (it == users.end())
+    return;
+  ChannelUsers moved = std::move(it->second);
+  users.erase(it);
+  ChannelUsers &u = users[newName];
+  u.puts.append(moved.puts.begin(), moved.puts.end());
+  u.gets.append(moved.gets.begin(), moved.gets.end());
+  u.sorted = false;
+  for (Operation *op : llvm::concat<Operation *>(moved.puts, moved.gets))
+    names[op] = newName;
+}
+
+std::vector<Operation *> ChannelSymbolIndex::getUsers(StringAttr name,
+                                                      Operation *scope,
+                                                      bool puts) {
+  ChannelUsers *u = lookup(name);
+  if (!u)
+    return {};
+  if (!u->sorted) {
+    llvm::stable_sort(u->puts, isBeforeInProgramOrder);
+    llvm::stable_sort(u->gets, isBeforeInProgramOrder);
+    u->sorted = true;
+  }
+  std::vector<Operation *> result;
+  for (Operation *op : puts ? u->puts : u->gets)
+    if (scope == root || scope->isAncestor(op))
+      result.push_back(op);
+  return result;
+}
+
+std::vector<ChannelPutOp>
+ChannelSymbolIndex::getChannelPutOps(ChannelOp channel, Operation *scope) {
+  if (!scope)
+    scope = channel->getParentOfType<ModuleOp>();
+  std::vector<ChannelPutOp> channelPuts;
+  for (Operation *op : getUsers(channel.getSymNameAttr(), scope, true))
+    channelPuts.push_back(cast<ChannelPutOp>(op));
+  return channelPuts;
+}
+
+std::vector<ChannelGetOp>
+ChannelSymbolIndex::getChannelGetOps(ChannelOp channel, Operation *scope) {
+  if (!scope)
+    scope = channel->getParentOfType<ModuleOp>();
+  std::vector<ChannelGetOp> channelGets;
+  for (Operation *op : getUsers(channel.getSymNameAttr(), scope, false))
+    channelGets.push_back(cast<ChannelGetOp>(op));
+  return channelGets;
+}
+
+std::vector<ChannelGetOp>
+ChannelSymbolIndex::getTheOtherChannelOps(ChannelPutOp put) {
+  auto channel_op = getChannelDeclarationThroughSymbol(
+      dyn_cast<ChannelInterface>(put.getOperation()));
+  return getChannelGetOps(channel_op);
+}
+
+std::vector<ChannelPutOp>
+ChannelSymbolIndex::getTheOtherChannelOps(ChannelGetOp get) {
+  auto channel_op = getChannelDeclarationThroughSymbol(
+      dyn_cast<ChannelInterface>(get.getOperation()));
+  return getChannelPutOps(channel_op);
+}
+
+std::vector<ChannelInterface>
+ChannelSymbolIndex::getTheOtherChannelOps(ChannelInterface op) {
+  std::vector<ChannelInterface> output;
+  if (auto put = dyn_cast<ChannelPutOp>(op.getOperation())) {
+    for (auto get : getTheOtherChannelOps(put))
+      output.push_back(get);
+  } else if (auto get = dyn_cast<ChannelGetOp>(op.getOperation())) {
+    for (auto put : getTheOtherChannelOps(get))
+      output.push_back(put);
+  }
+  return output;
+}
+
+void ChannelSymbolIndex::Listener::notifyOperationInserted(
+    Operation *op, OpBuilder::InsertPoint previous) {
+  index.insert(op);
+}
+
+void ChannelSymbolIndex::Listener::notifyOperationModified(Operation *op) {
+  index.update(op);
+}
+
+void ChannelSymbolIndex::Listener::notifyOperationErased(Operation *op) {
+  index.erase(op);
+}
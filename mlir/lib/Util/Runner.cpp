@@ -8,6 +8,7 @@
 
 #include "air/Util/Runner.h"
 #include "air/Dialect/AIR/AIRDialect.h"
+#include "air/Util/ChannelSymbolIndex.h"
 #include "air/Util/CostModel.h"
 #include "air/Util/Util.h"
 
@@ -197,7 +198,7 @@ public:
                "air::ChannelGetOp";
       MemRefType dstTy = llvm::cast<MemRefType>(getOp.getDst().getType());
       std::vector<air::ChannelPutOp> putOps =
-          air::getTheOtherChannelOpThroughSymbol(getOp);
+          channelIndex->getTheOtherChannelOps(getOp);
       if (!putOps.size())
         getOp->emitOpError("found no put op for air::ChannelGetOp");
       MemRefType srcTy = llvm::cast<MemRefType>(putOps[0].getSrc().getType());
@@ -370,6 +371,12 @@ public:
     canonicalizer.parseCommandGraphs(toplevel, hostGraph, dep_ctx,
                                      sim_granularity);
 
+    // Channel gets look up their puts each time they are modelled
+    Operation *root = toplevel;
+    while (root->getParentOp())
+      root = root->getParentOp();
+    channelIndex = std::make_unique<air::ChannelSymbolIndex>(root);
+
     // Walk the launch graph and write process name metadata in trace
     writeTraceMetadataProcNames(hostGraph);
 
@@ -492,6 +499,9 @@ private:
   // Dependency graph constructed
   dependencyGraph hostGraph;
 
+  // Puts and gets of the channels in the IR being scheduled
+  std::unique_ptr<air::ChannelSymbolIndex> channelIndex;
+
   // Host and segment runnerNodes
   runnerNode launch_runner_node;
 
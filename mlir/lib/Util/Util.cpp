@@ -15,6 +15,7 @@
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/IntegerSet.h"
 #include "mlir/IR/Iterators.h"
@@ -200,6 +201,29 @@ uint64_t air::getElementSizeInBytes(const mlir::Type ty) {
     return 0;
 }
 
+int64_t air::getMemcpyVolumeInBytes(air::MemcpyInterface memcpyOp,
+                                    bool isSrc) {
+  Value memref = isSrc ? memcpyOp.getSrcMemref() : memcpyOp.getDstMemref();
+  auto sizes = isSrc ? memcpyOp.getSrcSizes() : memcpyOp.getDstSizes();
+  auto memrefTy = llvm::cast<BaseMemRefType>(memref.getType());
+  int64_t volume = 1;
+  if (sizes.empty())
+    volume = getTensorVolume(memrefTy);
+  for (auto s : sizes)
+    volume *= getConstantIntValue(s).value_or(1);
+  volume *= getElementSizeInBytes(memrefTy);
+
+  for (auto parent = memcpyOp->getParentOfType<scf::ForOp>(); parent;
+       parent = parent->getParentOfType<scf::ForOp>()) {
+    auto lb = getConstantIntValue(parent.getLowerBound());
+    auto ub = getConstantIntValue(parent.getUpperBound());
+    auto step = getConstantIntValue(parent.getStep());
+    if (lb && ub && step && *step > 0)
+      volume *= std::max((int64_t)1, llvm::divideCeilSigned(*ub - *lb, *step));
+  }
+  return volume;
+}
+
 // Get the parent scf.for op of an iter_arg
 scf::ForOp air::getForRegionIterArgsOwner(Value val) {
   auto ivArg = llvm::dyn_cast<BlockArgument>(val);
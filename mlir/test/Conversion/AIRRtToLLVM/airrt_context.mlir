@@ -0,0 +1,67 @@
+//===- airrt_context.mlir --------------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -airrt-to-llvm="use-context" | FileCheck %s
+// RUN: air-opt %s -airrt-to-llvm | FileCheck %s --check-prefix=NOCTX
+
+// The runtime context is looked up once per function and passed to the
+// context taking variants of the runtime entry points.
+
+// CHECK-LABEL: func.func @launch
+// CHECK: %[[CTX:.*]] = call @__airrt_get_context() : () -> !llvm.ptr
+// CHECK: call @__airrt_ctx_segment_load(%[[CTX]], %{{.*}}) : (!llvm.ptr, !llvm.ptr) -> i64
+// CHECK: call @__airrt_ctx_herd_load(%[[CTX]], %{{.*}}) : (!llvm.ptr, !llvm.ptr) -> i64
+// CHECK: call @__airrt_ctx_dma_nd_memcpy_2d0i32(%[[CTX]],
+// CHECK: scf.for
+// CHECK:   func.call @__airrt_ctx_wait_all_1_1(%[[CTX]], %{{.*}}) : (!llvm.ptr, !llvm.ptr) -> !llvm.ptr
+// CHECK: call @__airrt_ctx_wait_all_0_1(%[[CTX]], %{{.*}}) : (!llvm.ptr, !llvm.ptr) -> ()
+// CHECK-NOT: call @__airrt_get_context
+
+// A function not calling into the runtime does not look the context up
+// CHECK-LABEL: func.func @no_runtime
+// CHECK-NOT: __airrt_get_context
+// CHECK: return
+
+// CHECK-NOT: func.func private @__airrt_herd_load(
+// CHECK-NOT: func.func private @__airrt_segment_load(
+// CHECK-DAG: func.func private @__airrt_get_context() -> !llvm.ptr attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @__airrt_ctx_herd_load(!llvm.ptr, !llvm.ptr) -> i64 attributes {llvm.emit_c_interface}
+
+// NOCTX-NOT: __airrt_get_context
+// NOCTX-NOT: __airrt_ctx_
+// NOCTX: call @__airrt_segment_load(
+// NOCTX: call @__airrt_herd_load(
+
+module {
+  airrt.module_metadata {
+    airrt.segment_metadata attributes {sym_name="plot"} {
+      airrt.herd_metadata { sym_name = "elk", dma_allocations = [] }
+    }
+  }
+  func.func @launch(%arg0: memref<256x256xi32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c4 = arith.constant 4 : index
+    %c0_i64 = arith.constant 0 : i64
+    %c1_i64 = arith.constant 1 : i64
+    %c16_i64 = arith.constant 16 : i64
+    %c256_i64 = arith.constant 256 : i64
+    %c1_i32 = arith.constant 1 : i32
+    %0 = airrt.segment_load "plot" : i64
+    %1 = airrt.herd_load "elk" () : () -> i64
+    %2 = airrt.dma_memcpy_nd(%c1_i32, %c0_i64, %c0_i64, %arg0[%c0_i64, %c0_i64, %c0_i64, %c0_i64], [%c1_i64, %c1_i64, %c16_i64, %c16_i64], [%c0_i64, %c0_i64, %c256_i64]) : (i32, i64, i64, memref<256x256xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %3 = scf.for %arg1 = %c0 to %c4 step %c1 iter_args(%arg2 = %2) -> (!airrt.event) {
+      %4 = airrt.wait_all %arg2 : !airrt.event
+      scf.yield %4 : !airrt.event
+    }
+    airrt.wait_all %3
+    return
+  }
+  func.func @no_runtime() {
+    return
+  }
+}
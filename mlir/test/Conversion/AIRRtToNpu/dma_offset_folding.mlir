@@ -7,6 +7,8 @@
 
 
 // RUN: air-opt -airrt-to-npu --split-input-file %s | FileCheck %s
+// RUN: air-opt -airrt-to-npu="compact-insts" %s | FileCheck %s --check-prefix=COMPACT
+// RUN: air-opt -airrt-to-npu="compact-insts" -mlir-pass-statistics %s -o /dev/null 2>&1 | FileCheck %s --check-prefix=STATS
 
 // 
 //Test correctness of generated offsets, wraps and strides
@@ -86,6 +88,25 @@
 // CHECK: aiex.npu.dma_memcpy_nd(0, 0, %arg2[0, 0, 384, 384][1, 1, 128, 128][0, 0, 512, 1]) {id = 2 : i64, metadata = @airMemcpyId19} : memref<512x512xf32>
 // CHECK: aiex.npu.sync {channel = 0 : i32, column = 0 : i32, column_num = 1 : i32, direction = 0 : i32, row = 0 : i32, row_num = 1 : i32}
 
+// Runs of BDs on one channel whose base addresses step by a constant fold into
+// the BD repeat dimension. BDs already using dimension 0 are left alone.
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg0[0, 0, 0, 0][4, 4, 128, 32][0, 32, 128, 1]) {{.*}}metadata = @airMemcpyId4}
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg1[0, 0, 0, 0][16, 8, 8, 16][4096, 64, 512, 1]) {{.*}}metadata = @airMemcpyId5}
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg2[0, 0, 0, 0][4, 1, 128, 128][128, 0, 512, 1]) {{.*}}metadata = @airMemcpyId19}
+// COMPACT: aiex.npu.sync
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg0[0, 0, 128, 0][4, 4, 128, 32][0, 32, 128, 1]) {{.*}}metadata = @airMemcpyId4}
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg2[0, 0, 128, 0][4, 1, 128, 128][128, 0, 512, 1]) {{.*}}metadata = @airMemcpyId19}
+// COMPACT: aiex.npu.sync
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg0[0, 0, 256, 0][4, 4, 128, 32][0, 32, 128, 1]) {{.*}}metadata = @airMemcpyId4}
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg2[0, 0, 256, 0][4, 1, 128, 128][128, 0, 512, 1]) {{.*}}metadata = @airMemcpyId19}
+// COMPACT: aiex.npu.sync
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg0[0, 0, 384, 0][4, 4, 128, 32][0, 32, 128, 1]) {{.*}}metadata = @airMemcpyId4}
+// COMPACT: aiex.npu.dma_memcpy_nd(0, 0, %arg2[0, 0, 384, 0][4, 1, 128, 128][128, 0, 512, 1]) {{.*}}metadata = @airMemcpyId19}
+// COMPACT: aiex.npu.sync
+
+// STATS-DAG: 48 num-dma-ops-before-compaction
+// STATS-DAG: 24 num-dma-ops-after-compaction
+
 module {
   aie.device(npu1_4col) {
     aie.shim_dma_allocation @airMemcpyId19(S2MM, 0, 0)
@@ -0,0 +1,79 @@
+//===- minimal_sync.mlir ---------------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt -airrt-to-npu="minimal-sync" %s | FileCheck %s
+
+// The two S2MM transfers into %arg1 are awaited only before %arg1 is read
+// back, and the last S2MM transfer only at the end of the sequence.
+
+// CHECK-LABEL: func.func @func0
+// CHECK: aiex.npu.dma_memcpy_nd(0, 0, %arg0{{.*}}metadata = @airMemcpyIdIn}
+// CHECK-NEXT: aiex.npu.dma_memcpy_nd(0, 0, %arg1[0, 0, 0, 0]{{.*}}metadata = @airMemcpyIdOut}
+// CHECK-NEXT: aiex.npu.dma_memcpy_nd(0, 0, %arg0{{.*}}metadata = @airMemcpyIdIn}
+// CHECK-NEXT: aiex.npu.dma_memcpy_nd(0, 0, %arg1[0, 0, 0, 32]{{.*}}metadata = @airMemcpyIdOut}
+// CHECK-NEXT: aiex.npu.sync {channel = 0 : i32, column = 0 : i32, column_num = 1 : i32, direction = 0 : i32, row = 0 : i32, row_num = 1 : i32}
+// CHECK-NEXT: aiex.npu.sync {channel = 0 : i32, column = 0 : i32, column_num = 1 : i32, direction = 0 : i32, row = 0 : i32, row_num = 1 : i32}
+// CHECK-NEXT: aiex.npu.dma_memcpy_nd(0, 0, %arg1{{.*}}metadata = @airMemcpyIdIn}
+// CHECK-NEXT: aiex.npu.dma_memcpy_nd(0, 0, %arg2{{.*}}metadata = @airMemcpyIdOut}
+// CHECK-NEXT: aiex.npu.sync {channel = 0 : i32, column = 0 : i32, column_num = 1 : i32, direction = 0 : i32, row = 0 : i32, row_num = 1 : i32}
+// CHECK-NEXT: return
+
+// The S2MM transfer into %arg0 waits for the MM2S transfer still reading it
+// (write-after-read), which is made to issue a completion token. The second
+// S2MM transfer into %arg0 is on another channel and waits for the first
+// (write-after-write).
+
+// CHECK-LABEL: func.func @func1
+// CHECK: aiex.npu.dma_memcpy_nd(0, 0, %arg0{{.*}}issue_token = true{{.*}}metadata = @airMemcpyIdIn}
+// CHECK-NEXT: aiex.npu.sync {channel = 0 : i32, column = 0 : i32, column_num = 1 : i32, direction = 1 : i32, row = 0 : i32, row_num = 1 : i32}
+// CHECK-NEXT: aiex.npu.dma_memcpy_nd(0, 0, %arg0{{.*}}metadata = @airMemcpyIdOut}
+// CHECK-NEXT: aiex.npu.sync {channel = 0 : i32, column = 0 : i32, column_num = 1 : i32, direction = 0 : i32, row = 0 : i32, row_num = 1 : i32}
+// CHECK-NEXT: aiex.npu.dma_memcpy_nd(0, 0, %arg0{{.*}}metadata = @airMemcpyIdOut2}
+// CHECK-NEXT: aiex.npu.sync {channel = 1 : i32, column = 0 : i32, column_num = 1 : i32, direction = 0 : i32, row = 0 : i32, row_num = 1 : i32}
+// CHECK-NEXT: return
+
+module {
+  aie.device(npu1_1col) {
+    aie.shim_dma_allocation @airMemcpyIdOut(S2MM, 0, 0)
+    memref.global "public" @airMemcpyIdOut : memref<32xi32, 1>
+    aie.shim_dma_allocation @airMemcpyIdIn(MM2S, 0, 0)
+    memref.global "public" @airMemcpyIdIn : memref<32xi32, 1>
+    aie.shim_dma_allocation @airMemcpyIdOut2(S2MM, 1, 0)
+    memref.global "public" @airMemcpyIdOut2 : memref<32xi32, 1>
+  } {sym_name = "segment0"}
+  airrt.module_metadata{
+  }
+  func.func @func0(%arg0: memref<64xi32>, %arg1: memref<64xi32>, %arg2: memref<64xi32>) {
+    %c0_i64 = arith.constant 0 : i64
+    %c1_i64 = arith.constant 1 : i64
+    %c32_i64 = arith.constant 32 : i64
+    %c1_i32 = arith.constant 1 : i32
+    %c2_i32 = arith.constant 2 : i32
+    %p = airrt.segment_load "segment0" : i64
+    %0 = airrt.dma_memcpy_nd(%c1_i32, %c0_i64, %c0_i64, %arg0[%c0_i64, %c0_i64, %c0_i64, %c0_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdIn} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %1 = airrt.dma_memcpy_nd(%c2_i32, %c0_i64, %c0_i64, %arg1[%c0_i64, %c0_i64, %c0_i64, %c0_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdOut} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %2 = airrt.dma_memcpy_nd(%c1_i32, %c0_i64, %c0_i64, %arg0[%c0_i64, %c0_i64, %c0_i64, %c32_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdIn} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %3 = airrt.dma_memcpy_nd(%c2_i32, %c0_i64, %c0_i64, %arg1[%c0_i64, %c0_i64, %c0_i64, %c32_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdOut} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %4 = airrt.dma_memcpy_nd(%c1_i32, %c0_i64, %c0_i64, %arg1[%c0_i64, %c0_i64, %c0_i64, %c0_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdIn} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %5 = airrt.dma_memcpy_nd(%c2_i32, %c0_i64, %c0_i64, %arg2[%c0_i64, %c0_i64, %c0_i64, %c0_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdOut} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    return
+  }
+
+  func.func @func1(%arg0: memref<64xi32>) {
+    %c0_i64 = arith.constant 0 : i64
+    %c1_i64 = arith.constant 1 : i64
+    %c32_i64 = arith.constant 32 : i64
+    %c1_i32 = arith.constant 1 : i32
+    %c2_i32 = arith.constant 2 : i32
+    %c3_i32 = arith.constant 3 : i32
+    %p = airrt.segment_load "segment0" : i64
+    %0 = airrt.dma_memcpy_nd(%c1_i32, %c0_i64, %c0_i64, %arg0[%c0_i64, %c0_i64, %c0_i64, %c0_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdIn} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %1 = airrt.dma_memcpy_nd(%c2_i32, %c0_i64, %c0_i64, %arg0[%c0_i64, %c0_i64, %c0_i64, %c0_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdOut} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    %2 = airrt.dma_memcpy_nd(%c3_i32, %c0_i64, %c0_i64, %arg0[%c0_i64, %c0_i64, %c0_i64, %c32_i64], [%c1_i64, %c1_i64, %c1_i64, %c32_i64], [%c0_i64, %c0_i64, %c0_i64]) {metadata = @airMemcpyIdOut2} : (i32, i64, i64, memref<64xi32>, [i64, i64, i64, i64], [i64, i64, i64, i64], [i64, i64, i64]) : !airrt.event
+    return
+  }
+}
@@ -0,0 +1,53 @@
+//===- auto_packet_flow.mlir -----------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=0 device=npu1_1col" | FileCheck %s
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=0 device=npu1_1col auto-pkt-flow-max-bytes=256" | FileCheck %s --check-prefix=PKT
+
+// The 64-byte bias transfers are routed as packet flows, while the 16 KiB data
+// transfers keep their circuit-switched flows.
+
+// CHECK-NOT: aie.packet_flow
+
+// PKT-DAG: aie.packet_flow(0) {
+// PKT-DAG: aie.packet_flow(1) {
+// PKT-DAG: aie.flow(%{{.*}}, DMA : {{[0-9]}}, %{{.*}}, DMA : {{[0-9]}})
+// PKT-DAG: aie.flow(%{{.*}}, DMA : {{[0-9]}}, %{{.*}}, DMA : {{[0-9]}})
+// PKT-LABEL: @func0
+// PKT: air.channel.put @channel_0[]
+// PKT-NOT: packet
+// PKT: air.channel.put @channel_1[] {{.*}}packet = #aie.packet_info<pkt_type = 0, pkt_id = {{[0-9]+}}>
+
+air.channel @channel_0 [1, 1]
+air.channel @channel_1 [1, 1]
+air.channel @channel_2 [1, 1]
+air.channel @channel_3 [1, 1]
+func.func @func0(%arg0 : memref<4096xi32>, %arg1 : memref<16xi32>) -> () {
+  air.channel.put @channel_0[] (%arg0[] [] []) {id = 1 : i32} : (memref<4096xi32>)
+  air.channel.put @channel_1[] (%arg1[] [] []) {id = 2 : i32} : (memref<16xi32>)
+  air.segment @segment0 {
+    %herd_cols = arith.constant 1 : index
+    %herd_rows = arith.constant 1 : index
+    %data = memref.alloc() : memref<4096xi32, 1>
+    %bias = memref.alloc() : memref<16xi32, 1>
+    air.channel.get @channel_0[] (%data[] [] []) {id = 3 : i32} : (memref<4096xi32, 1>)
+    air.channel.get @channel_1[] (%bias[] [] []) {id = 4 : i32} : (memref<16xi32, 1>)
+    air.channel.put @channel_2[] (%data[] [] []) {id = 5 : i32} : (memref<4096xi32, 1>)
+    air.channel.put @channel_3[] (%bias[] [] []) {id = 6 : i32} : (memref<16xi32, 1>)
+    memref.dealloc %data : memref<4096xi32, 1>
+    memref.dealloc %bias : memref<16xi32, 1>
+    air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) attributes { sym_name="herd0"} {
+      %buf0 = memref.alloc() : memref<4096xi32, 2>
+      %buf1 = memref.alloc() : memref<16xi32, 2>
+      air.channel.get @channel_2[%tx, %ty] (%buf0[] [] []) {id = 7 : i32} : (memref<4096xi32, 2>)
+      air.channel.get @channel_3[%tx, %ty] (%buf1[] [] []) {id = 8 : i32} : (memref<16xi32, 2>)
+      memref.dealloc %buf0 : memref<4096xi32, 2>
+      memref.dealloc %buf1 : memref<16xi32, 2>
+    }
+  }
+  return
+}
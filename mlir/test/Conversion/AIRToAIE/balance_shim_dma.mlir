@@ -0,0 +1,62 @@
+//===- balance_shim_dma.mlir -----------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=0 device=npu1_4col" | FileCheck %s
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=0 device=npu1_4col balance-shim-dma" 2>&1 | FileCheck %s --check-prefix=BALANCE
+
+// By default, all three L3 transfers are packed onto the shim DMA channels of
+// column 0. With balance-shim-dma, they are placed largest first, each onto
+// the shim column carrying the least traffic so far.
+
+// CHECK-DAG: aie.shim_dma_allocation @{{.*}}(MM2S, 0, 0)
+// CHECK-DAG: aie.shim_dma_allocation @{{.*}}(MM2S, 1, 0)
+// CHECK-DAG: aie.shim_dma_allocation @{{.*}}(S2MM, 0, 0)
+
+// BALANCE: remark: shim DMA traffic per column (bytes): 0:16384 1:4096 2:1024 3:0; peak/mean 3.05
+// BALANCE-DAG: aie.shim_dma_allocation @{{.*}}(MM2S, 0, 0)
+// BALANCE-DAG: aie.shim_dma_allocation @{{.*}}(MM2S, 0, 1)
+// BALANCE-DAG: aie.shim_dma_allocation @{{.*}}(S2MM, 0, 2)
+
+air.channel @channel_0 [1, 1]
+air.channel @channel_1 [1, 1]
+air.channel @channel_2 [1, 1]
+air.channel @channel_3 [1, 1]
+air.channel @channel_4 [1, 1]
+air.channel @channel_5 [1, 1]
+func.func @func0(%arg0 : memref<1024xi32>, %arg1 : memref<4096xi32>, %arg2 : memref<256xi32>) -> () {
+  air.channel.put @channel_0[] (%arg1[] [] []) {id = 1 : i32} : (memref<4096xi32>)
+  air.channel.put @channel_1[] (%arg0[] [] []) {id = 2 : i32} : (memref<1024xi32>)
+  air.segment @segment0 {
+    %herd_cols = arith.constant 1 : index
+    %herd_rows = arith.constant 1 : index
+    %memtile0 = memref.alloc() : memref<4096xi32, 1>
+    %memtile1 = memref.alloc() : memref<1024xi32, 1>
+    %memtile2 = memref.alloc() : memref<256xi32, 1>
+    air.channel.get @channel_0[] (%memtile0[] [] []) {id = 3 : i32} : (memref<4096xi32, 1>)
+    air.channel.get @channel_1[] (%memtile1[] [] []) {id = 4 : i32} : (memref<1024xi32, 1>)
+    air.channel.put @channel_2[] (%memtile0[] [] []) {id = 5 : i32} : (memref<4096xi32, 1>)
+    air.channel.put @channel_3[] (%memtile1[] [] []) {id = 6 : i32} : (memref<1024xi32, 1>)
+    air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) attributes { sym_name="herd0"} {
+      %buf0 = memref.alloc() : memref<4096xi32, 2>
+      %buf1 = memref.alloc() : memref<1024xi32, 2>
+      %buf2 = memref.alloc() : memref<256xi32, 2>
+      air.channel.get @channel_2[%tx, %ty] (%buf0[] [] []) {id = 7 : i32} : (memref<4096xi32, 2>)
+      air.channel.get @channel_3[%tx, %ty] (%buf1[] [] []) {id = 8 : i32} : (memref<1024xi32, 2>)
+      air.channel.put @channel_4[%tx, %ty] (%buf2[] [] []) {id = 9 : i32} : (memref<256xi32, 2>)
+      memref.dealloc %buf0 : memref<4096xi32, 2>
+      memref.dealloc %buf1 : memref<1024xi32, 2>
+      memref.dealloc %buf2 : memref<256xi32, 2>
+    }
+    air.channel.get @channel_4[] (%memtile2[] [] []) {id = 10 : i32} : (memref<256xi32, 1>)
+    air.channel.put @channel_5[] (%memtile2[] [] []) {id = 11 : i32} : (memref<256xi32, 1>)
+    memref.dealloc %memtile0 : memref<4096xi32, 1>
+    memref.dealloc %memtile1 : memref<1024xi32, 1>
+    memref.dealloc %memtile2 : memref<256xi32, 1>
+  }
+  air.channel.get @channel_5[] (%arg2[] [] []) {id = 12 : i32} : (memref<256xi32>)
+  return
+}
@@ -0,0 +1,43 @@
+//===- l1_bank_aware.mlir --------------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=2 device=xcvc1902 l1-bank-aware" 2>&1 | FileCheck %s
+
+// The input and output buffers are filled and drained by the tile DMA while
+// the core computes on all three buffers, so each gets a bank of its own.
+// The xcvc1902 L1 has four banks of 8192 bytes and the core stack takes the
+// first 1024 bytes. Buffers are placed largest first: "in" goes to bank 0
+// above the stack, "out" to bank 1 and "acc" to bank 2. First-fit placement
+// would have put "acc" at 12288, in bank 1 next to "out".
+
+// CHECK: remark: peak L1 usage: 18432 of 32768 bytes, estimated bank conflict rate: 0.00
+// CHECK: aie.device
+// CHECK-DAG: aie.buffer({{.*}}) {address = 1024 : i32, sym_name = "in_0_0"} : memref<1536xi32, 2>
+// CHECK-DAG: aie.buffer({{.*}}) {address = 8192 : i32, sym_name = "out_0_0"} : memref<1024xi32, 2>
+// CHECK-DAG: aie.buffer({{.*}}) {address = 16384 : i32, sym_name = "acc_0_0"} : memref<512xi32, 2>
+func.func @func1(%arg0 : memref<1536xi32>, %arg1 : memref<1024xi32>) -> () {
+  %herd_cols = arith.constant 1 : index
+  %herd_rows = arith.constant 1 : index
+  air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) args(%ext0 = %arg0, %ext1 = %arg1) : memref<1536xi32>, memref<1024xi32> attributes { sym_name="herd1"} {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c1024 = arith.constant 1024 : index
+    %c1536 = arith.constant 1536 : index
+    %in = memref.alloc() {sym_name = "in"} : memref<1536xi32, 2>
+    %out = memref.alloc() {sym_name = "out"} : memref<1024xi32, 2>
+    %acc = memref.alloc() {sym_name = "acc"} : memref<512xi32, 2>
+    air.dma_memcpy_nd (%in[] [] [], %ext0[%c0] [%c1536] [%c1]) {id = 1 : i32} : (memref<1536xi32, 2>, memref<1536xi32>)
+    func.call @kernel(%in, %acc, %out) : (memref<1536xi32, 2>, memref<512xi32, 2>, memref<1024xi32, 2>) -> ()
+    air.dma_memcpy_nd (%ext1[%c0] [%c1024] [%c1], %out[] [] []) {id = 2 : i32} : (memref<1024xi32>, memref<1024xi32, 2>)
+    memref.dealloc %acc : memref<512xi32, 2>
+    memref.dealloc %out : memref<1024xi32, 2>
+    memref.dealloc %in : memref<1536xi32, 2>
+  }
+  return
+}
+
+func.func private @kernel(memref<1536xi32, 2>, memref<512xi32, 2>, memref<1024xi32, 2>) -> ()
@@ -0,0 +1,38 @@
+//===- l1_buffer_reuse.mlir ------------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=2 device=xcvc1902 l1-buffer-reuse" 2>&1 | FileCheck %s
+
+// The scratch buffers have disjoint lifetimes and share an address. The DMA
+// destination is live for the whole core and overlaps neither of them.
+
+// CHECK: remark: peak L1 usage: {{[0-9]+}} of 32768 bytes
+// CHECK: aie.device
+// CHECK-DAG: aie.buffer({{.*}}) {address = [[SCRATCH:[0-9]+]] : i32, sym_name = "scratch_a_0_0"} : memref<1024xi32, 2>
+// CHECK-DAG: aie.buffer({{.*}}) {address = [[SCRATCH]] : i32, sym_name = "scratch_b_0_0"} : memref<1024xi32, 2>
+// CHECK-DAG: aie.buffer({{.*}}) {address = {{[0-9]+}} : i32, sym_name = "dma_in_0_0"} : memref<1024xi32, 2>
+func.func @func1(%arg0 : memref<1024xi32>) -> () {
+  %herd_cols = arith.constant 1 : index
+  %herd_rows = arith.constant 1 : index
+  air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) args(%ext0 = %arg0) : memref<1024xi32> attributes { sym_name="herd1"} {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c1024 = arith.constant 1024 : index
+    %c0_i32 = arith.constant 0 : i32
+    %c1_i32 = arith.constant 1 : i32
+    %in = memref.alloc() {sym_name = "dma_in"} : memref<1024xi32, 2>
+    air.dma_memcpy_nd (%in[] [] [], %ext0[%c0] [%c1024] [%c1]) {id = 1 : i32} : (memref<1024xi32, 2>, memref<1024xi32>)
+    %a = memref.alloc() {sym_name = "scratch_a"} : memref<1024xi32, 2>
+    linalg.fill ins(%c0_i32 : i32) outs(%a : memref<1024xi32, 2>)
+    memref.dealloc %a : memref<1024xi32, 2>
+    %b = memref.alloc() {sym_name = "scratch_b"} : memref<1024xi32, 2>
+    linalg.fill ins(%c1_i32 : i32) outs(%b : memref<1024xi32, 2>)
+    memref.dealloc %b : memref<1024xi32, 2>
+    memref.dealloc %in : memref<1024xi32, 2>
+  }
+  return
+}
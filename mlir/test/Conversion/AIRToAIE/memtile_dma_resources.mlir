@@ -0,0 +1,39 @@
+//===- memtile_dma_resources.mlir ------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=0 device=npu1_1col report-memtile-dma-usage" 2>&1 | FileCheck %s
+
+// CHECK: remark: memtile DMA usage: BDs 4 of 48, locks {{[0-9]+}} of 64, S2MM channels 2 of 6, MM2S channels 2 of 6
+// CHECK: @func0
+
+air.channel @channel_0 [1, 1]
+air.channel @channel_1 [1, 1]
+air.channel @channel_2 [1, 1]
+air.channel @channel_3 [1, 1]
+func.func @func0(%arg0 : memref<64xi32>, %arg1 : memref<64xi32>) -> () {
+  air.channel.put @channel_0[] (%arg0[] [] []) {id = 1 : i32} : (memref<64xi32>)
+  air.segment @segment0 {
+    %herd_cols = arith.constant 1 : index
+    %herd_rows = arith.constant 1 : index
+    %memtile0 = memref.alloc() : memref<64xi32, 1>
+    air.channel.get @channel_0[] (%memtile0[] [] []) {id = 2 : i32} : (memref<64xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[] [] []) {id = 3 : i32} : (memref<64xi32, 1>)
+    memref.dealloc %memtile0 : memref<64xi32, 1>
+    air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) attributes { sym_name="herd0"} {
+      %buf0 = memref.alloc() : memref<64xi32, 2>
+      air.channel.get @channel_1[%tx, %ty] (%buf0[] [] []) {id = 4 : i32} : (memref<64xi32, 2>)
+      air.channel.put @channel_2[%tx, %ty] (%buf0[] [] []) {id = 5 : i32} : (memref<64xi32, 2>)
+      memref.dealloc %buf0 : memref<64xi32, 2>
+    }
+    %memtile1 = memref.alloc() : memref<64xi32, 1>
+    air.channel.get @channel_2[] (%memtile1[] [] []) {id = 6 : i32} : (memref<64xi32, 1>)
+    air.channel.put @channel_3[] (%memtile1[] [] []) {id = 7 : i32} : (memref<64xi32, 1>)
+    memref.dealloc %memtile1 : memref<64xi32, 1>
+  }
+  air.channel.get @channel_3[] (%arg1[] [] []) {id = 8 : i32} : (memref<64xi32>)
+  return
+}
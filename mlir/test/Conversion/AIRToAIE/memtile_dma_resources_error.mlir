@@ -0,0 +1,83 @@
+//===- memtile_dma_resources_error.mlir ------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: not air-opt %s -air-to-aie="row-offset=2 col-offset=0 device=npu1_1col check-memtile-dma-resources" 2>&1 | FileCheck %s
+
+// Twenty-five distinct BDs on memtile MM2S channel 0 do not fit in the 24 BD
+// ids reachable from the even memtile channels.
+
+// CHECK: error: 'aie.tile' op memtile DMA needs 26 BDs on channels S2MM 0 (1) MM2S 0 (25), but only 24 BD ids are reachable from them
+
+air.channel @channel_0 [1, 1]
+air.channel @channel_1 [1, 1]
+func.func @func1(%arg0 : memref<1600xi32>) -> () {
+  air.channel.put @channel_0[] (%arg0[] [] []) {id = 1 : i32} : (memref<1600xi32>)
+  air.segment @segment0 {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c64 = arith.constant 64 : index
+    %c128 = arith.constant 128 : index
+    %c192 = arith.constant 192 : index
+    %c256 = arith.constant 256 : index
+    %c320 = arith.constant 320 : index
+    %c384 = arith.constant 384 : index
+    %c448 = arith.constant 448 : index
+    %c512 = arith.constant 512 : index
+    %c576 = arith.constant 576 : index
+    %c640 = arith.constant 640 : index
+    %c704 = arith.constant 704 : index
+    %c768 = arith.constant 768 : index
+    %c832 = arith.constant 832 : index
+    %c896 = arith.constant 896 : index
+    %c960 = arith.constant 960 : index
+    %c1024 = arith.constant 1024 : index
+    %c1088 = arith.constant 1088 : index
+    %c1152 = arith.constant 1152 : index
+    %c1216 = arith.constant 1216 : index
+    %c1280 = arith.constant 1280 : index
+    %c1344 = arith.constant 1344 : index
+    %c1408 = arith.constant 1408 : index
+    %c1472 = arith.constant 1472 : index
+    %c1536 = arith.constant 1536 : index
+    %herd_cols = arith.constant 1 : index
+    %herd_rows = arith.constant 1 : index
+    %memtile0 = memref.alloc() : memref<1600xi32, 1>
+    air.channel.get @channel_0[] (%memtile0[] [] []) {id = 2 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c0] [%c64] [%c1]) {id = 3 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c64] [%c64] [%c1]) {id = 4 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c128] [%c64] [%c1]) {id = 5 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c192] [%c64] [%c1]) {id = 6 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c256] [%c64] [%c1]) {id = 7 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c320] [%c64] [%c1]) {id = 8 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c384] [%c64] [%c1]) {id = 9 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c448] [%c64] [%c1]) {id = 10 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c512] [%c64] [%c1]) {id = 11 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c576] [%c64] [%c1]) {id = 12 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c640] [%c64] [%c1]) {id = 13 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c704] [%c64] [%c1]) {id = 14 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c768] [%c64] [%c1]) {id = 15 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c832] [%c64] [%c1]) {id = 16 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c896] [%c64] [%c1]) {id = 17 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c960] [%c64] [%c1]) {id = 18 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1024] [%c64] [%c1]) {id = 19 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1088] [%c64] [%c1]) {id = 20 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1152] [%c64] [%c1]) {id = 21 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1216] [%c64] [%c1]) {id = 22 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1280] [%c64] [%c1]) {id = 23 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1344] [%c64] [%c1]) {id = 24 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1408] [%c64] [%c1]) {id = 25 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1472] [%c64] [%c1]) {id = 26 : i32} : (memref<1600xi32, 1>)
+    air.channel.put @channel_1[] (%memtile0[%c1536] [%c64] [%c1]) {id = 27 : i32} : (memref<1600xi32, 1>)
+    memref.dealloc %memtile0 : memref<1600xi32, 1>
+    air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) attributes { sym_name="herd1"} {
+      %buf0 = memref.alloc() : memref<64xi32, 2>
+      air.channel.get @channel_1[%tx, %ty] (%buf0[] [] []) {id = 28 : i32} : (memref<64xi32, 2>)
+      memref.dealloc %buf0 : memref<64xi32, 2>
+    }
+  }
+  return
+}
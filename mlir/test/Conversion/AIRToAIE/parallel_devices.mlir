@@ -0,0 +1,50 @@
+//===- parallel_devices.mlir -----------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=2 device=xcvc1902" > %t.mt.mlir
+// RUN: air-opt %s -air-to-aie="row-offset=2 col-offset=2 device=xcvc1902" --mlir-disable-threading > %t.st.mlir
+// RUN: diff %t.mt.mlir %t.st.mlir
+// RUN: FileCheck %s --input-file=%t.mt.mlir
+
+// Each herd is lowered into its own aie.device. The devices are lowered
+// concurrently; the output must match the single-threaded lowering and keep
+// the device order of the input.
+
+// CHECK: aie.device(xcvc1902)
+// CHECK:   %[[T0:.*]] = aie.tile(2, 2)
+// CHECK:   aie.buffer(%[[T0]]) {{.*}} : memref<1024xi32, 2>
+// CHECK:   aie.mem(%[[T0]])
+// CHECK:   aie.core(%[[T0]])
+// CHECK:   aie.flow
+// CHECK: aie.device(xcvc1902)
+// CHECK:   %[[T1:.*]] = aie.tile(2, 2)
+// CHECK:   aie.buffer(%[[T1]]) {{.*}} : memref<512xi32, 2>
+// CHECK:   aie.mem(%[[T1]])
+// CHECK:   aie.core(%[[T1]])
+// CHECK:   aie.flow
+// CHECK: func.func @func1
+func.func @func1(%arg0 : memref<1024xi32>, %arg1 : memref<1024xi32>) -> () {
+  %herd_cols = arith.constant 1 : index
+  %herd_rows = arith.constant 1 : index
+  air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) args(%ext0 = %arg0) : memref<1024xi32> attributes { sym_name="herd1"} {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c1024 = arith.constant 1024 : index
+    %buf0 = memref.alloc() : memref<1024xi32, 2>
+    air.dma_memcpy_nd (%buf0[] [] [], %ext0[%c0] [%c1024] [%c1]) {id = 1 : i32} : (memref<1024xi32, 2>, memref<1024xi32>)
+    memref.dealloc %buf0 : memref<1024xi32, 2>
+  }
+  air.herd tile(%tx, %ty) in (%size_x = %herd_cols, %size_y = %herd_rows) args(%ext1 = %arg1) : memref<1024xi32> attributes { sym_name="herd2"} {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c512 = arith.constant 512 : index
+    %buf1 = memref.alloc() : memref<512xi32, 2>
+    air.dma_memcpy_nd (%ext1[%c0] [%c512] [%c1], %buf1[] [] []) {id = 2 : i32} : (memref<1024xi32>, memref<512xi32, 2>)
+    memref.dealloc %buf1 : memref<512xi32, 2>
+  }
+  return
+}
@@ -0,0 +1,171 @@
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+
+#include "air/Dialect/AIR/AIRDialect.h"
+#include "air/Util/ChannelSymbolIndex.h"
+#include "air/Util/Util.h"
+
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/ControlFlow/IR/ControlFlow.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Parser/Parser.h"
+
+#include <stdexcept>
+
+using namespace mlir;
+using namespace xilinx;
+
+// ^bb2 is reached from the entry block before ^bb1, but comes after it in the
+// region
+static const char *kModule = R"mlir(
+module {
+  air.channel @a [1]
+  air.channel @b [1]
+  func.func @f(%m: memref<4xi32>, %c: i1) {
+    air.channel.put @a[] (%m[] [] []) {id = 0 : i32} : (memref<4xi32>)
+    air.channel.get @b[] (%m[] [] []) {id = 3 : i32} : (memref<4xi32>)
+    cf.cond_br %c, ^bb2, ^bb1
+  ^bb1:
+    air.channel.put @a[] (%m[] [] []) {id = 2 : i32} : (memref<4xi32>)
+    return
+  ^bb2:
+    air.channel.put @a[] (%m[] [] []) {id = 1 : i32} : (memref<4xi32>)
+    return
+  }
+}
+)mlir";
+
+static void check(bool cond, const char *what) {
+  if (!cond)
+    throw std::runtime_error(what);
+}
+
+static std::vector<int> ids(const std::vector<air::ChannelPutOp> &puts) {
+  std::vector<int> result;
+  for (auto put : puts)
+    result.push_back(put->getAttrOfType<IntegerAttr>("id").getInt());
+  return result;
+}
+
+static air::ChannelOp getChannel(ModuleOp module, StringRef name) {
+  return dyn_cast_or_null<air::ChannelOp>(
+      SymbolTable::lookupSymbolIn(module, name));
+}
+
+static air::ChannelPutOp getPut(ModuleOp module, int id) {
+  air::ChannelPutOp result;
+  module.walk([&](air::ChannelPutOp put) {
+    if (put->getAttrOfType<IntegerAttr>("id").getInt() == id)
+      result = put;
+  });
+  return result;
+}
+
+static air::ChannelGetOp getGet(ModuleOp module) {
+  air::ChannelGetOp result;
+  module.walk([&](air::ChannelGetOp get) { result = get; });
+  return result;
+}
+
+void orderTest(ModuleOp module) {
+  air::ChannelSymbolIndex index(module);
+  auto a = getChannel(module, "a");
+
+  // The same order as the walk of getChannelPutOpThroughSymbol, both after
+  // a rebuild and after ops were inserted out of order
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{0, 1, 2},
+        "Incorrect order after building the index");
+  check(ids(air::getChannelPutOpThroughSymbol(a)) ==
+            std::vector<int>{0, 1, 2},
+        "Incorrect order of getChannelPutOpThroughSymbol");
+  index.erase(getPut(module, 1));
+  index.erase(getPut(module, 0));
+  index.insert(getPut(module, 1));
+  index.insert(getPut(module, 0));
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{0, 1, 2},
+        "Incorrect order after inserting ops");
+
+  auto gets = index.getChannelGetOps(getChannel(module, "b"));
+  check(gets.size() == 1 && gets[0] == getGet(module), "Get not indexed");
+  check(index.getTheOtherChannelOps(getGet(module)).empty(),
+        "Channel @b has no put");
+}
+
+void listenerTest(ModuleOp module) {
+  air::ChannelSymbolIndex index(module);
+  air::ChannelSymbolIndex::Listener listener(index);
+  IRRewriter rewriter(module.getContext(), &listener);
+  auto a = getChannel(module, "a");
+  auto b = getChannel(module, "b");
+
+  // Created ops are added in program order
+  auto put0 = getPut(module, 0);
+  rewriter.setInsertionPoint(put0);
+  Operation *clone = rewriter.clone(*getPut(module, 2));
+  clone->setAttr("id", rewriter.getI32IntegerAttr(4));
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{4, 0, 1, 2},
+        "Cloned put not indexed");
+
+  // Erased ops are dropped
+  rewriter.eraseOp(clone);
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{0, 1, 2},
+        "Erased put still indexed");
+
+  // Ops renamed in place move to their new channel
+  auto put2 = getPut(module, 2);
+  rewriter.modifyOpInPlace(put2, [&]() {
+    put2.setChanNameAttr(FlatSymbolRefAttr::get(module.getContext(), "b"));
+  });
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{0, 1},
+        "Renamed put still under its old channel");
+  check(ids(index.getChannelPutOps(b)) == std::vector<int>{2},
+        "Renamed put not under its new channel");
+  check(ids(index.getTheOtherChannelOps(getGet(module))) ==
+            std::vector<int>{2},
+        "Renamed put not the other side of the get");
+}
+
+void renameSymbolTest(ModuleOp module) {
+  air::ChannelSymbolIndex index(module);
+  auto a = getChannel(module, "a");
+  auto *ctx = module.getContext();
+
+  // Renaming a channel moves its users along
+  auto oldName = a.getSymNameAttr();
+  auto newName = StringAttr::get(ctx, "c");
+  check(succeeded(SymbolTable::replaceAllSymbolUses(a, newName, module)),
+        "Failed to rename the channel");
+  SymbolTable::setSymbolName(a, newName);
+  index.replaceSymbol(oldName, newName);
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{0, 1, 2},
+        "Users not moved to the renamed channel");
+
+  // Manual erase before the op goes away
+  auto put1 = getPut(module, 1);
+  index.erase(put1);
+  put1->erase();
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{0, 2},
+        "Erased put still indexed");
+  index.rebuild();
+  check(ids(index.getChannelPutOps(a)) == std::vector<int>{0, 2},
+        "Rebuilt index differs");
+}
+
+int main() {
+  DialectRegistry registry;
+  registry.insert<air::airDialect, arith::ArithDialect,
+                  cf::ControlFlowDialect, func::FuncDialect,
+                  memref::MemRefDialect>();
+  MLIRContext context(registry);
+
+  for (auto test : {orderTest, listenerTest, renameSymbolTest}) {
+    OwningOpRef<ModuleOp> module =
+        parseSourceString<ModuleOp>(kModule, &context);
+    check(bool(module), "Failed to parse the test module");
+    test(*module);
+  }
+  return 0;
+}
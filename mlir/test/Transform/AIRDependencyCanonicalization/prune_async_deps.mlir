@@ -0,0 +1,54 @@
+//===- prune_async_deps.mlir -----------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-prune-async-deps | FileCheck %s
+
+// RAW, WAR and WAW dependencies are kept while RAR and unrelated ones are
+// dropped, air.wait_all ops are looked through and erased once unused, and
+// dependencies of other dependencies are dropped.
+
+// CHECK-LABEL: func.func @prune
+// CHECK: %[[T0:.*]], %[[A:.*]] = air.execute
+// CHECK: %[[T1:.*]], %[[B:.*]] = air.execute
+// CHECK: %[[PUT0:.*]] = air.channel.put async [%[[T0]]]  @channel_0[] (%[[A]]
+// CHECK: %[[PUT1:.*]] = air.channel.put async [%[[T0]]]  @channel_0[] (%[[A]]
+// CHECK-NOT: air.wait_all
+// CHECK: %[[GET0:.*]] = air.channel.get async [%[[PUT0]], %[[PUT1]]]  @channel_1[] (%[[A]]
+// CHECK: air.channel.get async [%[[T1]]]  @channel_1[] (%[[B]]
+// CHECK: air.channel.get async [%[[PUT1]]]  @channel_1[] (%[[A]]
+// CHECK: %[[FOR:.*]] = scf.for
+// CHECK: air.channel.get async [%[[T1]]]  @channel_1[] (%[[B]]
+// CHECK: air.channel.get async [%[[FOR]]]  @channel_1[] (%[[A]]
+
+air.channel @channel_0 [1, 1]
+air.channel @channel_1 [1, 1]
+func.func @prune() {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %t0, %a = air.execute -> (memref<32xi32, 1>) {
+    %alloc = memref.alloc() : memref<32xi32, 1>
+    air.execute_terminator %alloc : memref<32xi32, 1>
+  }
+  %t1, %b = air.execute -> (memref<32xi32, 1>) {
+    %alloc = memref.alloc() : memref<32xi32, 1>
+    air.execute_terminator %alloc : memref<32xi32, 1>
+  }
+  %0 = air.channel.put async [%t0]  @channel_0[] (%a[] [] []) : (memref<32xi32, 1>) // RAW
+  %1 = air.channel.put async [%t0, %0]  @channel_0[] (%a[] [] []) : (memref<32xi32, 1>) // RAW, RAR
+  %2 = air.wait_all async [%0, %1]
+  %3 = air.channel.get async [%2]  @channel_1[] (%a[] [] []) : (memref<32xi32, 1>) // WAR
+  %4 = air.channel.get async [%t0, %t1, %3]  @channel_1[] (%b[] [] []) : (memref<32xi32, 1>) // WAW, unrelated
+  %5 = air.channel.get async [%t0, %1]  @channel_1[] (%a[] [] []) : (memref<32xi32, 1>) // WAW, WAR
+  %6 = scf.for %arg0 = %c0 to %c4 step %c1 iter_args(%arg1 = %t0) -> (!air.async.token) {
+    %9 = air.channel.put async [%arg1]  @channel_0[] (%a[] [] []) : (memref<32xi32, 1>)
+    scf.yield %9 : !air.async.token
+  }
+  %7 = air.channel.get async [%t1, %6]  @channel_1[] (%b[] [] []) : (memref<32xi32, 1>) // unrelated
+  %8 = air.channel.get async [%6]  @channel_1[] (%a[] [] []) : (memref<32xi32, 1>) // WAR
+  return
+}
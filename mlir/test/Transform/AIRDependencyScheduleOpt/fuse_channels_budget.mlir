@@ -0,0 +1,76 @@
+//===- fuse_channels_budget.mlir -------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-fuse-channels="aggressive-mode=L2,L3 bandwidth-budget=256" | FileCheck %s --check-prefix=FITS
+// RUN: air-opt %s -air-fuse-channels="aggressive-mode=L2,L3 bandwidth-budget=160" | FileCheck %s --check-prefix=BANDWIDTH
+// RUN: air-opt %s -air-fuse-channels="aggressive-mode=L2,L3 channel-budget=2" | FileCheck %s --check-prefix=CHANNELS
+
+// Three 64-byte L3 to L2 streams. With enough bandwidth all of them share one
+// channel; a tighter bandwidth budget admits only a single fusion, and a
+// channel budget of two stops fusing once two channels remain.
+
+// FITS-LABEL: func0
+// FITS: air.channel.put @channel_0
+// FITS: air.channel.put @channel_0
+// FITS: air.channel.put @channel_0
+// FITS: air.segment
+// FITS: air.channel.get @channel_0
+// FITS: air.channel.get @channel_0
+// FITS: air.channel.get @channel_0
+
+// BANDWIDTH-LABEL: func0
+// BANDWIDTH: air.channel.put @channel_0
+// BANDWIDTH: air.channel.put @channel_0
+// BANDWIDTH: air.channel.put @channel_2
+// BANDWIDTH: air.segment
+// BANDWIDTH: air.channel.get @channel_0
+// BANDWIDTH: air.channel.get @channel_0
+// BANDWIDTH: air.channel.get @channel_2
+
+// CHANNELS-LABEL: func0
+// CHANNELS: air.channel.put @channel_0
+// CHANNELS: air.channel.put @channel_0
+// CHANNELS: air.channel.put @channel_2
+// CHANNELS: air.segment
+// CHANNELS: air.channel.get @channel_0
+// CHANNELS: air.channel.get @channel_0
+// CHANNELS: air.channel.get @channel_2
+
+module {
+  air.channel @channel_0 [1, 1]
+  air.channel @channel_1 [1, 1]
+  air.channel @channel_2 [1, 1]
+  func.func @func0(){
+    %c1 = arith.constant 1 : index
+    air.launch (%arg3, %arg4) in (%arg5=%c1, %arg6=%c1) {
+      %alloc_0 = memref.alloc() : memref<4x4xi32>
+      %alloc_1 = memref.alloc() : memref<4x4xi32>
+      %alloc_2 = memref.alloc() : memref<4x4xi32>
+      air.channel.put @channel_0[%arg3, %arg4] (%alloc_0[] [] []) : (memref<4x4xi32>)
+      air.channel.put @channel_1[%arg3, %arg4] (%alloc_1[] [] []) : (memref<4x4xi32>)
+      air.channel.put @channel_2[%arg3, %arg4] (%alloc_2[] [] []) : (memref<4x4xi32>)
+      air.segment {
+        %c2 = arith.constant 2 : index
+        %alloc_3 = memref.alloc() : memref<4x4xi32, 1>
+        %alloc_4 = memref.alloc() : memref<4x4xi32, 1>
+        %alloc_5 = memref.alloc() : memref<4x4xi32, 1>
+        air.channel.get @channel_0[] (%alloc_3[] [] []) : (memref<4x4xi32, 1>)
+        air.channel.get @channel_1[] (%alloc_4[] [] []) : (memref<4x4xi32, 1>)
+        air.channel.get @channel_2[] (%alloc_5[] [] []) : (memref<4x4xi32, 1>)
+        air.herd @herd_0 tile (%arg12, %arg13) in (%arg14=%c2, %arg15=%c2) {
+        }
+        memref.dealloc %alloc_3 : memref<4x4xi32, 1>
+        memref.dealloc %alloc_4 : memref<4x4xi32, 1>
+        memref.dealloc %alloc_5 : memref<4x4xi32, 1>
+      }
+      memref.dealloc %alloc_0 : memref<4x4xi32>
+      memref.dealloc %alloc_1 : memref<4x4xi32>
+      memref.dealloc %alloc_2 : memref<4x4xi32>
+    }
+    return
+  }
+}
@@ -0,0 +1,125 @@
+//===- multi_buffer.mlir ---------------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-multi-buffer="depth=4" --split-input-file | FileCheck %s --check-prefix=DEPTH4
+// RUN: air-opt %s -air-multi-buffer --split-input-file | FileCheck %s --check-prefix=AUTO
+// RUN: air-opt %s -air-multi-buffer="l1-size=12288" --split-input-file | FileCheck %s --check-prefix=L1CAP
+
+// Quadruple buffering: four hoisted buffers, one free token per buffer plus
+// the consumer and producer chain tokens carried by the loop. Each buffer's
+// producer waits for its own free token, and for the previous buffer's
+// producer.
+
+// DEPTH4-LABEL: quad_buffer
+// DEPTH4-COUNT-4: memref.alloc() : memref<1x256x112x4xi8, 1>
+// DEPTH4: %{{.*}}:6 = scf.for {{.*}} iter_args(%[[FREE0:.*]] = {{.*}}, %[[FREE1:.*]] = {{.*}}, %[[FREE2:.*]] = {{.*}}, %[[FREE3:.*]] = {{.*}}, %[[CCHAIN:.*]] = {{.*}}, %[[PCHAIN:.*]] = {{.*}})
+// DEPTH4: %[[GET0:.*]] = air.channel.get async [%[[PCHAIN]], %[[FREE0]]] @channel_0[]
+// DEPTH4: %[[GET1:.*]] = air.channel.get async [%[[GET0]], %[[FREE1]]] @channel_0[]
+// DEPTH4: %[[GET2:.*]] = air.channel.get async [%[[GET1]], %[[FREE2]]] @channel_0[]
+// DEPTH4: %[[GET3:.*]] = air.channel.get async [%[[GET2]], %[[FREE3]]] @channel_0[]
+// DEPTH4: scf.yield {{.*}}, %[[GET3]] : !air.async.token, !air.async.token, !air.async.token, !air.async.token, !air.async.token, !air.async.token
+// DEPTH4-COUNT-4: memref.dealloc {{.*}} : memref<1x256x112x4xi8, 1>
+
+// Without any compute to estimate, the automatic depth falls back to two.
+
+// AUTO-LABEL: quad_buffer
+// AUTO: %{{.*}}:4 = scf.for
+
+module {
+  func.func @quad_buffer() {
+    %c1 = arith.constant 1 : index
+    %0 = air.launch async (%arg0, %arg1) in (%arg2=%c1, %arg3=%c1) attributes {id = 1 : i32} {
+      %1 = air.segment async  attributes {id = 2 : i32} {
+        %c448 = arith.constant 448 : index
+        %c114688 = arith.constant 114688 : index
+        %c1_0 = arith.constant 1 : index
+        %c0 = arith.constant 0 : index
+        %c112 = arith.constant 112 : index
+        %c256 = arith.constant 256 : index
+        %c4 = arith.constant 4 : index
+        %c12544 = arith.constant 12544 : index
+        %2 = air.wait_all async 
+        %3 = scf.for %arg4 = %c0 to %c112 step %c4 iter_args(%arg5 = %2) -> (!air.async.token) {
+          %async_token, %results = air.execute [%arg5] -> (memref<1x256x112x4xi8, 1>) {
+            %alloc = memref.alloc() : memref<1x256x112x4xi8, 1>
+            air.execute_terminator %alloc : memref<1x256x112x4xi8, 1>
+          }
+          %5 = air.channel.get async [%async_token]  @channel_0[] (%results[] [] []) {id = 2 : i32} : (memref<1x256x112x4xi8, 1>)
+          %6 = scf.for %arg6 = %c0 to %c4 step %c1_0 iter_args(%arg7 = %5) -> (!air.async.token) {
+            %7 = air.channel.put async [%arg7]  @channel_1[%c0, %c0] (%results[%c0, %c0, %c0, %arg6] [%c1_0, %c256, %c112, %c1_0] [%c114688, %c12544, %c448, %c1_0]) {id = 3 : i32} : (memref<1x256x112x4xi8, 1>)
+            scf.yield %7 : !air.async.token
+          }
+          %async_token_1 = air.execute [%6] {
+            memref.dealloc %results : memref<1x256x112x4xi8, 1>
+          }
+          scf.yield %async_token_1 : !air.async.token
+        }
+      }
+    }
+    return
+  }
+}
+
+// -----
+
+// Automatic depth for an L1 loop. Filling a 2 KiB buffer takes 512 cycles at
+// 4 bytes per cycle, against 16 cycles of compute for a 32x32 iteration
+// space, so the latency would call for 33 buffers. The loop's six iterations
+// cap this at six buffers. With 12 KiB of L1, of which the output takes 4 KiB,
+// only four buffers fit, reduced to three so that the depth divides the trip
+// count.
+
+// AUTO-LABEL: auto_depth
+// AUTO: air.herd
+// AUTO-COUNT-6: memref.alloc() : memref<32x32xbf16, 2>
+// AUTO: %{{.*}}:8 = scf.for
+
+// L1CAP-LABEL: auto_depth
+// L1CAP: air.herd
+// L1CAP-COUNT-3: memref.alloc() : memref<32x32xbf16, 2>
+// L1CAP: %{{.*}}:5 = scf.for
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+module {
+  func.func @auto_depth() {
+    %c1 = arith.constant 1 : index
+    %0 = air.launch async (%arg0, %arg1) in (%arg2=%c1, %arg3=%c1) {
+      %1 = air.segment async {
+        %c1_0 = arith.constant 1 : index
+        %2 = air.herd @herd_0 async tile (%arg4, %arg5) in (%arg6=%c1_0, %arg7=%c1_0) {
+          %c0 = arith.constant 0 : index
+          %c1_1 = arith.constant 1 : index
+          %c6 = arith.constant 6 : index
+          %async_token_0, %results_0 = air.execute -> (memref<32x32xf32, 2>) {
+            %alloc = memref.alloc() : memref<32x32xf32, 2>
+            air.execute_terminator %alloc : memref<32x32xf32, 2>
+          }
+          %3 = scf.for %arg8 = %c0 to %c6 step %c1_1 iter_args(%arg9 = %async_token_0) -> (!air.async.token) {
+            %async_token, %results = air.execute [%arg9] -> (memref<32x32xbf16, 2>) {
+              %alloc = memref.alloc() : memref<32x32xbf16, 2>
+              air.execute_terminator %alloc : memref<32x32xbf16, 2>
+            }
+            %4 = air.channel.get async [%async_token]  @channel_0[] (%results[] [] []) : (memref<32x32xbf16, 2>)
+            %async_token_1 = air.execute [%4] {
+              linalg.generic {indexing_maps = [#map, #map], iterator_types = ["parallel", "parallel"]} ins(%results : memref<32x32xbf16, 2>) outs(%results_0 : memref<32x32xf32, 2>) {
+              ^bb0(%in: bf16, %out: f32):
+                %5 = arith.extf %in : bf16 to f32
+                %6 = arith.addf %5, %out : f32
+                linalg.yield %6 : f32
+              }
+            }
+            %async_token_2 = air.execute [%async_token_1] {
+              memref.dealloc %results : memref<32x32xbf16, 2>
+            }
+            scf.yield %async_token_2 : !air.async.token
+          }
+        }
+      }
+    }
+    return
+  }
+}
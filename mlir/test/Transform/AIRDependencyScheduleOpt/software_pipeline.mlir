@@ -0,0 +1,161 @@
+//===- software_pipeline.mlir ----------------------------------*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-software-pipeline --split-input-file | FileCheck %s
+
+// Two-stage pipeline: the loads and compute of the first iteration form the
+// prologue, the kernel writes back iteration i-1 while loading iteration i,
+// and the epilogue writes back the last iteration.
+
+// CHECK-LABEL: load_compute_store
+// CHECK: air.herd
+// CHECK: %[[P_GET_A:.*]] = air.channel.get async [%{{.*}}] @channel_a[]
+// CHECK: %[[P_GET_B:.*]] = air.channel.get async [%{{.*}}] @channel_b[]
+// CHECK: %[[P_COMPUTE:.*]] = air.execute [%[[P_GET_A]], %[[P_GET_B]]]
+// CHECK: linalg.matmul
+// CHECK: %[[P_JOIN:.*]] = air.wait_all async [%[[P_GET_A]], %[[P_GET_B]], %[[P_COMPUTE]]]
+// CHECK: %[[KERNEL:.*]]:3 = scf.for %[[IV:[a-zA-Z0-9_]+]] = %c1{{.*}} to %c8{{.*}} step %c1{{.*}} iter_args(%[[LOAD:[a-zA-Z0-9_]+]] = %[[P_JOIN]], %{{.*}} = %{{.*}}, %[[PREV_COMPUTE:[a-zA-Z0-9_]+]] = %[[P_COMPUTE]])
+// CHECK: %[[PREV_IV:.*]] = arith.subi %[[IV]], %c1
+// CHECK: %[[K_PUT:.*]] = air.channel.put async [%[[PREV_COMPUTE]]] @channel_c[]
+// CHECK: %[[WB:.*]] = air.wait_all async [%[[K_PUT]]]
+// CHECK: %[[K_GET_A:.*]] = air.channel.get async [%[[LOAD]]] @channel_a[]
+// CHECK: %[[K_GET_B:.*]] = air.channel.get async [%[[LOAD]]] @channel_b[]
+// CHECK: %[[K_COMPUTE:.*]] = air.execute [%[[K_GET_A]], %[[K_GET_B]], %[[WB]]]
+// CHECK: linalg.matmul
+// CHECK: %[[K_JOIN:.*]] = air.wait_all async [%[[K_GET_A]], %[[K_GET_B]], %[[K_COMPUTE]]]
+// CHECK: scf.yield %[[K_JOIN]], %[[WB]], %[[K_COMPUTE]]
+// CHECK: %[[E_PUT:.*]] = air.channel.put async [%[[KERNEL]]#2] @channel_c[]
+// CHECK: air.wait_all async [%[[E_PUT]], %[[KERNEL]]#0]
+
+module {
+  air.channel @channel_a [1, 1]
+  air.channel @channel_b [1, 1]
+  air.channel @channel_c [1, 1]
+  func.func @load_compute_store() {
+    %c1 = arith.constant 1 : index
+    %0 = air.herd @herd_0 async tile (%arg0, %arg1) in (%arg2=%c1, %arg3=%c1) {
+      %c0 = arith.constant 0 : index
+      %c1_0 = arith.constant 1 : index
+      %c8 = arith.constant 8 : index
+      %async_token, %results = air.execute -> (memref<32x32xi32, 2>) {
+        %alloc = memref.alloc() : memref<32x32xi32, 2>
+        air.execute_terminator %alloc : memref<32x32xi32, 2>
+      }
+      %async_token_1, %results_2 = air.execute -> (memref<32x32xi32, 2>) {
+        %alloc = memref.alloc() : memref<32x32xi32, 2>
+        air.execute_terminator %alloc : memref<32x32xi32, 2>
+      }
+      %async_token_3, %results_4 = air.execute -> (memref<32x32xi32, 2>) {
+        %alloc = memref.alloc() : memref<32x32xi32, 2>
+        air.execute_terminator %alloc : memref<32x32xi32, 2>
+      }
+      %1 = air.wait_all async [%async_token, %async_token_1, %async_token_3]
+      %2 = scf.for %arg4 = %c0 to %c8 step %c1_0 iter_args(%arg5 = %1) -> (!air.async.token) {
+        %3 = air.channel.get async [%arg5] @channel_a[] (%results[] [] []) : (memref<32x32xi32, 2>)
+        %4 = air.channel.get async [%arg5] @channel_b[] (%results_2[] [] []) : (memref<32x32xi32, 2>)
+        %async_token_5 = air.execute [%3, %4] {
+          linalg.matmul ins(%results, %results_2 : memref<32x32xi32, 2>, memref<32x32xi32, 2>) outs(%results_4 : memref<32x32xi32, 2>)
+        }
+        %5 = air.channel.put async [%async_token_5] @channel_c[] (%results_4[] [] []) : (memref<32x32xi32, 2>)
+        %6 = air.wait_all async [%3, %4, %async_token_5, %5]
+        scf.yield %6 : !air.async.token
+      }
+      air.herd_terminator
+    }
+    return
+  }
+}
+
+// -----
+
+// Loops which load into the buffer they write back are left untouched.
+
+// CHECK-LABEL: in_place
+// CHECK: scf.for
+// CHECK: air.channel.get
+// CHECK: air.execute
+// CHECK: air.channel.put
+// CHECK: scf.yield
+// CHECK-NOT: air.channel.put
+
+module {
+  air.channel @channel_a [1, 1]
+  air.channel @channel_c [1, 1]
+  func.func @in_place() {
+    %c1 = arith.constant 1 : index
+    %0 = air.herd @herd_0 async tile (%arg0, %arg1) in (%arg2=%c1, %arg3=%c1) {
+      %c0 = arith.constant 0 : index
+      %c1_0 = arith.constant 1 : index
+      %c8 = arith.constant 8 : index
+      %c2_i32 = arith.constant 2 : i32
+      %async_token, %results = air.execute -> (memref<32xi32, 2>) {
+        %alloc = memref.alloc() : memref<32xi32, 2>
+        air.execute_terminator %alloc : memref<32xi32, 2>
+      }
+      %1 = scf.for %arg4 = %c0 to %c8 step %c1_0 iter_args(%arg5 = %async_token) -> (!air.async.token) {
+        %3 = air.channel.get async [%arg5] @channel_a[] (%results[] [] []) : (memref<32xi32, 2>)
+        %async_token_5 = air.execute [%3] {
+          linalg.fill ins(%c2_i32 : i32) outs(%results : memref<32xi32, 2>)
+        }
+        %5 = air.channel.put async [%async_token_5] @channel_c[] (%results[] [] []) : (memref<32xi32, 2>)
+        scf.yield %5 : !air.async.token
+      }
+      air.herd_terminator
+    }
+    return
+  }
+}
+
+// -----
+
+// Loops where a stage 0 op waits for a stage 1 op of the same iteration are
+// left untouched: here the accumulator is cleared after it is written back.
+
+// CHECK-LABEL: stage_0_after_stage_1
+// CHECK: scf.for
+// CHECK: air.channel.get
+// CHECK: air.execute
+// CHECK: air.channel.put
+// CHECK: air.execute
+// CHECK: scf.yield
+// CHECK-NOT: air.channel.put
+
+module {
+  air.channel @channel_a [1, 1]
+  air.channel @channel_c [1, 1]
+  func.func @stage_0_after_stage_1() {
+    %c1 = arith.constant 1 : index
+    %0 = air.herd @herd_0 async tile (%arg0, %arg1) in (%arg2=%c1, %arg3=%c1) {
+      %c0 = arith.constant 0 : index
+      %c1_0 = arith.constant 1 : index
+      %c8 = arith.constant 8 : index
+      %c0_i32 = arith.constant 0 : i32
+      %async_token, %results = air.execute -> (memref<32xi32, 2>) {
+        %alloc = memref.alloc() : memref<32xi32, 2>
+        air.execute_terminator %alloc : memref<32xi32, 2>
+      }
+      %async_token_1, %results_2 = air.execute -> (memref<32xi32, 2>) {
+        %alloc = memref.alloc() : memref<32xi32, 2>
+        air.execute_terminator %alloc : memref<32xi32, 2>
+      }
+      %1 = air.wait_all async [%async_token, %async_token_1]
+      %2 = scf.for %arg4 = %c0 to %c8 step %c1_0 iter_args(%arg5 = %1) -> (!air.async.token) {
+        %3 = air.channel.get async [%arg5] @channel_a[] (%results[] [] []) : (memref<32xi32, 2>)
+        %async_token_5 = air.execute [%3] {
+          linalg.add ins(%results, %results_2 : memref<32xi32, 2>, memref<32xi32, 2>) outs(%results_2 : memref<32xi32, 2>)
+        }
+        %5 = air.channel.put async [%async_token_5] @channel_c[] (%results_2[] [] []) : (memref<32xi32, 2>)
+        %async_token_6 = air.execute [%5] {
+          linalg.fill ins(%c0_i32 : i32) outs(%results_2 : memref<32xi32, 2>)
+        }
+        scf.yield %async_token_6 : !air.async.token
+      }
+      air.herd_terminator
+    }
+    return
+  }
+}
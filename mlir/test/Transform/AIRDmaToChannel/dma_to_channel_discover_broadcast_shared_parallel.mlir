@@ -0,0 +1,58 @@
+//===- dma_to_channel_discover_broadcast_shared_parallel.mlir --*- MLIR -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// RUN: air-opt %s -air-dma-to-channel="discover-broadcast" | FileCheck %s
+
+// The put on @channel_0 reads the same tile for every %arg3, but shares its
+// scf.parallel with a get on @channel_1 which still runs in every iteration.
+// The parallel keeps its bounds, and the put is broadcast from a parallel of
+// its own whose token is joined with the original one.
+
+// CHECK: air.channel @channel_0 [2, 1] {broadcast_shape = [2, 2]}
+// CHECK: air.channel @channel_1 [2, 2]
+// CHECK-NOT: broadcast_shape
+// CHECK-LABEL: func.func @put_and_get
+// CHECK: %[[C2:.*]] = arith.constant 2 : index
+// CHECK: %[[PAR0:.*]] = scf.parallel (%{{.*}}, %{{.*}}) = (%{{.*}}, %{{.*}}) to (%[[C2]], %[[C2]])
+// CHECK-NOT: @channel_0
+// CHECK: air.channel.get async{{.*}}@channel_1[%{{.*}}, %{{.*}}]
+// CHECK: scf.reduce
+// CHECK: %[[C1:.*]] = arith.constant 1 : index
+// CHECK: %[[PAR1:.*]] = scf.parallel (%{{.*}}, %{{.*}}) = (%{{.*}}, %[[C0:.*]]) to (%[[C2]], %[[C1]])
+// CHECK-NOT: @channel_1
+// CHECK: air.channel.put async{{.*}}@channel_0[%{{.*}}, %[[C0]]]
+// CHECK: scf.reduce
+// CHECK: %[[JOIN:.*]] = air.wait_all async [%[[PAR0]], %[[PAR1]]]
+// CHECK: air.wait_all [%[[JOIN]]]
+
+#map = affine_map<()[s0] -> (s0 * 32)>
+module {
+  air.channel @channel_0 [2, 2]
+  air.channel @channel_1 [2, 2]
+  func.func @put_and_get(%arg0: memref<64x64xi32>, %arg1: memref<64x64xi32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c2 = arith.constant 2 : index
+    %c32 = arith.constant 32 : index
+    %c64 = arith.constant 64 : index
+    %0 = air.wait_all async
+    %1 = scf.parallel (%arg2, %arg3) = (%c0, %c0) to (%c2, %c2) step (%c1, %c1) init (%0) -> !air.async.token {
+      %2 = affine.apply #map()[%arg2]
+      %3 = air.channel.put async [%0]  @channel_0[%arg2, %arg3] (%arg0[%2, %c0] [%c32, %c64] [%c64, %c1]) {id = 1 : i32} : (memref<64x64xi32>)
+      %4 = affine.apply #map()[%arg3]
+      %5 = air.channel.get async [%0]  @channel_1[%arg2, %arg3] (%arg1[%2, %4] [%c32, %c32] [%c64, %c1]) {id = 2 : i32} : (memref<64x64xi32>)
+      %6 = air.wait_all async [%3, %5]
+      scf.reduce(%6 : !air.async.token) {
+      ^bb0(%arg4: !air.async.token, %arg5: !air.async.token):
+        %7 = air.wait_all async [%arg4, %arg5]
+        scf.reduce.return %7 : !air.async.token
+      }
+    }
+    air.wait_all [%1]
+    return
+  }
+}
@@ -164,7 +164,9 @@ class LinalgOnTensorsAirBackend(AirBackend):
                 print("AIR Module:")
                 print(air_module)
 
+            # the refback module read back below is only kept with --tmpdir
             aircc_options = ["torch.mlir", "--shared", "-o", "torch.mlir.so"]
+            aircc_options = aircc_options + ["--tmpdir", "air_project"]
             aircc_options = aircc_options + [
                 f"-row-offset={segment_offset[1]}",
                 f"-col-offset={segment_offset[0]}",
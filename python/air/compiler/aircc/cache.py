@@ -0,0 +1,89 @@
+# ./python/air/compiler/aircc/cache.py -*- Python -*-
+#
+# Copyright (C) 2024, Advanced Micro Devices, Inc.
+# SPDX-License-Identifier: MIT
+
+"""
+Content-addressed artifact cache for aircc.
+
+Artifacts are keyed by a sha256 digest over the compiler input text, the
+options used to compile it and the versions of the tools involved. Each key
+maps to a directory under the cache root holding the produced files. Entries
+are published by renaming a fully populated staging directory, so concurrent
+aircc invocations sharing a cache never observe a partial entry.
+"""
+
+import hashlib
+import os
+import shutil
+import tempfile
+
+
+class ArtifactCache:
+    MANIFEST = "MANIFEST"
+
+    def __init__(self, cache_dir, verbose=False):
+        self.cache_dir = cache_dir
+        self.verbose = verbose
+        self.hits = 0
+        self.misses = 0
+        self.stores = 0
+        os.makedirs(cache_dir, exist_ok=True)
+
+    @staticmethod
+    def make_key(*parts):
+        h = hashlib.sha256()
+        for p in parts:
+            if isinstance(p, str):
+                p = p.encode("utf-8")
+            # length-prefix each part so that ("ab", "c") != ("a", "bc")
+            h.update(str(len(p)).encode("utf-8") + b":")
+            h.update(p)
+        return h.hexdigest()
+
+    def _entry_dir(self, key):
+        return os.path.join(self.cache_dir, key[:2], key)
+
+    def lookup(self, key):
+        """Return a dict of artifact name -> cached path for `key`, or None."""
+        entry = self._entry_dir(key)
+        manifest = os.path.join(entry, self.MANIFEST)
+        if not os.path.isfile(manifest):
+            self.misses = self.misses + 1
+            if self.verbose:
+                print("aircc cache miss:", key)
+            return None
+        with open(manifest, "r") as f:
+            names = f.read().split()
+        self.hits = self.hits + 1
+        if self.verbose:
+            print("aircc cache hit:", key)
+        return {name: os.path.join(entry, name) for name in names}
+
+    def store(self, key, files):
+        """Publish the files in `files` (artifact name -> source path)."""
+        entry = self._entry_dir(key)
+        if os.path.isdir(entry):
+            return
+        os.makedirs(os.path.dirname(entry), exist_ok=True)
+        staging = tempfile.mkdtemp(dir=os.path.dirname(entry))
+        try:
+            for name, src in files.items():
+                shutil.copyfile(src, os.path.join(staging, name))
+            with open(os.path.join(staging, self.MANIFEST), "w") as f:
+                f.write("\n".join(sorted(files)))
+            os.rename(staging, entry)
+            self.stores = self.stores + 1
+        except OSError:
+            # another aircc published the same entry first
+            shutil.rmtree(staging, ignore_errors=True)
+
+    def report(self):
+        total = self.hits + self.misses
+        rate = (100.0 * self.hits / total) if total else 0.0
+        return "aircc cache: %d hits, %d misses (%.1f%% hit rate), %d stored" % (
+            self.hits,
+            self.misses,
+            rate,
+            self.stores,
+        )
@@ -5,6 +5,7 @@
 # SPDX-License-Identifier: MIT
 
 import argparse
+import os
 import sys
 
 from air.compiler.aircc.configure import *
@@ -30,8 +31,22 @@ def parse_args(args=None):
     parser.add_argument(
         "--tmpdir",
         metavar="tmpdir",
-        default="air_project",
-        help="directory used for temporary file storage",
+        default=None,
+        help="directory used for temporary file storage (default: air_project). Intermediate IR is only kept when this is given",
+    )
+    parser.add_argument(
+        "--cache-dir",
+        metavar="cache_dir",
+        dest="cache_dir",
+        default=os.environ.get("AIRCC_CACHE_DIR", ""),
+        help="directory used to cache compiled segment artifacts across runs (default: $AIRCC_CACHE_DIR, caching is disabled when empty)",
+    )
+    parser.add_argument(
+        "--timing",
+        dest="timing",
+        default=False,
+        action="store_true",
+        help="Report MLIR pass timing (as -mlir-timing) and a per-stage wall-clock breakdown",
     )
     parser.add_argument(
         "-v",
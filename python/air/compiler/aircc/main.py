@@ -8,18 +8,22 @@
 aircc - AIR compiler driver for MLIR tools
 """
 
+import contextlib
+import glob
 import os
 import platform
 import sys
 import subprocess
+import time
 from joblib import Parallel, delayed
 import shutil
 
 from air.passmanager import PassManager
-from air.ir import Module, Context, Location
+from air.ir import Module, Context, InsertionPoint, Location
 from air.dialects import air as airdialect
 
 import air.compiler.aircc.cl_arguments as cl_arguments
+from air.compiler.aircc.cache import ArtifactCache
 from air.compiler.aircc.configure import *
 
 import aie.compiler.aiecc.main as aiecc
@@ -95,6 +99,28 @@ extern "C" {
     return s
 
 
+_stage_times = []
+
+
+@contextlib.contextmanager
+def timed_stage(name):
+    # Times one pipeline or tool chain as a single entry of the report
+    start = time.perf_counter()
+    yield
+    _stage_times.append((name, time.perf_counter() - start))
+
+
+def report_stage_times():
+    total = sum(t for _, t in _stage_times)
+    print("===" + "-" * 70 + "===")
+    print("  aircc stage timing report")
+    print("===" + "-" * 70 + "===")
+    for name, t in _stage_times:
+        pct = (100.0 * t / total) if total else 0.0
+        print("  %10.4fs (%5.1f%%)  %s" % (t, pct, name))
+    print("  %10.4fs (100.0%%)  Total" % total)
+
+
 def do_call(command):
     global opts
     if opts.verbose:
@@ -115,46 +141,111 @@ def do_run(command):
     return ret
 
 
-def run_passes(pass_pipeline, mlir_module, opts, outputfile=None):
+_tool_versions = {}
+
+
+def tool_version(tool):
+    # Version strings feed the cache keys, so that upgrading a tool
+    # invalidates everything it produced.
+    if tool not in _tool_versions:
+        try:
+            t = subprocess.run(
+                [tool, "--version"],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.STDOUT,
+                universal_newlines=True,
+            )
+            _tool_versions[tool] = t.stdout
+        except OSError:
+            _tool_versions[tool] = ""
+    return _tool_versions[tool]
+
+
+def aiecc_version():
+    # aiecc.py does not report a version; use the identity of the installed
+    # driver and the aie-opt it drives instead.
+    path = os.path.realpath(aiecc.__file__)
+    return path + ":" + str(os.path.getmtime(path)) + tool_version("aie-opt")
+
+
+def run_passes(pass_pipeline, mlir_module, opts, outputfile=None, stage=None):
     if opts.verbose:
         print("Running:", pass_pipeline)
-    PassManager.parse(pass_pipeline).run(mlir_module.operation)
+    pm = PassManager.parse(pass_pipeline)
+    if opts.timing:
+        # same report as air-opt -mlir-timing, printed when pm is destroyed
+        if hasattr(pm, "enable_timing"):
+            pm.enable_timing()
+        elif not getattr(opts, "warned_timing", False):
+            print("MLIR pass timing is not available, reporting stages only")
+            opts.warned_timing = True
+    with timed_stage(stage if stage else pass_pipeline):
+        pm.run(mlir_module.operation)
+    del pm
     if outputfile:
-        with open(outputfile, "w") as g:
-            g.write(str(mlir_module))
+        write_module(mlir_module, outputfile)
 
 
-def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filename):
-    pass_pipeline = "air-split-devices{"
-    pass_pipeline = pass_pipeline + f"output-prefix={opts.tmpdir}/" + "}"
-    run_passes("builtin.module(" + pass_pipeline + ")", air_to_aie_module, opts)
+def write_module(mlir_module, outputfile):
+    with open(outputfile, "w") as g:
+        g.write(str(mlir_module))
 
-    # lower the airrt control program to llvm dialect
 
-    airrt_module = Module.parse(str(air_to_aie_module))
-    aie_ctrl_airrt = opts.tmpdir + "/airrt." + air_mlir_filename
-    pass_pipeline = ",".join(
-        [
-            "convert-vector-to-llvm",
-            "convert-math-to-llvm",
-            "func.func(air-label-broadcast-channel-with-tile)",
-            "lower-affine",
-            "func.func(air-opt-shim-dma-bds{device=" + opts.device + "})",
-            "air-to-std",
-            "air-lower-linalg-tensors",
-            "canonicalize",
-            "cse",
-        ]
+def dump_file(name):
+    # Intermediate IR that no later stage reads back is only written when
+    # --tmpdir was given explicitly for debugging.
+    return name if opts.dump_intermediates else None
+
+
+def clone_module(mlir_module):
+    # Copy the IR in memory rather than printing and re-parsing it.
+    with mlir_module.context, Location.unknown():
+        module = Module.create()
+        for attr in mlir_module.operation.attributes:
+            module.operation.attributes[attr.name] = attr.attr
+        with InsertionPoint(module.body):
+            for op in mlir_module.body.operations:
+                op.clone()
+    return module
+
+
+def compile_ctrl_obj(aie_ctrl_llvm, air_mlir_filename, llc_target, aie_ctrl_obj):
+    aie_ctrl_llvm_ir = opts.tmpdir + "/" + air_mlir_filename + ".ll"
+    do_call(
+        ["aie-translate", "--mlir-to-llvmir", aie_ctrl_llvm, "-o", aie_ctrl_llvm_ir]
     )
+
+    aie_ctrl_llvm_opt_bc = opts.tmpdir + "/" + air_mlir_filename + ".opt.bc"
+    do_call(["opt", "-O3", aie_ctrl_llvm_ir, "-o", aie_ctrl_llvm_opt_bc])
+
+    if opts.dump_intermediates:
+        aie_ctrl_llvm_opt_ir = opts.tmpdir + "/" + air_mlir_filename + ".opt.ll"
+        do_call(["llvm-dis", aie_ctrl_llvm_opt_bc, "-o", aie_ctrl_llvm_opt_ir])
+
+    # llc reads the optimized bitcode directly
+    do_call(
+        ["llc", "-O3", "--filetype=obj", "--relocation-model=pic"]
+        + (["-march=" + llc_target] if llc_target else [])
+        + [aie_ctrl_llvm_opt_bc, "-o", aie_ctrl_obj]
+    )
+
+
+def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filename):
+    cache = ArtifactCache(opts.cache_dir, opts.verbose) if opts.cache_dir else None
+
+    pass_pipeline = "air-split-devices{"
+    pass_pipeline = pass_pipeline + f"output-prefix={opts.tmpdir}/" + "}"
     run_passes(
-        "builtin.module(" + pass_pipeline + ")", airrt_module, opts, aie_ctrl_airrt
+        "builtin.module(" + pass_pipeline + ")",
+        air_to_aie_module,
+        opts,
+        stage="air-split-devices",
     )
 
-    aie_ctrl = opts.tmpdir + "/aie_ctrl." + air_mlir_filename
-    pass_pipeline = ",".join(["airrt-to-llvm", "one-shot-bufferize"])
-    run_passes("builtin.module(" + pass_pipeline + ")", airrt_module, opts, aie_ctrl)
+    # lower the airrt control program to llvm dialect
 
-    aie_ctrl_refback = opts.tmpdir + "/refback." + air_mlir_filename
+    airrt_module = clone_module(air_to_aie_module)
+    aie_ctrl_airrt = opts.tmpdir + "/airrt." + air_mlir_filename
     pass_pipeline = ",".join(
         [
             "convert-vector-to-llvm",
@@ -166,49 +257,82 @@ def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filena
             "air-lower-linalg-tensors",
             "canonicalize",
             "cse",
-            "airrt-to-llvm",
-            "canonicalize",
-            "cse",
         ]
     )
     run_passes(
         "builtin.module(" + pass_pipeline + ")",
-        Module.parse(str(air_placed_module)),
+        airrt_module,
         opts,
-        aie_ctrl_refback,
+        aie_ctrl_airrt,
+        stage="air-to-std",
     )
 
+    if opts.dump_intermediates:
+        aie_ctrl_refback = opts.tmpdir + "/refback." + air_mlir_filename
+        pass_pipeline = ",".join(
+            [
+                "convert-vector-to-llvm",
+                "convert-math-to-llvm",
+                "func.func(air-label-broadcast-channel-with-tile)",
+                "lower-affine",
+                "func.func(air-opt-shim-dma-bds{device=" + opts.device + "})",
+                "air-to-std",
+                "air-lower-linalg-tensors",
+                "canonicalize",
+                "cse",
+                "airrt-to-llvm",
+                "canonicalize",
+                "cse",
+            ]
+        )
+        run_passes(
+            "builtin.module(" + pass_pipeline + ")",
+            clone_module(air_placed_module),
+            opts,
+            aie_ctrl_refback,
+            stage="refback",
+        )
+
+    aie_ctrl_passes = ["airrt-to-llvm", "one-shot-bufferize"]
+    aie_ctrl_llvm_passes = [
+        "expand-strided-metadata",
+        "lower-affine",
+        "convert-scf-to-cf",
+        "finalize-memref-to-llvm",
+        "convert-func-to-llvm",
+        "convert-arith-to-llvm",
+        "convert-cf-to-llvm",
+        "canonicalize",
+        "cse",
+    ]
     aie_ctrl_llvm = opts.tmpdir + "/llvm." + air_mlir_filename
-    pass_pipeline = ",".join(
-        [
-            "expand-strided-metadata",
-            "lower-affine",
-            "convert-scf-to-cf",
-            "finalize-memref-to-llvm",
-            "convert-func-to-llvm",
-            "convert-arith-to-llvm",
-            "convert-cf-to-llvm",
-            "canonicalize",
-            "cse",
-        ]
-    )
-    run_passes(
-        "builtin.module(" + pass_pipeline + ")", airrt_module, opts, aie_ctrl_llvm
-    )
+    if opts.dump_intermediates:
+        aie_ctrl = opts.tmpdir + "/aie_ctrl." + air_mlir_filename
+        run_passes(
+            "builtin.module(" + ",".join(aie_ctrl_passes) + ")",
+            airrt_module,
+            opts,
+            aie_ctrl,
+            stage="airrt-to-llvm",
+        )
+        run_passes(
+            "builtin.module(" + ",".join(aie_ctrl_llvm_passes) + ")",
+            airrt_module,
+            opts,
+            aie_ctrl_llvm,
+            stage="convert-to-llvm",
+        )
+    else:
+        run_passes(
+            "builtin.module(" + ",".join(aie_ctrl_passes + aie_ctrl_llvm_passes) + ")",
+            airrt_module,
+            opts,
+            aie_ctrl_llvm,
+            stage="airrt-to-llvm",
+        )
 
     # compile the llvm dialect into a .o object file
 
-    aie_ctrl_llvm_ir = opts.tmpdir + "/" + air_mlir_filename + ".ll"
-    do_call(
-        ["aie-translate", "--mlir-to-llvmir", aie_ctrl_llvm, "-o", aie_ctrl_llvm_ir]
-    )
-
-    aie_ctrl_llvm_opt_bc = opts.tmpdir + "/" + air_mlir_filename + ".opt.bc"
-    do_call(["opt", "-O3", aie_ctrl_llvm_ir, "-o", aie_ctrl_llvm_opt_bc])
-
-    aie_ctrl_llvm_opt_ir = opts.tmpdir + "/" + air_mlir_filename + ".opt.ll"
-    do_call(["llvm-dis", aie_ctrl_llvm_opt_bc, "-o", aie_ctrl_llvm_opt_ir])
-
     aie_ctrl_obj = opts.tmpdir + "/" + air_mlir_filename + ".o"
     llc_target = None
     if "x86_64" in opts.host_target:
@@ -217,11 +341,28 @@ def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filena
         llc_target = "aarch64"
     elif opts.host_target:
         print("Unhandled llc host target: '" + opts.host_target + "'")
-    do_call(
-        ["llc", "-O3", "--filetype=obj", "--relocation-model=pic"]
-        + (["-march=" + llc_target] if llc_target else [])
-        + [aie_ctrl_llvm_opt_ir, "-o", aie_ctrl_obj]
-    )
+
+    cached = None
+    if cache:
+        with open(aie_ctrl_llvm, "r") as f:
+            ctrl_key = ArtifactCache.make_key(
+                "ctrl",
+                f.read(),
+                str(llc_target),
+                tool_version("aie-translate"),
+                tool_version("opt"),
+                tool_version("llc"),
+            )
+        cached = cache.lookup(ctrl_key)
+    if cached:
+        shutil.copyfile(cached["ctrl.o"], aie_ctrl_obj)
+    else:
+        with timed_stage("opt/llc"):
+            compile_ctrl_obj(
+                aie_ctrl_llvm, air_mlir_filename, llc_target, aie_ctrl_obj
+            )
+        if cache:
+            cache.store(ctrl_key, {"ctrl.o": aie_ctrl_obj})
 
     # make aie elf files and host .o files for each herd in the program
 
@@ -240,17 +381,17 @@ def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filena
         aiecc_file = opts.tmpdir + "/aiecc." + segment + ".mlir"
         aiecc_dir = opts.tmpdir + "/" + segment
 
-        do_call(
-            [
-                "air-opt",
-                segment_file,
-                "-air-lower-linalg-tensors",
-                "-lower-affine",
-                "-canonicalize",
-                "-cse",
-                "-o",
-                aiecc_file,
-            ]
+        with open(segment_file, "r") as f:
+            segment_module = Module.parse(f.read())
+        pass_pipeline = ",".join(
+            ["air-lower-linalg-tensors", "lower-affine", "canonicalize", "cse"]
+        )
+        run_passes(
+            "builtin.module(" + pass_pipeline + ")",
+            segment_module,
+            opts,
+            aiecc_file,
+            stage="segment " + segment,
         )
 
         # set host target for aiecc
@@ -260,30 +401,22 @@ def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filena
             aiecc_target = "aarch64-linux-gnu"
         aiecc_target = opts.host_target if opts.host_target else aiecc_target
 
-        # run aiecc to make the elf and configuration files
         sysroot = opts.sysroot if opts.sysroot else "/"
-        do_call(
-            ["aiecc.py"]
-            + (["-v"] if opts.verbose else [])
-            + ["--sysroot", sysroot]
+        aiecc_options = (
+            ["--sysroot", sysroot]
             + ["--host-target", aiecc_target]
-            + ["--tmpdir", aiecc_dir]
             + ["--no-aiesim"]
             + ["--xbridge" if opts.xbridge else "--no-xbridge"]
             + ["--xchesscc" if opts.xchesscc else "--no-xchesscc"]
-            + [aiecc_file]
         )
 
         inc_file = opts.tmpdir + "/" + air_mlir_filename + "." + segment + ".inc"
         cpp_file = opts.tmpdir + "/" + air_mlir_filename + "." + segment + ".cpp"
         obj_file = opts.tmpdir + "/" + air_mlir_filename + "." + segment + ".o"
 
-        # compile the libxaie configuration functions generated by aie-translate
-
-        do_call(["cp", aiecc_dir + "/aie_inc.cpp", inc_file])
-
+        wrapper = emit_wrapper(segment, inc_file)
         with open(cpp_file, "w") as f:
-            f.write(emit_wrapper(segment, inc_file))
+            f.write(wrapper)
 
         cmd = [opts.cc, "-std=c++11", "-g", "-I."]
 
@@ -308,8 +441,54 @@ def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filena
         cmd += [f"-I{rocm_path}/../../../include"]
         cmd += ["-DLIBXAIENGINEV2"]
         cmd += ["-DAIE_LIBXAIE_ENABLE", "-fPIC", "-c"]
-        cmd += ["-o", obj_file, cpp_file]
-        do_call(cmd)
+
+        # the printed aiecc input fully determines the elf files, aie_inc.cpp
+        # and the compiled wrapper, given the same options and tools
+        cached = None
+        if cache:
+            with open(aiecc_file, "r") as f:
+                segment_key = ArtifactCache.make_key(
+                    "segment",
+                    f.read(),
+                    " ".join(aiecc_options),
+                    " ".join(cmd),
+                    wrapper,
+                    aiecc_version(),
+                    tool_version(opts.cc),
+                )
+            cached = cache.lookup(segment_key)
+
+        if cached:
+            os.makedirs(aiecc_dir, exist_ok=True)
+            for name, path in cached.items():
+                if name == "segment.o":
+                    shutil.copyfile(path, obj_file)
+                else:
+                    shutil.copyfile(path, aiecc_dir + "/" + name)
+            shutil.copyfile(aiecc_dir + "/aie_inc.cpp", inc_file)
+        else:
+            # run aiecc to make the elf and configuration files
+            with timed_stage("aiecc " + segment):
+                do_call(
+                    ["aiecc.py"]
+                    + (["-v"] if opts.verbose else [])
+                    + aiecc_options
+                    + ["--tmpdir", aiecc_dir]
+                    + [aiecc_file]
+                )
+
+            # compile the libxaie configuration functions generated by aie-translate
+
+            do_call(["cp", aiecc_dir + "/aie_inc.cpp", inc_file])
+            with timed_stage("host compile " + segment):
+                do_call(cmd + ["-o", obj_file, cpp_file])
+
+            if cache:
+                artifacts = {"aie_inc.cpp": aiecc_dir + "/aie_inc.cpp"}
+                for elf in glob.glob(aiecc_dir + "/*.elf"):
+                    artifacts[os.path.basename(elf)] = elf
+                artifacts["segment.o"] = obj_file
+                cache.store(segment_key, artifacts)
 
         obj_files.append(obj_file)
 
@@ -324,11 +503,17 @@ def lower_airrt_to_airhost(air_to_aie_module, air_placed_module, air_mlir_filena
         cmd += ["-fuse-ld=lld", "-o", lib_file] + obj_files
     else:
         cmd = ["llvm-ar", "rc", lib_file] + obj_files
-    do_call(cmd)
+    with timed_stage("link"):
+        do_call(cmd)
 
     if opts.output_file:
         do_call(["cp", lib_file, opts.output_file])
 
+    if cache:
+        print(cache.report())
+    if opts.timing:
+        report_stage_times()
+
 
 def run(mlir_module, args=None):
     global opts
@@ -336,6 +521,11 @@ def run(mlir_module, args=None):
     if args is not None:
         opts = cl_arguments.parse_args(args)
 
+    # Intermediate files are only kept when a tmpdir was asked for
+    opts.dump_intermediates = opts.tmpdir is not None
+    if not opts.tmpdir:
+        opts.tmpdir = "air_project"
+
     if opts.tmpdir:
         tmpdirname = opts.tmpdir
         try:
@@ -401,9 +591,13 @@ def run(mlir_module, args=None):
                 air_place_pass,
             ]
         )
-        air_placed_module = Module.parse(str(mlir_module))
+        air_placed_module = clone_module(mlir_module)
         run_passes(
-            "builtin.module(" + pass_pipeline + ")", air_placed_module, opts, air_placed
+            "builtin.module(" + pass_pipeline + ")",
+            air_placed_module,
+            opts,
+            dump_file(air_placed),
+            stage="air-place-herds",
         )
 
         air_to_aie_pass = "air-to-aie{"
@@ -420,12 +614,13 @@ def run(mlir_module, args=None):
         pass_pipeline = ",".join([air_to_aie_pass])
 
         air_to_aie_file = opts.tmpdir + "/aie." + air_mlir_filename
-        air_to_aie_module = Module.parse(str(air_placed_module))
+        air_to_aie_module = clone_module(air_placed_module)
         run_passes(
             "builtin.module(" + pass_pipeline + ")",
             air_to_aie_module,
             opts,
-            air_to_aie_file,
+            dump_file(air_to_aie_file),
+            stage="air-to-aie",
         )
 
         if "npu" in opts.device:
@@ -436,7 +631,7 @@ def run(mlir_module, args=None):
             )
 
             air_to_npu_file = opts.tmpdir + "/npu." + air_mlir_filename
-            air_to_npu_module = Module.parse(str(air_to_aie_module))
+            air_to_npu_module = clone_module(air_to_aie_module)
             air_to_npu_passes = (
                 "builtin.module("
                 + ",".join(
@@ -456,7 +651,13 @@ def run(mlir_module, args=None):
                 )
                 + ")"
             )
-            run_passes(air_to_npu_passes, air_to_npu_module, opts, air_to_npu_file)
+            run_passes(
+                air_to_npu_passes,
+                air_to_npu_module,
+                opts,
+                air_to_npu_file,
+                stage="airrt-to-npu",
+            )
             xclbin_file = "aie.xclbin"
             if opts.output_file:
                 xclbin_file = opts.output_file
@@ -476,7 +677,10 @@ def run(mlir_module, args=None):
                 "--npu-insts-name=" + insts_file,
                 air_to_npu_file,
             ]
-            aiecc.run(air_to_npu_module, aiecc_options)
+            with timed_stage("aiecc"):
+                aiecc.run(air_to_npu_module, aiecc_options)
+            if opts.timing:
+                report_stage_times()
         else:
             lower_airrt_to_airhost(
                 air_to_aie_module, air_placed_module, air_mlir_filename
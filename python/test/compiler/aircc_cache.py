@@ -0,0 +1,50 @@
+# ./python/test/compiler/aircc_cache.py -*- Python -*-
+
+# Copyright (C) 2024, Advanced Micro Devices, Inc.
+# SPDX-License-Identifier: MIT
+
+# RUN: %PYTHON %s | FileCheck %s
+import os
+import tempfile
+
+from air.compiler.aircc.cache import ArtifactCache
+
+
+def run(f):
+    print("\nTEST:", f.__name__)
+    f()
+    return f
+
+
+# CHECK-LABEL: TEST: cache_roundtrip
+# CHECK: miss: True
+# CHECK: hit: core_7_2.elf,segment.o
+# CHECK: content: elf
+# CHECK: aircc cache: 1 hits, 1 misses (50.0% hit rate), 1 stored
+@run
+def cache_roundtrip():
+    with tempfile.TemporaryDirectory() as d:
+        cache = ArtifactCache(os.path.join(d, "cache"))
+        key = ArtifactCache.make_key("segment", "aie.device(xcvc1902) {}")
+        print("miss:", cache.lookup(key) is None)
+        elf = os.path.join(d, "core_7_2.elf")
+        obj = os.path.join(d, "segment.o")
+        for path, data in [(elf, "elf"), (obj, "obj")]:
+            with open(path, "w") as f:
+                f.write(data)
+        cache.store(key, {"core_7_2.elf": elf, "segment.o": obj})
+        cached = cache.lookup(key)
+        print("hit:", ",".join(sorted(cached)))
+        with open(cached["core_7_2.elf"]) as f:
+            print("content:", f.read())
+        print(cache.report())
+
+
+# CHECK-LABEL: TEST: key_is_length_prefixed
+# CHECK: distinct: True
+@run
+def key_is_length_prefixed():
+    print(
+        "distinct:",
+        ArtifactCache.make_key("ab", "c") != ArtifactCache.make_key("a", "bc"),
+    )
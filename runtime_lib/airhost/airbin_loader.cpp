@@ -0,0 +1,410 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#include "airbin_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ALIGN(_x, _size) (((_x) + ((_size)-1)) & ~((_size)-1))
+
+namespace air {
+
+namespace {
+
+// Sections and tables are kept aligned to the size of a table entry
+constexpr size_t kAlignment = sizeof(airbin_table_entry);
+
+// Layout of the portable AIRBIN. The file header is followed by fixed size
+// text fields, and each configuration header by eight 32-bit hex words.
+constexpr size_t kPortableHeaderSize = 32;
+constexpr size_t kPortableWordSize = 9; // 8 hex digits and a newline
+constexpr size_t kPortableConfigHeaderSize = 8 * kPortableWordSize;
+constexpr uint32_t kPortableDataMem = 11;
+// The configuration headers of a column start with the shim tile, followed by
+// a fixed number of headers for each core tile
+constexpr uint32_t kPortableShimHeaders = 6;
+constexpr uint32_t kPortableTileHeaders = 8;
+constexpr uint32_t kTileRowShift = 18;
+
+double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int HexDigit(uint8_t c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+bool ParseHex(const uint8_t *p, size_t len, uint64_t &value) {
+  value = 0;
+  for (size_t i = 0; i < len; i++) {
+    int d = HexDigit(p[i]);
+    if (d < 0)
+      return false;
+    value = (value << 4) | d;
+  }
+  return true;
+}
+
+const char *PortableSectionName(uint64_t name) {
+  static const char *names[] = {
+      "",         ".ssmast",   ".ssslve",   ".sspckt",
+      ".sdma.bd", ".shmmux",   ".sdma.ctl", ".prgm.mem",
+      ".tdma.bd", ".tdma.ctl", ".data.stk", ".data.mem"};
+  return name < sizeof(names) / sizeof(names[0]) ? names[name] : "";
+}
+
+} // namespace
+
+AirbinImage::~AirbinImage() { Close(); }
+
+bool AirbinImage::Open(const char *filename) {
+  Close();
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    printf("Can't open %s\n", filename);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    printf("[ERROR] %s is empty\n", filename);
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    printf("[ERROR] Failed to map %s\n", filename);
+    return false;
+  }
+  // Sections are read front to back exactly once
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  base_ = (const uint8_t *)map;
+  size_ = st.st_size;
+
+  bool ok = false;
+  if (size_ >= SELFMAG && memcmp(base_, ELFMAG, SELFMAG) == 0)
+    ok = ParseElf();
+  else if (size_ >= 4 && memcmp(base_ + 1, "AIR", 3) == 0)
+    ok = ParsePortable();
+  else
+    printf("[ERROR] %s is not an AIRBIN\n", filename);
+
+  if (!ok)
+    Close();
+  return ok;
+}
+
+void AirbinImage::Close() {
+  if (base_)
+    munmap((void *)base_, size_);
+  base_ = nullptr;
+  size_ = 0;
+  sections_.clear();
+}
+
+bool AirbinImage::ParseElf() {
+  // Headers are copied out as the mapping gives no alignment guarantees
+  Elf64_Ehdr ehdr;
+  if (size_ < sizeof(ehdr)) {
+    printf("[ERROR] AIRBIN truncated in the ELF header\n");
+    return false;
+  }
+  memcpy(&ehdr, base_, sizeof(ehdr));
+
+  // Read data as 64-bit little endian
+  if ((ehdr.e_ident[EI_CLASS] != ELFCLASS64) ||
+      (ehdr.e_ident[EI_DATA] != ELFDATA2LSB) ||
+      (ehdr.e_shentsize != sizeof(Elf64_Shdr))) {
+    printf("unexpected ELF format\n");
+    return false;
+  }
+
+  if (ehdr.e_shoff == 0 || ehdr.e_shoff > size_ ||
+      size_ - ehdr.e_shoff < sizeof(Elf64_Shdr)) {
+    printf("[ERROR] AIRBIN has no section table\n");
+    return false;
+  }
+  auto get_shdr = [&](uint64_t ndx) {
+    Elf64_Shdr shdr;
+    memcpy(&shdr, base_ + ehdr.e_shoff + ndx * sizeof(shdr), sizeof(shdr));
+    return shdr;
+  };
+
+  // Large section counts and string table indices live in section 0
+  Elf64_Shdr shdr0 = get_shdr(0);
+  uint64_t shnum = ehdr.e_shnum ? ehdr.e_shnum : shdr0.sh_size;
+  uint32_t shstrndx = ehdr.e_shstrndx;
+  if (shstrndx == SHN_XINDEX)
+    shstrndx = shdr0.sh_link;
+
+  if (shnum > (size_ - ehdr.e_shoff) / sizeof(Elf64_Shdr)) {
+    printf("[ERROR] AIRBIN truncated in the section table\n");
+    return false;
+  }
+
+  const char *strtab = nullptr;
+  size_t strtab_size = 0;
+  if (shstrndx < shnum) {
+    Elf64_Shdr shdr = get_shdr(shstrndx);
+    if (shdr.sh_offset < size_) {
+      strtab = (const char *)base_ + shdr.sh_offset;
+      strtab_size = std::min<uint64_t>(shdr.sh_size, size_ - shdr.sh_offset);
+    }
+  }
+
+  for (uint64_t ndx = 0; ndx < shnum; ndx++) {
+    Elf64_Shdr shdr = get_shdr(ndx);
+
+    // for each loadable program header
+    if (shdr.sh_type != SHT_PROGBITS || !(shdr.sh_flags & SHF_ALLOC))
+      continue;
+
+    if (shdr.sh_offset > size_ || shdr.sh_size > size_ - shdr.sh_offset ||
+        shdr.sh_size > UINT32_MAX) {
+      printf("[ERROR] Section %lu is outside of the AIRBIN\n", ndx);
+      return false;
+    }
+
+    AirbinSection section;
+    if (strtab && shdr.sh_name < strtab_size)
+      section.name.assign(strtab + shdr.sh_name,
+                          strnlen(strtab + shdr.sh_name,
+                                  strtab_size - shdr.sh_name));
+    section.addr = shdr.sh_addr;
+    section.size = shdr.sh_size;
+    section.data = base_ + shdr.sh_offset;
+    section.data_size = shdr.sh_size;
+    sections_.push_back(section);
+  }
+
+  return true;
+}
+
+bool AirbinImage::ParsePortable() {
+  uint64_t num_ch, chcfg;
+  if (size_ < kPortableHeaderSize || !ParseHex(base_ + 22, 2, num_ch) ||
+      !ParseHex(base_ + 24, 8, chcfg)) {
+    printf("[ERROR] Invalid portable AIRBIN header\n");
+    return false;
+  }
+
+  for (uint32_t idx = 0; idx < num_ch; idx++) {
+    size_t hdr = chcfg + 1 + idx * kPortableConfigHeaderSize;
+    uint64_t words[8];
+    if (hdr + kPortableConfigHeaderSize > size_) {
+      printf("[ERROR] AIRBIN truncated in configuration header %u\n", idx);
+      return false;
+    }
+    for (int w = 0; w < 8; w++) {
+      if (!ParseHex(base_ + hdr + w * kPortableWordSize, 8, words[w])) {
+        printf("[ERROR] Invalid configuration header %u\n", idx);
+        return false;
+      }
+    }
+
+    // Headers with a zero type describe nothing to load
+    uint64_t name = words[0];
+    if (!words[1])
+      continue;
+
+    uint64_t offset = (words[4] << 32) | words[5];
+    uint64_t size = (words[6] << 32) | words[7];
+    if (offset >= size_ || size > UINT32_MAX) {
+      printf("[ERROR] Section %u is outside of the AIRBIN\n", idx);
+      return false;
+    }
+
+    uint32_t row = 0;
+    if (idx >= kPortableShimHeaders)
+      row = 1 + (idx - kPortableShimHeaders) / kPortableTileHeaders;
+
+    // Everything but the data memory starts with a description line
+    const uint8_t *data = base_ + offset;
+    const uint8_t *end = base_ + size_;
+    if (name != kPortableDataMem) {
+      const uint8_t *eol = (const uint8_t *)memchr(data, '\n', end - data);
+      data = eol ? eol + 1 : end;
+    }
+
+    AirbinSection section;
+    section.name = PortableSectionName(name);
+    section.addr = ((uint64_t)row << kTileRowShift) | (words[2] << 32) |
+                   words[3];
+    section.size = size;
+    section.data = data;
+    section.data_size =
+        std::min<size_t>(size / 4 * kPortableWordSize, end - data);
+    section.hex_encoded = true;
+    sections_.push_back(section);
+  }
+
+  return true;
+}
+
+AirbinLoader::AirbinLoader(const AirbinImage &image, size_t chunk_size)
+    : image_(image), chunk_size_(chunk_size) {
+  const std::vector<AirbinSection> &sections = image_.sections();
+
+  size_t batch_bytes = 0;
+  for (size_t i = 0; i < sections.size(); i++) {
+    if (batches_.empty() ||
+        (chunk_size_ != kSingleTable && batch_bytes >= chunk_size_)) {
+      Batch batch;
+      batch.first = i;
+      batches_.push_back(batch);
+      batch_bytes = 0;
+    }
+    batches_.back().count++;
+    batch_bytes += sections[i].size;
+  }
+
+  // Each batch is its own zero terminated table followed by its data, and
+  // table offsets are relative to the table
+  for (Batch &batch : batches_) {
+    batch.offset = staging_size_;
+    staging_size_ += (batch.count + 1) * sizeof(airbin_table_entry);
+    for (size_t i = batch.first; i < batch.first + batch.count; i++)
+      staging_size_ += ALIGN(sections[i].size, kAlignment);
+  }
+}
+
+void AirbinLoader::PollCompletions(AirbinLoadQueue *queue,
+                                   uint32_t &completed) {
+  uint32_t now_completed = queue->Completed();
+  if (now_completed == completed)
+    return;
+
+  double now = Now();
+  for (uint32_t b = completed; b < now_completed; b++) {
+    const Batch &batch = batches_[b];
+    for (size_t i = batch.first; i < batch.first + batch.count; i++)
+      timings_[i].config_sec = now - submit_time_[b];
+  }
+  completed = now_completed;
+}
+
+void AirbinLoader::CopySection(const AirbinSection &section, uint8_t *dst,
+                               AirbinLoadQueue *queue, uint32_t &completed) {
+  // A single table is only submitted once everything was copied, so there is
+  // nothing to poll for in between
+  size_t step = chunk_size_ == kSingleTable
+                    ? std::max<size_t>(section.data_size, 1)
+                    : chunk_size_;
+  if (!section.hex_encoded) {
+    for (size_t done = 0; done < section.data_size; done += step) {
+      size_t len = std::min(step, section.data_size - done);
+      memcpy(dst + done, section.data + done, len);
+      PollCompletions(queue, completed);
+    }
+    memset(dst + section.data_size, 0, section.size - section.data_size);
+    return;
+  }
+
+  // Decode one word per line. Words missing at the end of the file are zero.
+  const uint8_t *p = section.data;
+  const uint8_t *end = section.data + section.data_size;
+  uint32_t *words = (uint32_t *)dst;
+  size_t num_words = section.size / 4;
+  size_t chunk_words = std::max<size_t>(step / 4, 1);
+  for (size_t w = 0; w < num_words; w++) {
+    while (p < end && HexDigit(*p) < 0)
+      p++;
+    uint32_t value = 0;
+    for (int d; p < end && (d = HexDigit(*p)) >= 0; p++)
+      value = (value << 4) | d;
+    words[w] = value;
+    if ((w + 1) % chunk_words == 0)
+      PollCompletions(queue, completed);
+  }
+  memset(dst + num_words * 4, 0, section.size - num_words * 4);
+}
+
+bool AirbinLoader::Load(uint8_t *staging, AirbinLoadQueue *queue) {
+  const std::vector<AirbinSection> &sections = image_.sections();
+
+  timings_.assign(sections.size(), AirbinSectionTiming());
+  submit_time_.assign(batches_.size(), 0.0);
+  double start = Now();
+
+  bool ok = true;
+  uint32_t submitted = 0;
+  uint32_t completed = 0;
+  for (const Batch &batch : batches_) {
+    uint8_t *base = staging + batch.offset;
+    airbin_table_entry *table = (airbin_table_entry *)base;
+    uint32_t data_offset = (batch.count + 1) * sizeof(airbin_table_entry);
+
+    for (size_t k = 0; k < batch.count; k++) {
+      const AirbinSection &section = sections[batch.first + k];
+      AirbinSectionTiming &timing = timings_[batch.first + k];
+
+      double t = Now();
+      CopySection(section, base + data_offset, queue, completed);
+      timing.name = section.name;
+      timing.size = section.size;
+      timing.batch = submitted;
+      timing.copy_sec = Now() - t;
+
+      table[k].offset = data_offset;
+      table[k].size = section.size;
+      table[k].addr = section.addr;
+      data_offset += ALIGN(section.size, kAlignment);
+    }
+
+    // the last entry must be all 0's
+    table[batch.count].offset = 0;
+    table[batch.count].size = 0;
+    table[batch.count].addr = 0;
+
+    submit_time_[submitted] = Now();
+    if (!queue->Submit(table)) {
+      printf("[ERROR] Failed to submit AIRBIN table %u\n", submitted);
+      ok = false;
+      break;
+    }
+    submitted++;
+  }
+
+  // The staging buffer must outlive everything the device was handed
+  while (completed < submitted)
+    PollCompletions(queue, completed);
+
+  load_sec_ = Now() - start;
+  return ok;
+}
+
+void AirbinLoader::PrintTimings() const {
+  double total_copy = 0.0;
+  printf("%4s %-12s %10s %6s %12s %12s\n", "[Nr]", "Name", "Size", "Batch",
+         "Copy (us)", "Config (us)");
+  for (size_t i = 0; i < timings_.size(); i++) {
+    const AirbinSectionTiming &t = timings_[i];
+    printf("[%2lu] %-12s %10u %6u %12.2f %12.2f\n", i, t.name.c_str(), t.size,
+           t.batch, t.copy_sec * 1e6, t.config_sec * 1e6);
+    total_copy += t.copy_sec;
+  }
+  printf("airbin loading time: %0.8f sec (%0.8f sec copying, %u batches)\n",
+         load_sec_, total_copy, NumBatches());
+}
+
+} // namespace air
@@ -9,9 +9,12 @@
 #include "air.hpp"
 #include "air_host.h"
 #include "air_host_impl.h"
+#include "air_wait_all.h"
+#include "module_registry.h"
 #include "runtime.h"
 #include "test_library.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <dirent.h>
 #include <dlfcn.h>
@@ -19,12 +22,14 @@
 #include <fstream> // ifstream
 #include <iomanip> // setbase()
 #include <iostream>
+#include <mutex>
 #include <stdio.h>
 #include <string>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <unordered_set>
 #include <vector>
 
 #define XAIE_BASE_ADDR 0x20000000000
@@ -42,19 +47,42 @@
 
 #define BOUNCE_BUFFER_SIZE 0x8000
 
-// temporary solution to stash some state
 extern "C" {
 
-air_rt_herd_desc_t _air_host_active_herd = {nullptr, nullptr, nullptr};
-air_rt_segment_desc_t _air_host_active_segment = {nullptr, nullptr, nullptr};
 aie_libxaie_ctx_t *_air_host_active_libxaie = nullptr;
-uint32_t *_air_host_bram_ptr = nullptr;
-uint64_t _air_host_bram_paddr = 0;
-air_module_handle_t _air_host_active_module = (air_module_handle_t) nullptr;
 
 const char vck5000_driver_name[] = "/dev/amdair";
 }
 
+// Used by threads that never bound a context of their own
+static air_rt_context_t _air_host_default_context;
+static thread_local air_rt_context_t *_air_host_current_context = nullptr;
+
+// Guards the contexts, the module registry and the AIE array configuration.
+// Recursive since the registry unloads evicted modules from within the
+// module calls.
+static std::recursive_mutex _air_host_mutex;
+static std::unordered_set<air_rt_context_t *> _air_host_contexts = {
+    &_air_host_default_context};
+// The module whose segment the AIE array was last configured with
+static air_module_handle_t _air_host_configured_module = 0;
+
+static int32_t air_module_release(air_module_handle_t handle);
+
+namespace {
+
+class HostModuleRegistryBackend : public air::rocm::ModuleRegistryBackend {
+public:
+  void Unload(uint64_t handle) override {
+    air_module_release((air_module_handle_t)handle);
+  }
+};
+
+HostModuleRegistryBackend module_registry_backend;
+air::rocm::ModuleRegistry module_registry(&module_registry_backend);
+
+} // namespace
+
 // Determining if an hsa agent is an AIE agent or not
 hsa_status_t find_aie(hsa_agent_t agent, void *data) {
   hsa_status_t status(HSA_STATUS_SUCCESS);
@@ -105,12 +133,26 @@ hsa_status_t air_shut_down() {
   if (!_air_host_active_libxaie)
     return HSA_STATUS_ERROR_NOT_INITIALIZED;
 
-  if (_air_host_active_module)
-    air_module_unload(_air_host_active_module);
+  {
+    std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+    for (auto handle : module_registry.Resident())
+      air_module_unload(handle);
+    // Bounce buffers are runtime memory, contexts outliving the runtime
+    // allocate new ones
+    for (air_rt_context_t *ctx : _air_host_contexts) {
+      if (ctx->bram_ptr)
+        air_free(ctx->bram_ptr);
+      ctx->bram_ptr = nullptr;
+      ctx->bram_paddr = 0;
+    }
+  }
 
   if (_air_host_active_libxaie)
     air_deinit_libxaie((air_libxaie_ctx_t)_air_host_active_libxaie);
 
+  // Returns the memory cached by the runtime while HSA is still up
+  air::rocm::Runtime::ShutDown();
+
   hsa_status_t hsa_ret = hsa_shut_down();
   if (hsa_ret != HSA_STATUS_SUCCESS) {
     printf("[ERROR] hsa_shut_down() failed\n");
@@ -181,55 +223,176 @@ void air_deinit_libxaie(air_libxaie_ctx_t _xaie) {
   free(xaie);
 }
 
+air_rt_context_t *air_context_create() {
+  air_rt_context_t *ctx = new air_rt_context_t;
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+  _air_host_contexts.insert(ctx);
+  return ctx;
+}
+
+void air_context_destroy(air_rt_context_t *ctx) {
+  if (!ctx || ctx == &_air_host_default_context)
+    return;
+
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+  _air_host_contexts.erase(ctx);
+  air_context_release_events(ctx);
+  if (ctx->module)
+    module_registry.Deactivate(ctx->module);
+  if (ctx->bram_ptr)
+    air_free(ctx->bram_ptr);
+  delete ctx;
+}
+
+void air_context_set_current(air_rt_context_t *ctx) {
+  _air_host_current_context = ctx;
+}
+
+air_rt_context_t *air_context_get_current() {
+  if (_air_host_current_context)
+    return _air_host_current_context;
+  return &_air_host_default_context;
+}
+
+// Makes `handle`, already activated in the registry, the module of `ctx`.
+// The herd and segment of the previous module are stashed in the context.
+static void air_module_switch(air_rt_context_t *ctx,
+                              air_module_handle_t handle) {
+  air_module_handle_t previous = ctx->module;
+  if (previous)
+    ctx->modules[previous] = {ctx->herd, ctx->segment};
+
+  auto it = ctx->modules.find(handle);
+  if (it != ctx->modules.end()) {
+    ctx->herd = it->second.herd;
+    ctx->segment = it->second.segment;
+    ctx->modules.erase(it);
+  } else {
+    ctx->herd = {nullptr, nullptr, nullptr};
+    ctx->segment = {nullptr, nullptr, nullptr};
+  }
+  ctx->module = handle;
+
+  // The array was configured by another module since, so the segment has to
+  // be loaded again by the next air_herd_load
+  if (_air_host_configured_module != handle)
+    ctx->segment.segment_desc = nullptr;
+
+  if (previous)
+    module_registry.Deactivate(previous);
+}
+
 air_module_handle_t air_module_load_from_file(const char *filename,
                                               hsa_agent_t *agent,
                                               hsa_queue_t *q,
                                               uint32_t device_id) {
-  if (_air_host_active_module)
-    air_module_unload(_air_host_active_module);
-
-  air_module_handle_t handle;
   void *_handle = dlopen(filename, RTLD_NOW);
   if (!_handle) {
     printf("%s\n", dlerror());
     return 0;
   }
-  _air_host_active_module = (air_module_handle_t)_handle;
-  _air_host_active_herd = {q, agent, nullptr};
-  _air_host_active_segment = {q, agent, nullptr};
+  air_module_handle_t handle = (air_module_handle_t)_handle;
+  air_rt_context_t *ctx = air_context_get_current();
 
-  _air_host_bram_ptr = (uint32_t *)air_malloc(BOUNCE_BUFFER_SIZE);
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+  if (!ctx->bram_ptr) {
+    ctx->bram_ptr = (uint32_t *)air_malloc(BOUNCE_BUFFER_SIZE);
+    assert((ctx->bram_ptr != NULL) && "Failed to map scratch bram location");
+  }
 
-  assert((_air_host_bram_ptr != MAP_FAILED) &&
-         "Failed to map scratch bram location");
+  // Already resident, drop the reference dlopen just took
+  bool resident = module_registry.Contains(handle);
+  if (resident)
+    dlclose(_handle);
+
+  bool used = handle == ctx->module || ctx->modules.count(handle);
+  if (handle != ctx->module) {
+    if (resident) {
+      module_registry.Activate(handle);
+    } else {
+      // The module holds whatever dlopen mapped
+      struct stat st;
+      module_registry.Insert(handle,
+                             stat(filename, &st) == 0 ? st.st_size : 0);
+    }
+    air_module_switch(ctx, handle);
+  }
+
+  // The first time a context uses a module, it runs on the given queue
+  if (!used) {
+    ctx->herd = {q, agent, nullptr};
+    ctx->segment = {q, agent, nullptr};
+  }
+
+  return handle;
+}
+
+int32_t air_module_activate(air_module_handle_t handle) {
+  air_rt_context_t *ctx = air_context_get_current();
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+  if (handle == ctx->module)
+    return module_registry.Contains(handle) ? 0 : -1;
+  if (!module_registry.Activate(handle))
+    return -1;
+
+  air_module_switch(ctx, handle);
+  return 0;
+}
 
-  return (air_module_handle_t)_handle;
+void air_module_set_memory_budget(size_t bytes) {
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+  module_registry.SetBudget(bytes);
 }
 
 int32_t air_module_unload(air_module_handle_t handle) {
   if (!handle)
     return -1;
 
-  if (auto module_desc = air_module_get_desc(handle)) {
-    for (int i = 0; i < module_desc->segment_length; i++) {
-      for (int j = 0; j < module_desc->segment_descs[i]->herd_length; j++) {
-        auto herd_desc = module_desc->segment_descs[i]->herd_descs[j];
-        if (herd_desc == _air_host_active_herd.herd_desc) {
-          if (_air_host_active_segment.q) {
-            hsa_queue_destroy(_air_host_active_segment.q);
-          }
-          _air_host_active_herd = {nullptr, nullptr};
-          _air_host_active_segment = {nullptr, nullptr, nullptr};
-        }
-      }
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+  module_registry.Remove(handle);
+  return air_module_release(handle);
+}
+
+// Closes a module after every context forgot it. A queue is only destroyed
+// with the last module a context uses it with.
+static int32_t air_module_release(air_module_handle_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+
+  std::vector<hsa_queue_t *> queues;
+  for (air_rt_context_t *ctx : _air_host_contexts) {
+    if (ctx->module == handle) {
+      if (ctx->herd.herd_desc && ctx->segment.q)
+        queues.push_back(ctx->segment.q);
+      ctx->module = 0;
+      ctx->herd = {nullptr, nullptr, nullptr};
+      ctx->segment = {nullptr, nullptr, nullptr};
+    }
+    auto it = ctx->modules.find(handle);
+    if (it != ctx->modules.end()) {
+      if (it->second.herd.herd_desc && it->second.segment.q)
+        queues.push_back(it->second.segment.q);
+      ctx->modules.erase(it);
     }
   }
-  if (_air_host_active_module == handle) {
-    _air_host_active_module = (air_module_handle_t) nullptr;
 
-    air_free(_air_host_bram_ptr);
-    _air_host_bram_paddr = 0;
-  }
+  auto in_use = [](hsa_queue_t *q) {
+    for (air_rt_context_t *ctx : _air_host_contexts) {
+      if (ctx->segment.q == q)
+        return true;
+      for (auto &m : ctx->modules)
+        if (m.second.segment.q == q)
+          return true;
+    }
+    return false;
+  };
+  std::sort(queues.begin(), queues.end());
+  queues.erase(std::unique(queues.begin(), queues.end()), queues.end());
+  for (hsa_queue_t *q : queues)
+    if (!in_use(q))
+      hsa_queue_destroy(q);
+
+  if (_air_host_configured_module == handle)
+    _air_host_configured_module = 0;
 
   return dlclose((void *)handle);
 }
@@ -282,16 +445,22 @@ air_module_desc_t *air_module_get_desc(air_module_handle_t handle) {
                                     "__airrt_module_descriptor");
 }
 
-uint64_t air_segment_load(const char *name) {
+uint64_t air_context_segment_load(air_rt_context_t *ctx, const char *name) {
 
   assert(_air_host_active_libxaie);
 
-  auto segment_desc = air_segment_get_desc(_air_host_active_module, name);
+  // There is a single AIE array to configure
+  std::lock_guard<std::recursive_mutex> lock(_air_host_mutex);
+
+  auto segment_desc = air_segment_get_desc(ctx->module, name);
   if (!segment_desc) {
     printf("Failed to locate segment descriptor '%s'!\n", name);
     assert(0);
   }
 
+  // Events of the previous launch can no longer be waited on
+  air_context_release_events(ctx);
+
   XAie_Finish(&(_air_host_active_libxaie->DevInst));
 
   // Setting the driver libxaie backend back up
@@ -307,28 +476,25 @@ uint64_t air_segment_load(const char *name) {
   //
   // Set up a 1x3 herd starting 7,0
   //
-  uint64_t wr_idx =
-      hsa_queue_add_write_index_relaxed(_air_host_active_segment.q, 1);
-  uint64_t packet_id = wr_idx % _air_host_active_segment.q->size;
+  uint64_t wr_idx = hsa_queue_add_write_index_relaxed(ctx->segment.q, 1);
+  uint64_t packet_id = wr_idx % ctx->segment.q->size;
   hsa_agent_dispatch_packet_t shim_pkt;
   air_packet_device_init(&shim_pkt, XAIE_NUM_COLS);
-  air_queue_dispatch_and_wait(_air_host_active_segment.agent,
-                              _air_host_active_segment.q, packet_id, wr_idx,
-                              &shim_pkt);
+  air_queue_dispatch_and_wait(ctx->segment.agent, ctx->segment.q, packet_id,
+                              wr_idx, &shim_pkt);
 
-  wr_idx = hsa_queue_add_write_index_relaxed(_air_host_active_segment.q, 1);
-  packet_id = wr_idx % _air_host_active_segment.q->size;
+  wr_idx = hsa_queue_add_write_index_relaxed(ctx->segment.q, 1);
+  packet_id = wr_idx % ctx->segment.q->size;
   hsa_agent_dispatch_packet_t segment_pkt;
   air_packet_segment_init(&segment_pkt, 0, 0, 50, 1, 8);
-  air_queue_dispatch_and_wait(_air_host_active_segment.agent,
-                              _air_host_active_segment.q, packet_id, wr_idx,
-                              &segment_pkt);
+  air_queue_dispatch_and_wait(ctx->segment.agent, ctx->segment.q, packet_id,
+                              wr_idx, &segment_pkt);
 
   std::string segment_name(segment_desc->name, segment_desc->name_length);
 
   std::string func_name = "__airrt_" + segment_name + "_aie_functions";
   air_rt_aie_functions_t *mlir = (air_rt_aie_functions_t *)dlsym(
-      (void *)_air_host_active_module, func_name.c_str());
+      (void *)ctx->module, func_name.c_str());
 
   if (mlir) {
     // printf("configuring segment: '%s'\n", segment_name.c_str());
@@ -347,116 +513,143 @@ uint64_t air_segment_load(const char *name) {
            segment_name.c_str());
     assert(0);
   }
-  _air_host_active_segment.segment_desc = segment_desc;
+  ctx->segment.segment_desc = segment_desc;
+  _air_host_configured_module = ctx->module;
   return 0;
 }
 
-uint64_t air_herd_load(const char *name) {
+uint64_t air_context_herd_load(air_rt_context_t *ctx, const char *name) {
+
+  // Events of the previous launch can no longer be waited on
+  air_context_release_events(ctx);
 
   // If no segment is loaded, load the segment associated with this herd
-  if (!_air_host_active_segment.segment_desc) {
+  if (!ctx->segment.segment_desc) {
     bool loaded = false;
-    if (auto module_desc = air_module_get_desc(_air_host_active_module)) {
+    if (auto module_desc = air_module_get_desc(ctx->module)) {
       for (int i = 0; !loaded && i < module_desc->segment_length; i++) {
         for (int j = 0;
              !loaded && j < module_desc->segment_descs[i]->herd_length; j++) {
           auto herd_desc = module_desc->segment_descs[i]->herd_descs[j];
           // use the segment of the first herd with a matching name
           if (!strncmp(name, herd_desc->name, herd_desc->name_length)) {
-            air_segment_load(module_desc->segment_descs[i]->name);
+            air_context_segment_load(ctx, module_desc->segment_descs[i]->name);
             loaded = true; // break
           }
         }
       }
     }
   }
-  auto herd_desc = air_herd_get_desc(
-      _air_host_active_module, _air_host_active_segment.segment_desc, name);
+  auto herd_desc =
+      air_herd_get_desc(ctx->module, ctx->segment.segment_desc, name);
   // In some scenarios load_segment is not called. This is a temporary hack
   // to support that case.
   if (!herd_desc) {
-    if (_air_host_active_segment.segment_desc) {
-      _air_host_active_segment.segment_desc = 0;
-      return air_herd_load(name);
+    if (ctx->segment.segment_desc) {
+      ctx->segment.segment_desc = 0;
+      return air_context_herd_load(ctx, name);
     }
     printf("Failed to locate herd descriptor '%s'!\n", name);
     assert(0);
   }
-  _air_host_active_herd.herd_desc = herd_desc;
+  ctx->herd.herd_desc = herd_desc;
 
   return 0;
 }
 
-uint64_t air_wait_all(std::vector<uint64_t> &signals) {
-  hsa_queue_t *q = _air_host_active_segment.q;
+/* Posts the barrier-AND packets of an air_wait_all to the segment queue of a
+context, see air::wait_all. The barrier signals come from the runtime's signal
+pool. */
+class air_barrier_transport {
+public:
+  explicit air_barrier_transport(air_rt_context_t *ctx) : ctx(ctx) {}
+
+  hsa_signal_t acquire_signal() {
+    return air::rocm::Runtime::runtime_->AcquireSignal(*ctx->segment.agent);
+  }
+
+  void release_signal(hsa_signal_t signal) {
+    air::rocm::Runtime::runtime_->ReleaseSignal(signal);
+  }
+
+  void post_barrier(const hsa_signal_t *deps, hsa_signal_t signal) {
+    hsa_queue_t *q = ctx->segment.q;
+    uint64_t wr_idx = hsa_queue_add_write_index_relaxed(q, 1);
+    uint64_t packet_id = wr_idx % q->size;
+    hsa_barrier_and_packet_t barrier_pkt;
+    air_packet_barrier_and(&barrier_pkt, deps[0], deps[1], deps[2], deps[3],
+                           deps[4]);
+    barrier_pkt.completion_signal = signal;
+    air_queue_dispatch(q, packet_id, wr_idx, &barrier_pkt);
+  }
+
+  void wait(hsa_signal_t signal) {
+    while (hsa_signal_wait_scacquire(signal, HSA_SIGNAL_CONDITION_EQ, 0,
+                                     0x80000, HSA_WAIT_STATE_ACTIVE) != 0)
+      ;
+  }
+
+private:
+  air_rt_context_t *ctx;
+};
+
+// Gives an event's signal back to the pool. Signals whose packet did not
+// complete yet stay pending in the pool.
+static void air_release_event(uint64_t signal) {
+  air::rocm::Runtime::runtime_->ReleaseSignal(hsa_signal_t{signal});
+}
+
+void air_context_add_event(air_rt_context_t *ctx, hsa_signal_t signal) {
+  ctx->events.add(signal.handle);
+}
+
+void air_context_release_events(air_rt_context_t *ctx) {
+  ctx->events.release_all(air_release_event);
+}
+
+uint64_t air_context_wait_all(air_rt_context_t *ctx,
+                              std::vector<uint64_t> &signals) {
+  hsa_queue_t *q = ctx->segment.q;
   if (!q) {
     printf("WARNING: no queue provided, air_wait_all will return without "
            "waiting\n");
     return 0;
   }
 
-  // Containing all of the barrier packets. This is needed because
-  // we might have to wait on more than 5 signals.
-  std::vector<hsa_barrier_and_packet_t> packets;
-
-  // iterate over the signals in chunks of 5
-  while (signals.size()) {
-    if (signals.size() < 5)
-      signals.resize(5, 0);
-
-    // Vector which contains the handles of the signals that we are going to
-    // wait on
-    std::vector<hsa_signal_t> signals_in_pkt;
-    bool non_zero = false;
-    for (auto s : signals) {
-      if (s) {
-        // Push back the proper signal
-        signals_in_pkt.push_back(*reinterpret_cast<hsa_signal_t *>(s));
-        non_zero = true;
-      } else {
-        // Create a dummy signal that will have a handle of 0
-        hsa_signal_t dummy_signal;
-        hsa_amd_signal_create_on_agent(
-            0, 0, nullptr, _air_host_active_segment.agent, 0, &dummy_signal);
-        dummy_signal.handle =
-            0; // The barrier and packet will ignore a signal with handle of 0
-        signals_in_pkt.push_back(dummy_signal);
-      }
-    }
-    if (non_zero) {
-
-      // Submit a barrier packet for 5 signals that we are waiting on
-      uint64_t wr_idx =
-          hsa_queue_add_write_index_relaxed(_air_host_active_segment.q, 1);
-      uint64_t packet_id = wr_idx % _air_host_active_segment.q->size;
-      hsa_barrier_and_packet_t barrier_pkt;
-      air_packet_barrier_and(&barrier_pkt, signals_in_pkt[0], signals_in_pkt[1],
-                             signals_in_pkt[2], signals_in_pkt[3],
-                             signals_in_pkt[4]);
-      hsa_amd_signal_create_on_agent(1, 0, nullptr,
-                                     _air_host_active_segment.agent, 0,
-                                     &barrier_pkt.completion_signal);
-      air_queue_dispatch(_air_host_active_segment.q, packet_id, wr_idx,
-                         &barrier_pkt);
-
-      // Put it in a vector of barrier packets so we can wait on all of them
-      // after they are submitted
-      packets.push_back(barrier_pkt);
-    }
-
-    // Remove the 5 signals from our vector and keep going if we have more
-    signals.resize(signals.size() - 5);
+  // The events we actually have to wait on. Null events are skipped, and
+  // a barrier packet ignores a signal with handle of 0.
+  std::vector<hsa_signal_t> events;
+  for (auto s : signals) {
+    if (s)
+      events.push_back(*reinterpret_cast<hsa_signal_t *>(s));
   }
 
-  // Submit each packet and delete the completion signal
-  for (auto p : packets) {
-    air_queue_wait(q, &p);
-    hsa_signal_destroy(p.completion_signal);
-  }
+  // The events stay with the context that issued them, as other wait_alls
+  // may still wait on them
+  air_barrier_transport transport(ctx);
+  air::wait_all(transport, events);
+
+  std::vector<uint64_t> waited;
+  for (auto e : events)
+    waited.push_back(e.handle);
+  ctx->events.mark_waited(waited);
+  ctx->events.reap(air_release_event);
 
   return 0;
 }
 
+uint64_t air_segment_load(const char *name) {
+  return air_context_segment_load(air_context_get_current(), name);
+}
+
+uint64_t air_herd_load(const char *name) {
+  return air_context_herd_load(air_context_get_current(), name);
+}
+
+uint64_t air_wait_all(std::vector<uint64_t> &signals) {
+  return air_context_wait_all(air_context_get_current(), signals);
+}
+
 uint64_t air_get_tile_addr(uint32_t col, uint32_t row) {
   if (_air_host_active_libxaie == NULL)
     return -1;
@@ -526,4 +719,65 @@ uint64_t _mlir_ciface___airrt_wait_all_1_3(uint64_t e0, uint64_t e1,
   return air_wait_all(events);
 }
 
+// Variants taking the context explicitly, emitted by airrt-to-llvm with
+// use-context. The context is looked up once per function instead of per
+// call.
+
+air_rt_context_t *_mlir_ciface___airrt_get_context() {
+  return air_context_get_current();
+}
+
+uint64_t _mlir_ciface___airrt_ctx_herd_load(air_rt_context_t *ctx,
+                                            const char *name) {
+  return air_context_herd_load(ctx, name);
+}
+
+uint64_t _mlir_ciface___airrt_ctx_segment_load(air_rt_context_t *ctx,
+                                               const char *name) {
+  return air_context_segment_load(ctx, name);
+}
+
+void _mlir_ciface___airrt_ctx_wait_all_0_0(air_rt_context_t * /*ctx*/) {
+  return;
+}
+void _mlir_ciface___airrt_ctx_wait_all_0_1(air_rt_context_t *ctx,
+                                           uint64_t e0) {
+  std::vector<uint64_t> events{e0, 0, 0, 0, 0};
+  air_context_wait_all(ctx, events);
+  return;
+}
+void _mlir_ciface___airrt_ctx_wait_all_0_2(air_rt_context_t *ctx, uint64_t e0,
+                                           uint64_t e1) {
+  std::vector<uint64_t> events{e0, e1, 0, 0, 0};
+  air_context_wait_all(ctx, events);
+  return;
+}
+void _mlir_ciface___airrt_ctx_wait_all_0_3(air_rt_context_t *ctx, uint64_t e0,
+                                           uint64_t e1, uint64_t e2) {
+  std::vector<uint64_t> events{e0, e1, e2, 0, 0};
+  air_context_wait_all(ctx, events);
+  return;
+}
+
+uint64_t _mlir_ciface___airrt_ctx_wait_all_1_0(air_rt_context_t *ctx) {
+  std::vector<uint64_t> events{};
+  return air_context_wait_all(ctx, events);
+}
+uint64_t _mlir_ciface___airrt_ctx_wait_all_1_1(air_rt_context_t *ctx,
+                                               uint64_t e0) {
+  std::vector<uint64_t> events{e0, 0, 0, 0, 0};
+  return air_context_wait_all(ctx, events);
+}
+uint64_t _mlir_ciface___airrt_ctx_wait_all_1_2(air_rt_context_t *ctx,
+                                               uint64_t e0, uint64_t e1) {
+  std::vector<uint64_t> events{e0, e1, 0, 0, 0};
+  return air_context_wait_all(ctx, events);
+}
+uint64_t _mlir_ciface___airrt_ctx_wait_all_1_3(air_rt_context_t *ctx,
+                                               uint64_t e0, uint64_t e1,
+                                               uint64_t e2) {
+  std::vector<uint64_t> events{e0, e1, e2, 0, 0};
+  return air_context_wait_all(ctx, events);
+}
+
 } // extern C
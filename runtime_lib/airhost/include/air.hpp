@@ -23,8 +23,12 @@ inline hsa_status_t air_get_agents(std::vector<hsa_agent_t> &agents) {
 }
 
 uint64_t air_wait_all(std::vector<uint64_t> &signals);
+uint64_t air_context_wait_all(air_rt_context_t *ctx,
+                              std::vector<uint64_t> &signals);
 
+// Configures the device with the sections of an AIRBIN, in a single load
+// packet unless `chunk_size` opts in to batched loading, see air::AirbinLoader
 hsa_status_t air_load_airbin(hsa_agent_t *agent, hsa_queue_t *q,
                              const char *filename, uint8_t column,
-                             uint32_t device_id = 0);
+                             uint32_t device_id = 0, size_t chunk_size = 0);
 #endif
@@ -168,7 +168,9 @@ struct air_module_desc_t {
 
 typedef size_t air_module_handle_t;
 
-// return 0 on failure, nonzero otherwise
+// Loads a module and makes it the active one of the current context.
+// Previously loaded modules stay resident. return 0 on failure, nonzero
+// otherwise
 air_module_handle_t air_module_load_from_file(const char *filename,
                                               hsa_agent_t *agent = 0,
                                               hsa_queue_t *q = 0,
@@ -177,6 +179,14 @@ air_module_handle_t air_module_load_from_file(const char *filename,
 // return 0 on success, nonzero otherwise
 int32_t air_module_unload(air_module_handle_t handle);
 
+// Switches the current context to a resident module without reloading it.
+// return 0 on success, nonzero if the module is not resident
+int32_t air_module_activate(air_module_handle_t handle);
+
+// Once the resident modules hold more than `bytes`, the least recently
+// activated ones no context uses are unloaded
+void air_module_set_memory_budget(size_t bytes);
+
 air_module_desc_t *air_module_get_desc(air_module_handle_t handle);
 
 air_segment_desc_t *air_segment_get_desc(air_module_handle_t handle,
@@ -189,6 +199,30 @@ air_herd_desc_t *air_herd_get_desc(air_module_handle_t handle,
 uint64_t air_segment_load(const char *name);
 
 uint64_t air_herd_load(const char *name);
+
+// Runtime contexts
+//
+// The active module, herd, segment and bounce buffer the runtime works with
+// live in a context. A thread uses the context bound to it, or the process
+// default context if it never bound one, so threads driving their own
+// contexts and queues can launch concurrently.
+
+struct air_rt_context_t;
+
+air_rt_context_t *air_context_create();
+
+// The context must not be bound to any thread anymore. Modules stay resident
+// and queues are left to their owner.
+void air_context_destroy(air_rt_context_t *ctx);
+
+// Binds `ctx` to the calling thread, nullptr binds the default context again
+void air_context_set_current(air_rt_context_t *ctx);
+
+air_rt_context_t *air_context_get_current();
+
+// air_segment_load and air_herd_load on a given context
+uint64_t air_context_segment_load(air_rt_context_t *ctx, const char *name);
+uint64_t air_context_herd_load(air_rt_context_t *ctx, const char *name);
 }
 
 // queue operations
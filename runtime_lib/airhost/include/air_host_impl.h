@@ -8,8 +8,13 @@
 #ifndef AIR_HOST_IMPL_H
 #define AIR_HOST_IMPL_H
 
+#include "air_host.h"
+#include "air_wait_all.h"
 #include "test_library.h"
 
+#include <unordered_map>
+#include <vector>
+
 // AIE config functions generated by AIE dialect lowering
 struct air_rt_aie_functions_t {
   int (*configure_cores)(aie_libxaie_ctx_t *);
@@ -19,6 +24,33 @@ struct air_rt_aie_functions_t {
   int (*start_cores)(aie_libxaie_ctx_t *);
 };
 
+// Runtime state driven by one thread at a time
+struct air_rt_context_t {
+  air_module_handle_t module = 0;
+  air_rt_herd_desc_t herd = {nullptr, nullptr, nullptr};
+  air_rt_segment_desc_t segment = {nullptr, nullptr, nullptr};
+  uint32_t *bram_ptr = nullptr;
+  uint64_t bram_paddr = 0;
+
+  // Herd and segment of the resident modules the context switched away from
+  struct module_state_t {
+    air_rt_herd_desc_t herd;
+    air_rt_segment_desc_t segment;
+  };
+  std::unordered_map<air_module_handle_t, module_state_t> modules;
+
+  // Completion signals handed out as events by asynchronous memcpys, sends
+  // and receives. They are released when the context loads the next herd or
+  // segment or is destroyed, and the ones air_wait_all saw complete are
+  // recycled once too many of them piled up, see air::event_list.
+  air::event_list events;
+};
+
+// Makes `signal` an event of `ctx`, see air_rt_context_t::events
+void air_context_add_event(air_rt_context_t *ctx, hsa_signal_t signal);
+// Releases the events of `ctx`
+void air_context_release_events(air_rt_context_t *ctx);
+
 /*
         Get the name of the device driver
 
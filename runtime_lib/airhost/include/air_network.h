@@ -10,19 +10,13 @@
 
 #include "air_queue.h"
 #include "air_tensor.h"
+#include "air_tensor_registry.h"
 #include "hsa/hsa.h"
 
 #include <map>
 #include <stdint.h>
 #include <string>
 
-struct tensor_to_qp_map_entry {
-  uint32_t qp;
-  uint32_t rkey;
-  uint64_t vaddr;
-  struct pcie_ernic_buff *local_buff;
-};
-
 struct world_view_entry {
   char ip[9];
   char mac[17];
@@ -41,6 +35,9 @@ air_explore_world(uint32_t ernic_id, uint64_t dev_mem_offset,
 hsa_status_t air_ernic_free();
 hsa_status_t air_ernic_mem_alloc(char buff_name[100], uint32_t size, void *t,
                                  bool register_mem);
+// Returns the RDMA registration of the tensor allocated at `alloc` by
+// air_ernic_mem_alloc, or nullptr if it was not allocated that way
+tensor_to_qp_map_entry *air_ernic_lookup_tensor(void *alloc);
 
 void air_recv(hsa_signal_t *s, tensor_t<uint32_t, 1> *t, uint32_t size,
               uint32_t offset, uint32_t src_rank, hsa_agent_t *agent,
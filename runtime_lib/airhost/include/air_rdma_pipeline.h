@@ -0,0 +1,64 @@
+//===- air_rdma_pipeline.h --------------------------------------*- C++-*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef AIR_RDMA_PIPELINE_H
+#define AIR_RDMA_PIPELINE_H
+
+#include <deque>
+#include <stdint.h>
+
+namespace air {
+namespace rdma {
+
+// Number of RQE sized chunks needed to move `size` bytes
+inline uint32_t num_chunks(uint32_t size, uint32_t chunk_size) {
+  return (size + chunk_size - 1) / chunk_size;
+}
+
+// Posts the `num_packets` data packets of a transfer, keeping at most `window`
+// of them in flight so the ERNIC queues never overflow, followed by the
+// closing synchronizing packet. The transport provides
+//   Signal acquire_signal();           a completion signal for one packet
+//   void release_signal(Signal s);     gives back a signal we are done with
+//   void post(uint32_t index, Signal s);
+//                                      posts packet `index` signalling `s`;
+//                                      index `num_packets` is the closing one
+//   void wait(Signal s);               blocks until the packet completed
+// Every packet gets a completion signal of its own, and the closing packet is
+// only posted once every data packet completed, so this relies neither on
+// the device completing packets in order nor on it honouring barrier bits.
+// Returns the completion signal of the closing packet, which the caller owns.
+template <typename Transport>
+auto post_pipelined(Transport &transport, uint32_t num_packets,
+                    uint32_t window) {
+  if (window == 0)
+    window = 1;
+  std::deque<decltype(transport.acquire_signal())> in_flight;
+  auto retire_oldest = [&]() {
+    transport.wait(in_flight.front());
+    transport.release_signal(in_flight.front());
+    in_flight.pop_front();
+  };
+  for (uint32_t i = 0; i < num_packets; i++) {
+    if (in_flight.size() >= window)
+      retire_oldest();
+    auto signal = transport.acquire_signal();
+    transport.post(i, signal);
+    in_flight.push_back(signal);
+  }
+  while (!in_flight.empty())
+    retire_oldest();
+
+  auto done = transport.acquire_signal();
+  transport.post(num_packets, done);
+  return done;
+}
+
+} // namespace rdma
+} // namespace air
+
+#endif
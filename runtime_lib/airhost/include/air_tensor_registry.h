@@ -0,0 +1,88 @@
+//===- air_tensor_registry.h ------------------------------------*- C++-*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef AIR_TENSOR_REGISTRY_H
+#define AIR_TENSOR_REGISTRY_H
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+
+struct pcie_ernic_buff;
+
+// Where a tensor registered for RDMA lives and how to reach it, resolved once
+// when the tensor is allocated
+struct tensor_to_qp_map_entry {
+  uint32_t qp; // QP of the remote host holding the tensor, 0 if local
+  uint32_t rkey;
+  uint64_t vaddr; // Remote virtual address, if remote
+  struct pcie_ernic_buff *local_buff;
+  uint64_t pa; // Physical address of local_buff in the device memory map
+  bool is_local;
+};
+
+// Maps the alloc pointer of registered tensors to their entries. The tensor
+// structs themselves are copied by value through the runtime, so their alloc
+// pointer is the only stable key. Lookups are hashed, and each thread
+// remembers its most recent lookup as DMAs tend to come in runs on the same
+// tensor. A remembered lookup is dropped once the registry changed. The
+// registry may be used from several threads, e.g. one per runtime context.
+class air_tensor_registry {
+public:
+  air_tensor_registry() : generation(next_generation++) {}
+
+  void insert(void *alloc, tensor_to_qp_map_entry *entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[alloc] = entry;
+    generation = next_generation++;
+  }
+
+  void erase(void *alloc) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(alloc);
+    generation = next_generation++;
+  }
+
+  // Returns nullptr if `alloc` is not registered
+  tensor_to_qp_map_entry *lookup(void *alloc) {
+    // Generations are unique across registries, so a hit remembered for
+    // another registry never matches
+    thread_local struct {
+      uint64_t generation = 0;
+      void *alloc = nullptr;
+      tensor_to_qp_map_entry *entry = nullptr;
+    } last;
+    if (alloc && alloc == last.alloc &&
+        generation.load(std::memory_order_acquire) == last.generation)
+      return last.entry;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(alloc);
+    if (it == entries.end())
+      return nullptr;
+    last.generation = generation.load(std::memory_order_relaxed);
+    last.alloc = alloc;
+    last.entry = it->second;
+    return last.entry;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+
+private:
+  // Starts at 1, so a thread that never looked anything up has no hit
+  static inline std::atomic<uint64_t> next_generation{1};
+
+  std::mutex mutex;
+  std::unordered_map<void *, tensor_to_qp_map_entry *> entries;
+  std::atomic<uint64_t> generation;
+};
+
+#endif
@@ -0,0 +1,123 @@
+//===- air_wait_all.h -------------------------------------------*- C++-*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef AIR_WAIT_ALL_H
+#define AIR_WAIT_ALL_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace air {
+
+// Number of signals a barrier-AND packet can wait on
+constexpr size_t barrier_and_signals = 5;
+
+// Blocks until every event in `events` completed, by posting barrier-AND
+// packets waiting on up to 5 of them each. The transport provides
+//   Signal acquire_signal();           a completion signal for one barrier
+//   void release_signal(Signal s);     gives back a signal we are done with
+//   void post_barrier(const Signal *deps, Signal s);
+//                                      posts a barrier waiting on the 5
+//                                      `deps`, null ones ignored, signalling
+//                                      `s`
+//   void wait(Signal s);               blocks until the barrier completed
+// Only the barrier signals are released. The events belong to whoever issued
+// them, as any number of wait_all calls may wait on the same event.
+template <typename Transport, typename Signal>
+void wait_all(Transport &transport, const std::vector<Signal> &events) {
+  std::vector<Signal> barriers;
+  for (size_t i = 0; i < events.size(); i += barrier_and_signals) {
+    Signal deps[barrier_and_signals] = {};
+    for (size_t j = 0; j < barrier_and_signals && i + j < events.size(); j++)
+      deps[j] = events[i + j];
+    Signal barrier = transport.acquire_signal();
+    transport.post_barrier(deps, barrier);
+    barriers.push_back(barrier);
+  }
+
+  for (auto barrier : barriers) {
+    transport.wait(barrier);
+    transport.release_signal(barrier);
+  }
+}
+
+// The completion signals a context handed out as events, e.g. by a
+// non-blocking memcpy. Any number of wait_all calls may wait on an event, so
+// none of them releases it. The context releases all of them at the end of a
+// launch. Events a wait_all saw complete are also released, oldest first,
+// down to `max_waited` of them once twice as many piled up. Runs that never
+// end a launch are thus bounded, while a token waited on again soon after
+// stays valid.
+class event_list {
+public:
+  static constexpr size_t default_max_waited = 256;
+
+  explicit event_list(size_t max_waited = default_max_waited)
+      : max_waited(max_waited) {}
+
+  void add(uint64_t signal) { events.push_back({signal, false}); }
+
+  // Records that `signals` completed. Signals not in the list are ignored.
+  void mark_waited(const std::vector<uint64_t> &signals) {
+    for (uint64_t signal : signals) {
+      // Recent events are the likeliest to be waited on
+      for (auto it = events.rbegin(); it != events.rend(); ++it) {
+        if (it->signal != signal)
+          continue;
+        if (!it->waited) {
+          it->waited = true;
+          num_waited++;
+        }
+        break;
+      }
+    }
+  }
+
+  // Hands the oldest waited events beyond `max_waited` to `release`, once
+  // there are twice as many
+  template <typename Release> void reap(Release release) {
+    if (num_waited < 2 * max_waited || num_waited == 0)
+      return;
+    size_t excess = num_waited - max_waited;
+    std::deque<event> kept;
+    for (const event &e : events) {
+      if (excess && e.waited) {
+        release(e.signal);
+        excess--;
+        num_waited--;
+      } else {
+        kept.push_back(e);
+      }
+    }
+    events.swap(kept);
+  }
+
+  // Hands every event to `release`
+  template <typename Release> void release_all(Release release) {
+    for (const event &e : events)
+      release(e.signal);
+    events.clear();
+    num_waited = 0;
+  }
+
+  size_t size() const { return events.size(); }
+
+private:
+  struct event {
+    uint64_t signal;
+    bool waited;
+  };
+
+  std::deque<event> events;
+  size_t num_waited = 0;
+  size_t max_waited;
+};
+
+} // namespace air
+
+#endif
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#ifndef AIRBIN_LOADER_H_
+#define AIRBIN_LOADER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "airbin.h"
+
+namespace air {
+
+// A loadable section of an AIRBIN, pointing into the mapped file.
+struct AirbinSection {
+  std::string name;
+  uint64_t addr = 0;          // Load address handed to the device
+  uint32_t size = 0;          // Bytes the section occupies on the device
+  const uint8_t *data = nullptr;
+  size_t data_size = 0;       // Bytes of section data present in the file
+  bool hex_encoded = false;   // Data is text, one 32-bit hex word per line
+};
+
+// A read-only mapping of an AIRBIN file. Both the ELF AIRBIN and the older
+// portable text AIRBIN (".AIR" magic) are understood. Section data is never
+// copied out of the mapping, the loader streams it straight into the staging
+// buffer.
+class AirbinImage {
+public:
+  AirbinImage() = default;
+  ~AirbinImage();
+
+  AirbinImage(const AirbinImage &) = delete;
+  AirbinImage &operator=(const AirbinImage &) = delete;
+
+  // Returns false and prints the reason if `filename` is not a valid AIRBIN.
+  bool Open(const char *filename);
+  void Close();
+
+  const std::vector<AirbinSection> &sections() const { return sections_; }
+
+private:
+  bool ParseElf();
+  bool ParsePortable();
+
+  const uint8_t *base_ = nullptr;
+  size_t size_ = 0;
+  std::vector<AirbinSection> sections_;
+};
+
+// Device side of a load: hands section tables to the device. The device
+// completes tables in the order they were submitted.
+class AirbinLoadQueue {
+public:
+  virtual ~AirbinLoadQueue() = default;
+  // Starts configuring the sections of the zero terminated `table` without
+  // waiting for it. Returns false if the table could not be submitted.
+  virtual bool Submit(airbin_table_entry *table) = 0;
+  // Number of submitted tables the device finished with.
+  virtual uint32_t Completed() = 0;
+};
+
+struct AirbinSectionTiming {
+  std::string name;
+  uint32_t size = 0;
+  uint32_t batch = 0;
+  double copy_sec = 0.0;   // Streaming the section into the staging buffer
+  double config_sec = 0.0; // Submitting its batch until the device finished
+};
+
+// Streams the sections of an image into a staging buffer and configures the
+// device with them. By default all sections go in a single table, submitted
+// once every section was copied. A nonzero `chunk_size` opts in to batching:
+// sections are grouped into batches of about `chunk_size` bytes, each with its
+// own table, and a batch is submitted as soon as it has been copied, so the
+// device configures one batch while the next one is still being copied. This
+// needs firmware handling the table of each AIRBIN load packet on its own.
+class AirbinLoader {
+public:
+  static constexpr size_t kSingleTable = 0;
+  // A reasonable chunk size for batched loads
+  static constexpr size_t kBatchChunkSize = 64 * 1024;
+
+  explicit AirbinLoader(const AirbinImage &image,
+                        size_t chunk_size = kSingleTable);
+
+  // Exact number of bytes of staging buffer Load needs.
+  size_t StagingSize() const { return staging_size_; }
+  uint32_t NumBatches() const { return batches_.size(); }
+
+  // `staging` must hold at least StagingSize() bytes and stay valid until
+  // the device finished with it, which Load waits for before returning.
+  bool Load(uint8_t *staging, AirbinLoadQueue *queue);
+
+  const std::vector<AirbinSectionTiming> &timings() const { return timings_; }
+  void PrintTimings() const;
+
+private:
+  struct Batch {
+    size_t first = 0; // Index of the first section of the batch
+    size_t count = 0;
+    size_t offset = 0; // Offset of the batch table in the staging buffer
+  };
+
+  void CopySection(const AirbinSection &section, uint8_t *dst,
+                   AirbinLoadQueue *queue, uint32_t &completed);
+  void PollCompletions(AirbinLoadQueue *queue, uint32_t &completed);
+
+  const AirbinImage &image_;
+  size_t chunk_size_;
+  size_t staging_size_ = 0;
+  std::vector<Batch> batches_;
+  std::vector<AirbinSectionTiming> timings_;
+  std::vector<double> submit_time_;
+  double load_sec_ = 0.0;
+};
+
+} // namespace air
+
+#endif // AIRBIN_LOADER_H_
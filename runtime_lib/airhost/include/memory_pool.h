@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#ifndef MEMORY_POOL_H_
+#define MEMORY_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace air {
+namespace rocm {
+
+// Source of the memory cached by a MemoryPool, e.g. an HSA memory pool.
+class MemoryPoolBackend {
+public:
+  virtual ~MemoryPoolBackend() = default;
+  virtual void *Allocate(size_t size) = 0;
+  virtual void Free(void *ptr) = 0;
+};
+
+struct MemoryPoolStats {
+  uint64_t allocations = 0; // Calls to Allocate
+  uint64_t frees = 0;       // Calls to Free
+  uint64_t hits = 0;        // Allocations served from the cache
+  uint64_t backend_allocations = 0;
+  uint64_t backend_frees = 0;
+  size_t bytes_in_use = 0;
+  size_t bytes_cached = 0;
+  size_t peak_bytes_in_use = 0;
+};
+
+// Caching allocator in front of a MemoryPoolBackend. Requests up to
+// kMaxBucketSize are rounded up to a power of two size bucket. Larger requests
+// are only rounded up to a multiple of kMinBucketSize, so they waste at most a
+// page instead of up to half the buffer. Freed buffers are kept on the free
+// list of their size to serve later requests of the same size, so a steady
+// state allocation pattern stops reaching the backend altogether. Once more
+// than the cache limit is kept cached, the largest cached buffers are given
+// back to the backend.
+class MemoryPool {
+public:
+  static constexpr size_t kMinBucketSize = 4096;
+  static constexpr size_t kMaxBucketSize = 1024 * 1024;
+  static constexpr size_t kDefaultCacheLimit = 256 * 1024 * 1024;
+
+  explicit MemoryPool(MemoryPoolBackend *backend,
+                      size_t cache_limit = kDefaultCacheLimit)
+      : backend_(backend), cache_limit_(cache_limit) {}
+  ~MemoryPool();
+
+  MemoryPool(const MemoryPool &) = delete;
+  MemoryPool &operator=(const MemoryPool &) = delete;
+
+  void *Allocate(size_t size);
+  // Returns false if `ptr` was not allocated by this pool.
+  bool Free(void *ptr);
+
+  // Gives cached buffers back to the backend until at most `max_cached_bytes`
+  // remain cached.
+  void Trim(size_t max_cached_bytes = 0);
+  void SetCacheLimit(size_t cache_limit);
+  MemoryPoolStats GetStats();
+
+  static size_t BucketSize(size_t size);
+
+private:
+  void TrimLocked(size_t max_cached_bytes);
+
+  MemoryPoolBackend *backend_;
+  size_t cache_limit_;
+  std::mutex mutex_;
+  // Free lists keyed by bucket size
+  std::map<size_t, std::vector<void *>> free_lists_;
+  // Bucket size of every buffer handed out
+  std::unordered_map<void *, size_t> live_;
+  MemoryPoolStats stats_;
+};
+
+} // namespace rocm
+} // namespace air
+
+#endif // MEMORY_POOL_H_
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#ifndef MODULE_REGISTRY_H_
+#define MODULE_REGISTRY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace air {
+namespace rocm {
+
+// Releases everything a resident module holds once the registry evicts it,
+// e.g. its queue and the dlopen handle.
+class ModuleRegistryBackend {
+public:
+  virtual ~ModuleRegistryBackend() = default;
+  virtual void Unload(uint64_t handle) = 0;
+};
+
+struct ModuleRegistryStats {
+  uint64_t inserted = 0;    // Modules made resident
+  uint64_t activations = 0; // Calls to Activate on a resident module
+  uint64_t evictions = 0;   // Modules unloaded to stay within the budget
+  size_t resident = 0;
+  size_t bytes_resident = 0;
+};
+
+// Keeps several loaded modules resident. A module is active while a runtime
+// context uses it, and may be active in several contexts at once. Modules are
+// kept in least recently activated order, and once the memory held by the
+// resident modules exceeds the budget, the least recently activated ones are
+// handed to the backend to be unloaded. Active modules are never evicted.
+class ModuleRegistry {
+public:
+  static constexpr size_t kDefaultBudget = 256 * 1024 * 1024;
+
+  explicit ModuleRegistry(ModuleRegistryBackend *backend,
+                          size_t budget = kDefaultBudget)
+      : backend_(backend), budget_(budget) {}
+
+  ModuleRegistry(const ModuleRegistry &) = delete;
+  ModuleRegistry &operator=(const ModuleRegistry &) = delete;
+
+  // Makes `handle`, which holds `bytes` of memory, resident and activates it
+  // once.
+  void Insert(uint64_t handle, size_t bytes);
+  // Activates `handle` once more. Returns false if it is not resident.
+  bool Activate(uint64_t handle);
+  // Drops one activation of `handle`, which becomes evictable with the last.
+  void Deactivate(uint64_t handle);
+  // Forgets `handle` without unloading it. Returns false if it was not
+  // resident.
+  bool Remove(uint64_t handle);
+
+  bool Contains(uint64_t handle);
+  bool IsActive(uint64_t handle);
+  // Resident modules, most recently activated first.
+  std::vector<uint64_t> Resident();
+
+  void SetBudget(size_t budget);
+  ModuleRegistryStats GetStats();
+
+private:
+  struct Entry {
+    std::list<uint64_t>::iterator lru;
+    size_t bytes;
+    uint32_t active; // Contexts the module is active in
+  };
+
+  // Unlinks modules until the budget is met and returns them for unloading,
+  // which happens outside of the lock since the backend may call Remove.
+  std::vector<uint64_t> EvictLocked();
+  void Unload(const std::vector<uint64_t> &victims);
+
+  ModuleRegistryBackend *backend_;
+  size_t budget_;
+  std::mutex mutex_;
+  std::list<uint64_t> lru_; // Most recently activated first
+  std::unordered_map<uint64_t, Entry> modules_;
+  ModuleRegistryStats stats_;
+};
+
+} // namespace rocm
+} // namespace air
+
+#endif // MODULE_REGISTRY_H_
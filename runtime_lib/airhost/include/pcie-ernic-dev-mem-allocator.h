@@ -24,28 +24,81 @@
 
 // #include "pcie-bdf.h"
 
-// Defining our memory allocator. Right now going
-// to implement it as a stack, where we can just
-// make arbitrary allocations to it, and it grows
-// until it runs out of space. I guess that is the
-// easiest for now
+// Number of size classes of the free lists. Free blocks of size in
+// [2^i, 2^(i+1)) are kept on list i, and everything larger than the last
+// class on the last list.
+#define DEV_MEM_NUM_SIZE_CLASSES 32
+
+// Default alignment of device memory allocations, in bytes
+#define DEV_MEM_DEFAULT_ALIGNMENT 64
+
+// A contiguous range of device memory, either handed out to the user or free.
+// All blocks are kept in address order so neighbours can be coalesced, and
+// free blocks are additionally linked into the free list of their size class.
+struct dev_mem_block {
+  uint64_t offset; // Offset of the block from the start of the segment
+  uint64_t size;
+  bool free;
+  struct dev_mem_block *prev; // Neighbours in address order
+  struct dev_mem_block *next;
+  struct dev_mem_block *free_prev; // Neighbours in the size class free list
+  struct dev_mem_block *free_next;
+};
+
+// Defining our memory allocator. The segment of device memory is carved into
+// blocks which are handed out from size-class free lists and coalesced with
+// their free neighbours when released, so long running applications can
+// allocate and free device buffers without exhausting the BAR.
 struct pcie_ernic_dev_mem_allocator {
   void *dev_mem;                    // Pointing to device BAR
   const char *dev_mem_bar_filename; // BAR which is backed by device memory
-  uint64_t dev_mem_ptr;             // Points to the top of the device memory
+  uint64_t dev_mem_ptr; // Points to the top of the highest allocation made
   uint64_t dev_mem_size; // The total size of the device memory so we can report
                          // errors when too much is requested
   uint64_t segment_offset; // Need an offset in case multiple processes are
                            // using device memory
   uint64_t global_offset; // This is the offset in the hardware memory map so we
                           // can directly address device memory
+  uint64_t alignment;     // Alignment of the PA of every allocation
+  bool owns_dev_mem;      // If we mapped dev_mem and have to unmap it
+  struct dev_mem_block *blocks; // All blocks in address order
+  struct dev_mem_block *free_lists[DEV_MEM_NUM_SIZE_CLASSES];
+  uint64_t bytes_in_use;
+  uint64_t high_water_mark; // Largest value bytes_in_use has reached
+  uint64_t num_allocs;
+  uint64_t num_frees;
+};
+
+// Snapshot of the state of a device memory allocator
+struct pcie_ernic_dev_mem_stats {
+  uint64_t capacity;      // Bytes managed by the allocator
+  uint64_t bytes_in_use;  // Bytes handed out, including alignment padding
+  uint64_t bytes_free;    // Bytes on the free lists
+  uint64_t high_water_mark;
+  uint64_t largest_free_block;
+  uint64_t num_free_blocks;
+  uint64_t num_allocs;
+  uint64_t num_frees;
+  double fragmentation; // 1 - largest_free_block / bytes_free
 };
 
 struct pcie_ernic_dev_mem_allocator *init_dev_mem_allocator(
     const char *dev_mem_bar_filename, uint64_t dev_mem_bar_size,
     uint64_t dev_mem_global_offset, uint64_t dev_mem_segment_offset);
+// Same as init_dev_mem_allocator, but manages memory which the caller has
+// already mapped, e.g. an anonymous mapping standing in for the BAR. The
+// mapping is not unmapped by free_dev_mem_allocator.
+struct pcie_ernic_dev_mem_allocator *init_dev_mem_allocator_with_mem(
+    void *dev_mem, uint64_t dev_mem_size, uint64_t dev_mem_global_offset,
+    uint64_t dev_mem_segment_offset);
 void free_dev_mem_allocator(struct pcie_ernic_dev_mem_allocator *allocator);
 void *dev_mem_alloc(struct pcie_ernic_dev_mem_allocator *allocator,
                     uint32_t size, uint64_t *pa);
+void *dev_mem_alloc_aligned(struct pcie_ernic_dev_mem_allocator *allocator,
+                            uint64_t size, uint64_t alignment, uint64_t *pa);
+void dev_mem_free(struct pcie_ernic_dev_mem_allocator *allocator, void *ptr);
+void dev_mem_get_stats(struct pcie_ernic_dev_mem_allocator *allocator,
+                       struct pcie_ernic_dev_mem_stats *stats);
+void dev_mem_print_stats(struct pcie_ernic_dev_mem_allocator *allocator);
 
 #endif
@@ -4,11 +4,15 @@
 #ifndef RUNTIME_H_
 #define RUNTIME_H_
 
+#include <memory>
 #include <vector>
 
 #include <hsa/hsa.h>
 #include <hsa/hsa_ext_amd.h>
 
+#include "memory_pool.h"
+#include "signal_pool.h"
+
 namespace air {
 namespace rocm {
 
@@ -18,12 +22,43 @@ public:
   static void Init();
   static void ShutDown();
 
+  // Host memory registered with the AIE agents. Freed buffers are cached and
+  // reused by later allocations, see MemoryPool.
   void *AllocateMemory(size_t size);
   void FreeMemory(void *ptr);
+  void TrimMemory(size_t max_cached_bytes = 0);
+  void SetMemoryCacheLimit(size_t cache_limit);
+  MemoryPoolStats GetMemoryStats();
+
+  // Completion signals recycled through a SignalPool. A signal is acquired
+  // with one reference, which its owner releases: the waiter of a blocking
+  // operation, or the context an event was handed out by.
+  hsa_signal_t AcquireSignal(hsa_agent_t agent, hsa_signal_value_t value = 1);
+  void RetainSignal(hsa_signal_t signal);
+  void ReleaseSignal(hsa_signal_t signal);
+  SignalPoolStats GetSignalStats();
 
   static Runtime *runtime_;
 
 private:
+  class HsaMemoryPoolBackend : public MemoryPoolBackend {
+  public:
+    explicit HsaMemoryPoolBackend(hsa_amd_memory_pool_t pool) : pool_(pool) {}
+    void *Allocate(size_t size) override;
+    void Free(void *ptr) override;
+
+  private:
+    hsa_amd_memory_pool_t pool_;
+  };
+
+  class HsaSignalPoolBackend : public SignalPoolBackend {
+  public:
+    uint64_t Create(uint64_t agent, int64_t value) override;
+    void Destroy(uint64_t signal) override;
+    int64_t Load(uint64_t signal) override;
+    void Store(uint64_t signal, int64_t value) override;
+  };
+
   static hsa_status_t IterateAgents(hsa_agent_t agent, void *data);
   static hsa_status_t IterateMemPool(hsa_amd_memory_pool_t pool, void *data);
   void FindAieAgents();
@@ -31,6 +66,10 @@ private:
 
   hsa_amd_memory_pool_t global_mem_pool_;
   std::vector<hsa_agent_t> aie_agents_;
+  std::unique_ptr<HsaMemoryPoolBackend> mem_pool_backend_;
+  std::unique_ptr<MemoryPool> mem_pool_;
+  HsaSignalPoolBackend signal_pool_backend_;
+  SignalPool signal_pool_{&signal_pool_backend_};
 };
 
 } // namespace rocm
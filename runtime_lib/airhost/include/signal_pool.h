@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#ifndef SIGNAL_POOL_H_
+#define SIGNAL_POOL_H_
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace air {
+namespace rocm {
+
+// Creates and destroys the signals cached by a SignalPool, e.g. HSA signals.
+// Signals and agents are identified by their handles.
+class SignalPoolBackend {
+public:
+  virtual ~SignalPoolBackend() = default;
+  virtual uint64_t Create(uint64_t agent, int64_t value) = 0;
+  virtual void Destroy(uint64_t signal) = 0;
+  virtual int64_t Load(uint64_t signal) = 0;
+  virtual void Store(uint64_t signal, int64_t value) = 0;
+};
+
+struct SignalPoolStats {
+  uint64_t acquired = 0;  // Calls to Acquire
+  uint64_t reused = 0;    // Acquires served from the pool
+  uint64_t created = 0;   // Signals created by the backend
+  uint64_t destroyed = 0; // Signals destroyed by the backend
+  size_t live = 0;        // Signals with outstanding references
+  size_t pending = 0;     // Released, waiting for their packet to complete
+  size_t pooled = 0;      // Ready to be reused
+};
+
+// Pool of completion signals. A signal is acquired with one reference, which
+// its owner drops once nothing can wait on it anymore. More owners can add
+// references. A signal without references only goes back to the pool once its
+// value reached zero, i.e. once the packet signalling it completed, so a stale
+// wait on a recycled signal either passes or waits for a later packet, but
+// never misses a completion.
+//
+// Events, the signals a runtime context hands out for asynchronous operations,
+// are released when the context loads the next herd or segment, and in bulk
+// once it holds many that air_wait_all saw complete, see air::event_list.
+// Limitations: events nobody waits on are only released at those launch
+// boundaries, and an event waited on again after it was recycled waits for
+// the later packet that reused its signal.
+class SignalPool {
+public:
+  explicit SignalPool(SignalPoolBackend *backend) : backend_(backend) {}
+  ~SignalPool();
+
+  SignalPool(const SignalPool &) = delete;
+  SignalPool &operator=(const SignalPool &) = delete;
+
+  uint64_t Acquire(uint64_t agent, int64_t value);
+  void Retain(uint64_t signal);
+  // Returns false if `signal` was not acquired from this pool.
+  bool Release(uint64_t signal);
+
+  // Destroys every pooled signal.
+  void Trim();
+  SignalPoolStats GetStats();
+
+private:
+  struct Entry {
+    uint64_t agent;
+    uint32_t refs;
+  };
+
+  // Moves pending signals whose packet completed to the pool.
+  void CollectPendingLocked();
+
+  SignalPoolBackend *backend_;
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, Entry> live_;
+  std::vector<std::pair<uint64_t, uint64_t>> pending_; // (signal, agent)
+  // Free signals by the agent they were created on
+  std::unordered_map<uint64_t, std::vector<uint64_t>> pool_;
+  SignalPoolStats stats_;
+};
+
+} // namespace rocm
+} // namespace air
+
+#endif // SIGNAL_POOL_H_
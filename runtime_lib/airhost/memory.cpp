@@ -22,14 +22,6 @@
 #include <unistd.h>   /* for getpagesize() */
 #include <vector>
 
-extern "C" {
-
-extern air_rt_herd_desc_t _air_host_active_herd;
-extern aie_libxaie_ctx_t *_air_host_active_libxaie;
-extern uint32_t *_air_host_bram_ptr;
-extern uint64_t _air_host_bram_paddr;
-}
-
 void *air_malloc(size_t size) {
   void *mem(air::rocm::Runtime::runtime_->AllocateMemory(size));
   return mem;
@@ -37,10 +29,6 @@ void *air_malloc(size_t size) {
 
 void air_free(void *mem) { air::rocm::Runtime::runtime_->FreeMemory(mem); }
 
-// Data structure internal to the runtime to map air tensors
-// to the information to access a remote buffer
-extern std::map<void *, tensor_to_qp_map_entry *> tensor_to_qp_map;
-
 static int64_t shim_location_data(air_herd_shim_desc_t *sd, int i, int j,
                                   int k) {
   return sd->location_data[i * 8 * 8 + j * 8 + k];
@@ -51,21 +39,27 @@ static int64_t shim_channel_data(air_herd_shim_desc_t *sd, int i, int j,
   return sd->channel_data[i * 8 * 8 + j * 8 + k];
 }
 
+static void wait_for_signal(hsa_signal_t signal) {
+  while (hsa_signal_wait_scacquire(signal, HSA_SIGNAL_CONDITION_EQ, 0, 0x80000,
+                                   HSA_WAIT_STATE_ACTIVE) != 0)
+    ;
+}
+
 template <typename T, int R>
 static void air_mem_shim_nd_memcpy_queue_impl(
-    hsa_signal_t *s, uint32_t id, uint64_t x, uint64_t y, tensor_t<T, R> *t,
-    uint32_t space, uint64_t offset_3, uint64_t offset_2, uint64_t offset_1,
-    uint64_t offset_0, uint64_t length_4d, uint64_t length_3d,
-    uint64_t length_2d, uint64_t length_1d, uint64_t stride_4d,
-    uint64_t stride_3d, uint64_t stride_2d) {
-  assert(_air_host_active_herd.herd_desc &&
-         "cannot shim memcpy without active herd");
-  assert(_air_host_active_herd.q &&
+    air_rt_context_t *ctx, hsa_signal_t *s, uint32_t id, uint64_t x,
+    uint64_t y, tensor_t<T, R> *t, uint32_t space, uint64_t offset_3,
+    uint64_t offset_2, uint64_t offset_1, uint64_t offset_0,
+    uint64_t length_4d, uint64_t length_3d, uint64_t length_2d,
+    uint64_t length_1d, uint64_t stride_4d, uint64_t stride_3d,
+    uint64_t stride_2d) {
+  assert(ctx->herd.herd_desc && "cannot shim memcpy without active herd");
+  assert(ctx->herd.q &&
          "cannot shim memcpy using a queue without active queue");
-  assert(_air_host_active_herd.agent &&
+  assert(ctx->herd.agent &&
          "cannot shim memcpy using an agent without an active agent");
 
-  auto shim_desc = _air_host_active_herd.herd_desc->shim_desc;
+  auto shim_desc = ctx->herd.herd_desc->shim_desc;
   auto shim_col = shim_location_data(shim_desc, id - 1, x, y);
   auto shim_chan = shim_channel_data(shim_desc, id - 1, x, y);
 
@@ -78,15 +72,10 @@ static void air_mem_shim_nd_memcpy_queue_impl(
   //       stride_4d, stride_3d, stride_2d);
 
   // Checking our internal representation to determine if the buffer is
-  // remote or local. If we don't find anything in our map, we say it
+  // remote or local. If the tensor wasn't registered for RDMA, we say it
   // is local
-  struct tensor_to_qp_map_entry *rdma_entry = tensor_to_qp_map[t->alloc];
-  bool is_local = true;
-  if (rdma_entry != NULL) {
-    is_local = (rdma_entry->qp == 0);
-  } else {
-    is_local = true; // If not in our map make it local
-  }
+  struct tensor_to_qp_map_entry *rdma_entry = air_ernic_lookup_tensor(t->alloc);
+  bool is_local = !rdma_entry || rdma_entry->is_local;
 
   bool isMM2S = shim_chan >= 2;
 
@@ -103,9 +92,8 @@ static void air_mem_shim_nd_memcpy_queue_impl(
       stride *= t->shape[R - i - 1];
     }
 
-    uint64_t wr_idx =
-        hsa_queue_add_write_index_relaxed(_air_host_active_herd.q, 1);
-    uint64_t packet_id = wr_idx % _air_host_active_herd.q->size;
+    uint64_t wr_idx = hsa_queue_add_write_index_relaxed(ctx->herd.q, 1);
+    uint64_t packet_id = wr_idx % ctx->herd.q->size;
 
     hsa_agent_dispatch_packet_t pkt;
 
@@ -115,27 +103,28 @@ static void air_mem_shim_nd_memcpy_queue_impl(
         length_1d * sizeof(T), length_2d, stride_2d * sizeof(T), length_3d,
         stride_3d * sizeof(T), length_4d, stride_4d * sizeof(T));
 
-    // TODO: Right now we don't have a way of knowing when we can destroy these
-    // signals
+    // The completion signal comes from the runtime's signal pool. It becomes
+    // an event of the context, or goes back right away for a blocking memcpy
+    auto runtime = air::rocm::Runtime::runtime_;
+    pkt.completion_signal = runtime->AcquireSignal(*ctx->herd.agent);
     if (s) {
       // Fire off the packet
-      hsa_amd_signal_create_on_agent(1, 0, nullptr, _air_host_active_herd.agent,
-                                     0, &pkt.completion_signal);
-      air_queue_dispatch(_air_host_active_herd.q, packet_id, wr_idx, &pkt);
+      air_queue_dispatch(ctx->herd.q, packet_id, wr_idx, &pkt);
 
       // Set the signal that we were passed in equal to the completion signal
       s->handle = pkt.completion_signal.handle;
+      air_context_add_event(ctx, pkt.completion_signal);
     } else {
-      air_queue_dispatch_and_wait(_air_host_active_herd.agent,
-                                  _air_host_active_herd.q, packet_id, wr_idx,
-                                  &pkt);
+      air_queue_dispatch(ctx->herd.q, packet_id, wr_idx, &pkt);
+      wait_for_signal(pkt.completion_signal);
+      runtime->ReleaseSignal(pkt.completion_signal);
     }
     return;
   } else {
-    uint32_t *bounce_buffer = _air_host_bram_ptr;
+    uint32_t *bounce_buffer = ctx->bram_ptr;
 
     // Only used for RDMA requests
-    uint64_t bounce_buffer_pa = _air_host_bram_paddr;
+    uint64_t bounce_buffer_pa = ctx->bram_paddr;
 
     size_t stride = 1;
     size_t offset = 0;
@@ -180,20 +169,18 @@ static void air_mem_shim_nd_memcpy_queue_impl(
               memcpy((size_t *)bounce_buffer, (size_t *)paddr_1d,
                      length_1d * sizeof(T));
             } else {
-              wr_idx =
-                  hsa_queue_add_write_index_relaxed(_air_host_active_herd.q, 1);
-              packet_id = wr_idx % _air_host_active_herd.q->size;
+              wr_idx = hsa_queue_add_write_index_relaxed(ctx->herd.q, 1);
+              packet_id = wr_idx % ctx->herd.q->size;
               air_packet_post_rdma_wqe(
                   &rdma_read_pkt, (uint64_t)paddr_1d,
                   (uint64_t)bounce_buffer_pa, (uint32_t)length_1d * sizeof(T),
                   (uint8_t)OP_READ, (uint8_t)rdma_entry->rkey,
                   (uint8_t)rdma_entry->qp, (uint8_t)0);
 
-              // air_write_pkt<hsa_agent_dispatch_packet_t>(_air_host_active_herd.q,
+              // air_write_pkt<hsa_agent_dispatch_packet_t>(ctx->herd.q,
               // packet_id, &rdma_read_pkt);
-              air_queue_dispatch_and_wait(_air_host_active_herd.agent,
-                                          _air_host_active_herd.q, packet_id,
-                                          wr_idx, &rdma_read_pkt);
+              air_queue_dispatch_and_wait(ctx->herd.agent, ctx->herd.q,
+                                          packet_id, wr_idx, &rdma_read_pkt);
             }
 
             // Update physical address of the bounce buffer we are writing to
@@ -207,31 +194,28 @@ static void air_mem_shim_nd_memcpy_queue_impl(
       }
     }
 
-    wr_idx = hsa_queue_add_write_index_relaxed(_air_host_active_herd.q, 1);
-    packet_id = wr_idx % _air_host_active_herd.q->size;
+    wr_idx = hsa_queue_add_write_index_relaxed(ctx->herd.q, 1);
+    packet_id = wr_idx % ctx->herd.q->size;
 
     hsa_agent_dispatch_packet_t memcpy_pkt;
     air_packet_nd_memcpy(
         &memcpy_pkt, /*herd_id=*/0, shim_col, /*direction=*/isMM2S, shim_chan,
         /*burst_len=*/4, /*memory_space=*/2,
-        /*_air_host_bram_paddr*/ reinterpret_cast<uint64_t>(_air_host_bram_ptr),
+        /*ctx->bram_paddr*/ reinterpret_cast<uint64_t>(ctx->bram_ptr),
         length * sizeof(T), 1, 0, 1, 0, 1, 0);
 
-    // TODO: Right now we don't have a way of knowing when we can destroy these
-    // signals
+    // The bounce buffer is reused right below, so this memcpy always waits,
+    // but the signal is still handed over to the caller when asked for
+    auto runtime = air::rocm::Runtime::runtime_;
+    memcpy_pkt.completion_signal = runtime->AcquireSignal(*ctx->herd.agent);
+    air_queue_dispatch(ctx->herd.q, packet_id, wr_idx, &memcpy_pkt);
+    wait_for_signal(memcpy_pkt.completion_signal);
     if (s) {
-      // Fire off the packet
-      // TODO: Don't wait here
-      air_queue_dispatch_and_wait(_air_host_active_herd.agent,
-                                  _air_host_active_herd.q, packet_id, wr_idx,
-                                  &memcpy_pkt, false);
-
       // Having the signal that we were passed point to the same signal value
       s->handle = memcpy_pkt.completion_signal.handle;
+      air_context_add_event(ctx, memcpy_pkt.completion_signal);
     } else {
-      air_queue_dispatch_and_wait(_air_host_active_herd.agent,
-                                  _air_host_active_herd.q, packet_id, wr_idx,
-                                  &memcpy_pkt);
+      runtime->ReleaseSignal(memcpy_pkt.completion_signal);
     }
 
     if (!isMM2S) {
@@ -244,9 +228,8 @@ static void air_mem_shim_nd_memcpy_queue_impl(
               memcpy((size_t *)paddr_1d, (size_t *)bounce_buffer,
                      length_1d * sizeof(T));
             } else {
-              wr_idx =
-                  hsa_queue_add_write_index_relaxed(_air_host_active_herd.q, 1);
-              packet_id = wr_idx % _air_host_active_herd.q->size;
+              wr_idx = hsa_queue_add_write_index_relaxed(ctx->herd.q, 1);
+              packet_id = wr_idx % ctx->herd.q->size;
               hsa_agent_dispatch_packet_t rdma_write_pkt;
 
               air_packet_post_rdma_wqe(
@@ -255,11 +238,10 @@ static void air_mem_shim_nd_memcpy_queue_impl(
                   (uint8_t)OP_WRITE, (uint8_t)rdma_entry->rkey,
                   (uint8_t)rdma_entry->qp, (uint8_t)0);
 
-              // air_write_pkt<hsa_agent_dispatch_packet_t>(_air_host_active_herd.q,
+              // air_write_pkt<hsa_agent_dispatch_packet_t>(ctx->herd.q,
               // packet_id, &rdma_write_pkt);
-              air_queue_dispatch_and_wait(_air_host_active_herd.agent,
-                                          _air_host_active_herd.q, packet_id,
-                                          wr_idx, &rdma_write_pkt);
+              air_queue_dispatch_and_wait(ctx->herd.agent, ctx->herd.q,
+                                          packet_id, wr_idx, &rdma_write_pkt);
             }
 
             bounce_buffer_pa += length_1d * sizeof(T);
@@ -275,22 +257,33 @@ static void air_mem_shim_nd_memcpy_queue_impl(
 }
 
 #define mlir_air_dma_nd_memcpy(mangle, rank, space, type)                      \
-  void _mlir_ciface___airrt_dma_nd_memcpy_##mangle(                            \
-      hsa_signal_t *s, uint32_t id, uint64_t x, uint64_t y, void *t,           \
-      uint64_t offset_3, uint64_t offset_2, uint64_t offset_1,                 \
-      uint64_t offset_0, uint64_t length_3, uint64_t length_2,                 \
-      uint64_t length_1, uint64_t length_0, uint64_t stride_2,                 \
-      uint64_t stride_1, uint64_t stride_0) {                                  \
+  void _mlir_ciface___airrt_ctx_dma_nd_memcpy_##mangle(                        \
+      air_rt_context_t *ctx, hsa_signal_t *s, uint32_t id, uint64_t x,         \
+      uint64_t y, void *t, uint64_t offset_3, uint64_t offset_2,               \
+      uint64_t offset_1, uint64_t offset_0, uint64_t length_3,                 \
+      uint64_t length_2, uint64_t length_1, uint64_t length_0,                 \
+      uint64_t stride_2, uint64_t stride_1, uint64_t stride_0) {               \
     tensor_t<type, rank> *tt = (tensor_t<type, rank> *)t;                      \
-    if (_air_host_active_herd.q) {                                             \
+    if (ctx->herd.q) {                                                         \
       air_mem_shim_nd_memcpy_queue_impl(                                       \
-          s, id, x, y, tt, space, offset_3, offset_2, offset_1, offset_0,      \
-          length_3, length_2, length_1, length_0, stride_2, stride_1,          \
-          stride_0);                                                           \
+          ctx, s, id, x, y, tt, space, offset_3, offset_2, offset_1,           \
+          offset_0, length_3, length_2, length_1, length_0, stride_2,          \
+          stride_1, stride_0);                                                 \
     } else {                                                                   \
       printf(                                                                  \
           "WARNING: no queue provided. ND memcpy will not be performed.\n");   \
     }                                                                          \
+  }                                                                            \
+  void _mlir_ciface___airrt_dma_nd_memcpy_##mangle(                            \
+      hsa_signal_t *s, uint32_t id, uint64_t x, uint64_t y, void *t,           \
+      uint64_t offset_3, uint64_t offset_2, uint64_t offset_1,                 \
+      uint64_t offset_0, uint64_t length_3, uint64_t length_2,                 \
+      uint64_t length_1, uint64_t length_0, uint64_t stride_2,                 \
+      uint64_t stride_1, uint64_t stride_0) {                                  \
+    _mlir_ciface___airrt_ctx_dma_nd_memcpy_##mangle(                           \
+        air_context_get_current(), s, id, x, y, t, offset_3, offset_2,         \
+        offset_1, offset_0, length_3, length_2, length_1, length_0,            \
+        stride_2, stride_1, stride_0);                                         \
   }
 
 extern "C" {
@@ -315,19 +308,30 @@ mlir_air_dma_nd_memcpy(4d1f32, 4, 1, float);
 } // extern "C"
 
 #define mlir_air_nd_memcpy(mangle, rank0, space0, type0, rank1, space1, type1) \
-  void _mlir_ciface___airrt_nd_memcpy_##mangle(                                \
-      void *t0, void *t1, uint64_t offset_3, uint64_t offset_2,                \
-      uint64_t offset_1, uint64_t offset_0, uint64_t length_3,                 \
-      uint64_t length_2, uint64_t length_1, uint64_t length_0,                 \
-      uint64_t stride_2, uint64_t stride_1, uint64_t stride_0) {               \
+  void _mlir_ciface___airrt_ctx_nd_memcpy_##mangle(                            \
+      air_rt_context_t *ctx, void *t0, void *t1, uint64_t offset_3,            \
+      uint64_t offset_2, uint64_t offset_1, uint64_t offset_0,                 \
+      uint64_t length_3, uint64_t length_2, uint64_t length_1,                 \
+      uint64_t length_0, uint64_t stride_2, uint64_t stride_1,                 \
+      uint64_t stride_0) {                                                     \
     tensor_t<type0, rank0> *tt0 = (tensor_t<type0, rank0> *)t0;                \
     tensor_t<type1, rank1> *tt1 = (tensor_t<type1, rank1> *)t1;                \
-    if (_air_host_active_herd.q) {                                             \
+    if (ctx->herd.q) {                                                         \
       printf("WARNING: ND memcpy will not be performed.\n");                   \
     } else {                                                                   \
       printf(                                                                  \
           "WARNING: no queue provided. ND memcpy will not be performed.\n");   \
     }                                                                          \
+  }                                                                            \
+  void _mlir_ciface___airrt_nd_memcpy_##mangle(                                \
+      void *t0, void *t1, uint64_t offset_3, uint64_t offset_2,                \
+      uint64_t offset_1, uint64_t offset_0, uint64_t length_3,                 \
+      uint64_t length_2, uint64_t length_1, uint64_t length_0,                 \
+      uint64_t stride_2, uint64_t stride_1, uint64_t stride_0) {               \
+    _mlir_ciface___airrt_ctx_nd_memcpy_##mangle(                               \
+        air_context_get_current(), t0, t1, offset_3, offset_2, offset_1,       \
+        offset_0, length_3, length_2, length_1, length_0, stride_2,            \
+        stride_1, stride_0);                                                   \
   }
 
 extern "C" {
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#include "memory_pool.h"
+
+#include <algorithm>
+
+namespace air {
+namespace rocm {
+
+MemoryPool::~MemoryPool() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  TrimLocked(0);
+}
+
+size_t MemoryPool::BucketSize(size_t size) {
+  if (size > kMaxBucketSize)
+    return (size + kMinBucketSize - 1) / kMinBucketSize * kMinBucketSize;
+  size_t bucket_size = kMinBucketSize;
+  while (bucket_size < size)
+    bucket_size <<= 1;
+  return bucket_size;
+}
+
+void *MemoryPool::Allocate(size_t size) {
+  size_t bucket_size = BucketSize(size);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.allocations++;
+
+  void *ptr(nullptr);
+  auto free_list = free_lists_.find(bucket_size);
+  if (free_list != free_lists_.end() && !free_list->second.empty()) {
+    ptr = free_list->second.back();
+    free_list->second.pop_back();
+    stats_.bytes_cached -= bucket_size;
+    stats_.hits++;
+  } else {
+    ptr = backend_->Allocate(bucket_size);
+    if (!ptr) {
+      // Retry with everything cached given back to the backend
+      TrimLocked(0);
+      ptr = backend_->Allocate(bucket_size);
+    }
+    if (!ptr)
+      return nullptr;
+    stats_.backend_allocations++;
+  }
+
+  live_[ptr] = bucket_size;
+  stats_.bytes_in_use += bucket_size;
+  stats_.peak_bytes_in_use =
+      std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
+  return ptr;
+}
+
+bool MemoryPool::Free(void *ptr) {
+  if (!ptr)
+    return true;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = live_.find(ptr);
+  if (it == live_.end())
+    return false;
+
+  size_t bucket_size = it->second;
+  live_.erase(it);
+  free_lists_[bucket_size].push_back(ptr);
+  stats_.frees++;
+  stats_.bytes_in_use -= bucket_size;
+  stats_.bytes_cached += bucket_size;
+
+  if (stats_.bytes_cached > cache_limit_)
+    TrimLocked(cache_limit_);
+  return true;
+}
+
+void MemoryPool::Trim(size_t max_cached_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  TrimLocked(max_cached_bytes);
+}
+
+void MemoryPool::SetCacheLimit(size_t cache_limit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_limit_ = cache_limit;
+  TrimLocked(cache_limit_);
+}
+
+MemoryPoolStats MemoryPool::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void MemoryPool::TrimLocked(size_t max_cached_bytes) {
+  // Largest buckets first, they free up the most memory per backend call
+  for (auto it = free_lists_.rbegin(); it != free_lists_.rend(); ++it) {
+    auto &[bucket_size, free_list] = *it;
+    while (stats_.bytes_cached > max_cached_bytes && !free_list.empty()) {
+      backend_->Free(free_list.back());
+      free_list.pop_back();
+      stats_.bytes_cached -= bucket_size;
+      stats_.backend_frees++;
+    }
+  }
+}
+
+} // namespace rocm
+} // namespace air
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#include "module_registry.h"
+
+namespace air {
+namespace rocm {
+
+void ModuleRegistry::Insert(uint64_t handle, size_t bytes) {
+  std::vector<uint64_t> victims;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = modules_.find(handle);
+    if (it != modules_.end()) {
+      stats_.bytes_resident -= it->second.bytes;
+      it->second.bytes = bytes;
+      it->second.active++;
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+    } else {
+      lru_.push_front(handle);
+      modules_[handle] = {lru_.begin(), bytes, 1};
+      stats_.inserted++;
+    }
+    stats_.bytes_resident += bytes;
+    victims = EvictLocked();
+  }
+  Unload(victims);
+}
+
+bool ModuleRegistry::Activate(uint64_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = modules_.find(handle);
+  if (it == modules_.end())
+    return false;
+
+  stats_.activations++;
+  it->second.active++;
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+  return true;
+}
+
+void ModuleRegistry::Deactivate(uint64_t handle) {
+  std::vector<uint64_t> victims;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = modules_.find(handle);
+    if (it == modules_.end() || !it->second.active)
+      return;
+    // The budget may have been exceeded while the module was pinned
+    if (--it->second.active == 0)
+      victims = EvictLocked();
+  }
+  Unload(victims);
+}
+
+bool ModuleRegistry::Remove(uint64_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = modules_.find(handle);
+  if (it == modules_.end())
+    return false;
+
+  stats_.bytes_resident -= it->second.bytes;
+  lru_.erase(it->second.lru);
+  modules_.erase(it);
+  return true;
+}
+
+bool ModuleRegistry::Contains(uint64_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return modules_.count(handle);
+}
+
+bool ModuleRegistry::IsActive(uint64_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = modules_.find(handle);
+  return it != modules_.end() && it->second.active;
+}
+
+std::vector<uint64_t> ModuleRegistry::Resident() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::vector<uint64_t>(lru_.begin(), lru_.end());
+}
+
+void ModuleRegistry::SetBudget(size_t budget) {
+  std::vector<uint64_t> victims;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+    victims = EvictLocked();
+  }
+  Unload(victims);
+}
+
+ModuleRegistryStats ModuleRegistry::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ModuleRegistryStats stats = stats_;
+  stats.resident = modules_.size();
+  return stats;
+}
+
+std::vector<uint64_t> ModuleRegistry::EvictLocked() {
+  std::vector<uint64_t> victims;
+  auto it = lru_.end();
+  while (stats_.bytes_resident > budget_ && it != lru_.begin()) {
+    --it;
+    if (modules_[*it].active)
+      continue;
+    uint64_t handle = *it;
+    stats_.bytes_resident -= modules_[handle].bytes;
+    stats_.evictions++;
+    modules_.erase(handle);
+    it = lru_.erase(it);
+    victims.push_back(handle);
+  }
+  return victims;
+}
+
+void ModuleRegistry::Unload(const std::vector<uint64_t> &victims) {
+  for (uint64_t handle : victims)
+    backend_->Unload(handle);
+}
+
+} // namespace rocm
+} // namespace air
@@ -5,7 +5,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cstdio>
+#include <functional>
 #include <iostream>
 #include <math.h>
 #include <stdio.h>
@@ -13,7 +15,10 @@
 
 #include "air.hpp"
 #include "air_host.h"
+#include "air_host_impl.h"
+#include "air_rdma_pipeline.h"
 #include "pcie-ernic.h"
+#include "runtime.h"
 
 #define QP_DEPTH 0x01000100
 
@@ -21,8 +26,11 @@
 char air_hostname[100];
 struct pcie_ernic_dev *air_ernic_dev;
 std::map<std::string, int> hostname_to_qp_map;
-std::map<void *, tensor_to_qp_map_entry *> tensor_to_qp_map;
+air_tensor_registry tensor_to_qp_map;
 std::map<std::string, world_view_entry *> world_view;
+// Our own entry of the world view, so the data path doesn't have to look up
+// our hostname
+world_view_entry *air_local_view = NULL;
 std::map<std::string, std::string> data_placement;
 
 // Used to set this hosts hostname
@@ -49,17 +57,16 @@ air_explore_world(uint32_t ernic_id, uint64_t dev_mem_offset,
   // Storing the representation of the distributed system
   world_view = pass_world_view;
   data_placement = pass_data_placement;
+  air_local_view = world_view[air_hostname];
 
   // Reading the world view to get our own IP and MAC address
-  uint32_t ip_addr =
-      std::stoul(std::string(world_view[air_hostname]->ip), nullptr, 16);
-  uint64_t mac_addr =
-      std::stoul(std::string(world_view[air_hostname]->mac), nullptr, 16);
+  uint32_t ip_addr = std::stoul(std::string(air_local_view->ip), nullptr, 16);
+  uint64_t mac_addr = std::stoul(std::string(air_local_view->mac), nullptr, 16);
   uint32_t mac_addr_msb = mac_addr >> 32;
   uint32_t mac_addr_lsb = mac_addr & 0xffffffff;
-  uint32_t our_rank = world_view[air_hostname]->rank;
+  uint32_t our_rank = air_local_view->rank;
   uint32_t src_qps[128];
-  memcpy(src_qps, world_view[air_hostname]->qps, sizeof(src_qps));
+  memcpy(src_qps, air_local_view->qps, sizeof(src_qps));
 
 #ifdef VERBOSE_DEBUG
   printf("[INFO] Initializing ERNIC:\n");
@@ -184,9 +191,10 @@ hsa_status_t air_ernic_mem_alloc(char buff_name[100], uint32_t size, void *t,
     entry->rkey = 0;
     entry->vaddr = 0;
     entry->local_buff = reg_mem;
+    entry->pa = reg_mem->pa;
+    entry->is_local = true;
 
-    tensor_to_qp_map.insert(
-        std::pair<void *, tensor_to_qp_map_entry *>(tt->alloc, entry));
+    tensor_to_qp_map.insert(tt->alloc, entry);
 
     // Registering the memory, and advertising it to every QP
     if (register_mem) {
@@ -235,6 +243,8 @@ hsa_status_t air_ernic_mem_alloc(char buff_name[100], uint32_t size, void *t,
     entry->rkey = rkey;
     entry->vaddr = vaddr;
     entry->local_buff = reg_mem;
+    entry->pa = reg_mem->pa;
+    entry->is_local = false;
 
     // Can't use the address of the tensor to uniquely identify it because it is
     // copied internally before getting passed to the runtime. So need to
@@ -243,13 +253,16 @@ hsa_status_t air_ernic_mem_alloc(char buff_name[100], uint32_t size, void *t,
     // TODO: There must be a better way to do this
     tt->data = tt->alloc = (uint32_t *)reg_mem->buff;
 
-    tensor_to_qp_map.insert(
-        std::pair<void *, tensor_to_qp_map_entry *>(tt->alloc, entry));
+    tensor_to_qp_map.insert(tt->alloc, entry);
   }
 
   return HSA_STATUS_SUCCESS;
 }
 
+tensor_to_qp_map_entry *air_ernic_lookup_tensor(void *alloc) {
+  return tensor_to_qp_map.lookup(alloc);
+}
+
 // Should be called at the end of the application
 hsa_status_t air_ernic_free() {
 
@@ -258,6 +271,70 @@ hsa_status_t air_ernic_free() {
   return HSA_STATUS_SUCCESS;
 }
 
+/* Posts the packets of an RDMA transfer to an AIR queue, see
+air::rdma::post_pipelined. Every packet gets a completion signal of its own
+from the runtime's signal pool. */
+class air_rdma_transport {
+public:
+  air_rdma_transport(
+      hsa_agent_t *agent, hsa_queue_t *q,
+      std::function<void(uint32_t, hsa_agent_dispatch_packet_t *)> make_pkt)
+      : agent(agent), q(q), make_pkt(make_pkt) {}
+
+  hsa_signal_t acquire_signal() {
+    return air::rocm::Runtime::runtime_->AcquireSignal(*agent);
+  }
+
+  void release_signal(hsa_signal_t signal) {
+    air::rocm::Runtime::runtime_->ReleaseSignal(signal);
+  }
+
+  void post(uint32_t index, hsa_signal_t signal) {
+    uint64_t wr_idx = hsa_queue_add_write_index_relaxed(q, 1);
+    uint64_t packet_id = wr_idx % q->size;
+    hsa_agent_dispatch_packet_t pkt;
+    make_pkt(index, &pkt);
+    pkt.completion_signal = signal;
+    air_queue_dispatch(q, packet_id, wr_idx, &pkt);
+  }
+
+  void wait(hsa_signal_t signal) {
+    while (hsa_signal_wait_scacquire(signal, HSA_SIGNAL_CONDITION_EQ, 0,
+                                     0x80000, HSA_WAIT_STATE_ACTIVE) != 0)
+      ;
+  }
+
+private:
+  hsa_agent_t *agent;
+  hsa_queue_t *q;
+  std::function<void(uint32_t, hsa_agent_dispatch_packet_t *)> make_pkt;
+};
+
+// Number of packets of a transfer we can have in flight on a QP whose ERNIC
+// queue is `qp_depth` deep, without overflowing the AIR queue either
+static uint32_t air_rdma_window(hsa_queue_t *q, uint32_t qp_depth) {
+  uint32_t window = q->size - 1;
+  if (qp_depth != 0)
+    window = std::min(window, qp_depth);
+  return window;
+}
+
+// Posts the transfer and either hands the completion signal of its closing
+// packet to the caller through `s`, as an event of the current context, or
+// waits for it to complete
+static void air_rdma_transfer(hsa_signal_t *s, air_rdma_transport &transport,
+                              uint32_t num_packets, uint32_t window) {
+  hsa_signal_t done =
+      air::rdma::post_pipelined(transport, num_packets, window);
+  if (s) {
+    s->handle = done.handle;
+    air_context_add_event(air_context_get_current(), done);
+  } else {
+    transport.wait(done);
+    transport.release_signal(done);
+  }
+}
+
 /* Performs a message passing receive. We first poll on receiving an
 RDMA SEND which contains the data, which is then copied to the provided
 tensor t. We then send a synchronizing SEND back to remote agent. This
@@ -277,7 +354,7 @@ void air_recv(hsa_signal_t *s, tensor_t<uint32_t, 1> *t, uint32_t size,
     return;
   }
 
-  if (world_view[air_hostname] == NULL) {
+  if (air_local_view == NULL) {
     printf("[ERROR] Called air_recv but hostname %s is not in world view\n",
            air_hostname);
     return;
@@ -286,93 +363,62 @@ void air_recv(hsa_signal_t *s, tensor_t<uint32_t, 1> *t, uint32_t size,
   // Unforunately we don't have any way to get the physical address for a buffer
   // not registered for RDMA, so for now the memory needs to be local registered
   // memory
-  struct tensor_to_qp_map_entry *rdma_entry = tensor_to_qp_map[t->alloc];
+  struct tensor_to_qp_map_entry *rdma_entry = tensor_to_qp_map.lookup(t->alloc);
   if (rdma_entry == NULL) {
     printf("[ERROR] air_recv given tensor not currently mapped\n");
     return;
   }
 
   // Checking if the buffer is remote or not
-  if (rdma_entry->qp != 0) {
+  if (!rdma_entry->is_local) {
     printf("[ERROR] air_recv given remote tensor\n");
     return;
   }
 
   // Using the world_view to determine the QP that the SEND will come on
-  uint32_t qpid = world_view[air_hostname]->qps[src_rank];
+  uint32_t qpid = air_local_view->qps[src_rank];
   if (qpid <= 1) {
     printf("[ERROR] in air_recv given src_rank %d which illegaly to qp %d\n",
            src_rank, qpid);
     return;
   }
 
-  // If we are provided a signal we can implement a non-blocking SEND and
-  // some other packets can wait on that signal
-  if (s) {
-    printf("TODO: Implement non-blocking air_recv\n");
-  } else {
-
-    // Calculating the number of RQEs that will be received
-    uint32_t num_rqes = ceil((float)size / RQE_SIZE);
-    uint32_t amount_data_left = size;
-
-    uint64_t wr_idx, packet_id;
-    uint32_t rqe_offset = 0;
-    while (amount_data_left > 0) {
-
-      // Calculating how much data we will recieve this iteration
-      uint32_t amount_data_to_recv = 0;
-      if (amount_data_left > RQE_SIZE) {
-        amount_data_to_recv = RQE_SIZE;
-      } else {
-        amount_data_to_recv = amount_data_left;
-      }
-
-      wr_idx = hsa_queue_add_write_index_relaxed(q, 1);
-      packet_id = wr_idx % q->size;
-      hsa_agent_dispatch_packet_t recv_pkt;
-
-      air_packet_post_rdma_recv(&recv_pkt, // HSA Packet
-                                rdma_entry->local_buff->pa + rqe_offset +
-                                    offset,          // Local PADDR
-                                amount_data_to_recv, // Length
-                                (uint8_t)qpid,       // QPID
-                                ernic_sel);          // ERNIC select
-
-      // Need to do this because otherwise the runtime will complain the packet
-      // is timing out but it is supposed to be blocking
-      // air_write_pkt<hsa_agent_dispatch_packet_t>(q, packet_id, &recv_pkt);
-      air_queue_dispatch(q, packet_id, wr_idx, &recv_pkt);
-
-      while (hsa_signal_wait_scacquire(recv_pkt.completion_signal,
-                                       HSA_SIGNAL_CONDITION_EQ, 0, 0x80000,
-                                       HSA_WAIT_STATE_ACTIVE) != 0)
-        ;
-
-      // Calculating how much data we have to receive now and the new offset
-      amount_data_left -= amount_data_to_recv;
-      rqe_offset += amount_data_to_recv;
-    }
-
-    // Sending a synchronizing SEND so the corresponding air_send() can complete
-    wr_idx = hsa_queue_add_write_index_relaxed(q, 1);
-    packet_id = wr_idx % q->size;
-    hsa_agent_dispatch_packet_t sync_send_pkt;
-    air_packet_post_rdma_wqe(
-        &sync_send_pkt,             // HSA Packet
-        0,                          // Remote VADDR
-        rdma_entry->local_buff->pa, // Local PADDR -- Once 0 length SENDs are
-                                    // working we can just make this 0
-        0x00000100, // Length -- For some reason 0 length is not working so need
-                    // to do a single RQE SEND
-        (uint8_t)OP_SEND, // op
-        0,                // Key
-        (uint8_t)qpid,    // QPID
-        ernic_sel);       // ERNIC select
-
-    // air_write_pkt<hsa_agent_dispatch_packet_t>(q, packet_id, &sync_send_pkt);
-    air_queue_dispatch_and_wait(agent, q, packet_id, wr_idx, &sync_send_pkt);
-  }
+  // Posting an RQE for every chunk of the data, as many at a time as the
+  // QP's receive queue can hold, followed by a synchronizing SEND so the
+  // corresponding air_send() can complete. The SEND is only posted once all
+  // of the data was received. If we are provided a signal we return without
+  // waiting for the SEND, and other packets can wait on that signal.
+  uint32_t num_rqes = air::rdma::num_chunks(size, RQE_SIZE);
+  uint64_t local_pa = rdma_entry->pa;
+  struct pcie_ernic_qp *qp = air_ernic_dev ? air_ernic_dev->qps[qpid] : NULL;
+  uint32_t window = air_rdma_window(q, qp ? qp->qdepth >> 16 : 0);
+
+  air_rdma_transport transport(
+      agent, q,
+      [&](uint32_t index, hsa_agent_dispatch_packet_t *pkt) {
+        if (index < num_rqes) {
+          uint32_t rqe_offset = index * RQE_SIZE;
+          uint32_t length = std::min<uint32_t>(RQE_SIZE, size - rqe_offset);
+          air_packet_post_rdma_recv(pkt, // HSA Packet
+                                    local_pa + rqe_offset + offset, // PADDR
+                                    length,        // Length
+                                    (uint8_t)qpid, // QPID
+                                    ernic_sel);    // ERNIC select
+          return;
+        }
+        air_packet_post_rdma_wqe(
+            pkt,      // HSA Packet
+            0,        // Remote VADDR
+            local_pa, // Local PADDR -- Once 0 length SENDs are working we can
+                      // just make this 0
+            0x00000100, // Length -- For some reason 0 length is not working so
+                        // need to do a single RQE SEND
+            (uint8_t)OP_SEND, // op
+            0,                // Key
+            (uint8_t)qpid,    // QPID
+            ernic_sel);       // ERNIC select
+      });
+  air_rdma_transfer(s, transport, num_rqes, window);
 }
 
 /* Performs an SEND operation of the data in the provided tensor t.
@@ -394,7 +440,7 @@ void air_send(hsa_signal_t *s, tensor_t<uint32_t, 1> *t, uint32_t size,
     return;
   }
 
-  if (world_view[air_hostname] == NULL) {
+  if (air_local_view == NULL) {
     printf("[ERROR] Called air_send but hostname %s is not in world view\n",
            air_hostname);
     return;
@@ -403,20 +449,20 @@ void air_send(hsa_signal_t *s, tensor_t<uint32_t, 1> *t, uint32_t size,
   // Unforunately we don't have any way to get the physical address for a buffer
   // not registered for RDMA, so for now the memory needs to be local registered
   // memory
-  struct tensor_to_qp_map_entry *rdma_entry = tensor_to_qp_map[t->alloc];
+  struct tensor_to_qp_map_entry *rdma_entry = tensor_to_qp_map.lookup(t->alloc);
   if (rdma_entry == NULL) {
     printf("[ERROR] air_send given tensor not currently mapped\n");
     return;
   }
 
   // Checking if the buffer is remote or not
-  if (rdma_entry->qp != 0) {
+  if (!rdma_entry->is_local) {
     printf("[ERROR] air_send given remote tensor\n");
     return;
   }
 
   // Using the world_view to determine the QP that the SEND will come on
-  uint32_t qpid = world_view[air_hostname]->qps[dst_rank];
+  uint32_t qpid = air_local_view->qps[dst_rank];
   if (qpid <= 1) {
     printf(
         "[ERROR] in air_send given dst_rank %d which illegaly maps to qp %d\n",
@@ -424,56 +470,41 @@ void air_send(hsa_signal_t *s, tensor_t<uint32_t, 1> *t, uint32_t size,
     return;
   }
 
-  // If we are provided a signal we can implement a non-blocking SEND and
-  // some other packets can wait on that signal
-  if (s) {
-    printf("TODO: Implement non-blocking air_send\n");
-  } else {
-
-    // Calculating the number of RQEs that will be received
-    uint32_t num_rqes = ceil((float)size / RQE_SIZE);
-
-    uint64_t wr_idx, packet_id;
-    uint32_t rqe_offset = 0;
-    for (int i = 0; i < num_rqes; i++) {
-      wr_idx = hsa_queue_add_write_index_relaxed(q, 1);
-      packet_id = wr_idx % q->size;
-      hsa_agent_dispatch_packet_t send_pkt;
-      air_packet_post_rdma_wqe(
-          &send_pkt,                                        // HSA Packet
-          0,                                                // Remote VADDR
-          rdma_entry->local_buff->pa + rqe_offset + offset, // Local PADDR
-          0x00000100, // Length -- Need to send RQE size elements, receive side
-                      // will only copy the valid data
-          (uint8_t)OP_SEND, // op
-          0,                // Key
-          (uint8_t)qpid,    // QPID
-          ernic_sel);       // ERNIC select
-
-      // air_write_pkt<hsa_agent_dispatch_packet_t>(q, packet_id, &send_pkt);
-      air_queue_dispatch_and_wait(agent, q, packet_id, wr_idx, &send_pkt);
-    }
-
-    wr_idx = hsa_queue_add_write_index_relaxed(q, 1);
-    packet_id = wr_idx % q->size;
-    hsa_agent_dispatch_packet_t recv_pkt;
-
-    air_packet_post_rdma_recv(
-        &recv_pkt,                  // HSA Packet
-        rdma_entry->local_buff->pa, // Local PADDR
-        0, // Length - Synchronizing so don't want to copy any of the data over
-        (uint8_t)qpid, // QPID
-        ernic_sel);    // Ernic select
-
-    // Need to do this because otherwise the runtime will complain the packet is
-    // timing out but it is supposed to be blocking
-    // air_write_pkt<hsa_agent_dispatch_packet_t>(q, packet_id, &recv_pkt);
-    air_queue_dispatch(q, packet_id, wr_idx, &recv_pkt);
-    while (hsa_signal_wait_scacquire(recv_pkt.completion_signal,
-                                     HSA_SIGNAL_CONDITION_EQ, 0, 0x80000,
-                                     HSA_WAIT_STATE_ACTIVE) != 0)
-      ;
-  }
+  // Posting a WQE for every RQE sized chunk of the data, as many at a time as
+  // the QP's send queue can hold, followed by a RECV of the synchronizing
+  // SEND that reports the data was received. The RECV is only posted once all
+  // of the data was sent. If we are provided a signal we return without
+  // waiting for the RECV, and other packets can wait on that signal.
+  uint32_t num_rqes = air::rdma::num_chunks(size, RQE_SIZE);
+  uint64_t local_pa = rdma_entry->pa;
+  struct pcie_ernic_qp *qp = air_ernic_dev ? air_ernic_dev->qps[qpid] : NULL;
+  uint32_t window = air_rdma_window(q, qp ? qp->qdepth & 0xffff : 0);
+
+  air_rdma_transport transport(
+      agent, q,
+      [&](uint32_t index, hsa_agent_dispatch_packet_t *pkt) {
+        if (index < num_rqes) {
+          air_packet_post_rdma_wqe(
+              pkt,                                  // HSA Packet
+              0,                                    // Remote VADDR
+              local_pa + index * RQE_SIZE + offset, // Local PADDR
+              0x00000100, // Length -- Need to send RQE size elements, receive
+                          // side will only copy the valid data
+              (uint8_t)OP_SEND, // op
+              0,                // Key
+              (uint8_t)qpid,    // QPID
+              ernic_sel);       // ERNIC select
+          return;
+        }
+        air_packet_post_rdma_recv(
+            pkt,      // HSA Packet
+            local_pa, // Local PADDR
+            0, // Length - Synchronizing so don't want to copy any of the data
+               // over
+            (uint8_t)qpid, // QPID
+            ernic_sel);    // Ernic select
+      });
+  air_rdma_transfer(s, transport, num_rqes, window);
 }
 
 /* Provides a very simplistic barrier for remote AIR instances.
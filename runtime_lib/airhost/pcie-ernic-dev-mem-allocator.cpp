@@ -21,23 +21,126 @@
 
 #include "include/pcie-ernic-dev-mem-allocator.h"
 
-struct pcie_ernic_dev_mem_allocator *init_dev_mem_allocator(
-    const char *dev_mem_bar_filename, uint64_t dev_mem_bar_size,
-    uint64_t dev_mem_global_offset, uint64_t dev_mem_segment_offset) {
+// Free blocks smaller than this are not split off the end of an allocation,
+// they are handed out with it instead
+#define DEV_MEM_MIN_BLOCK_SIZE 64
+
+static unsigned dev_mem_size_class(uint64_t size) {
+  unsigned size_class = 63 - __builtin_clzll(size);
+  if (size_class >= DEV_MEM_NUM_SIZE_CLASSES)
+    size_class = DEV_MEM_NUM_SIZE_CLASSES - 1;
+  return size_class;
+}
+
+static void dev_mem_free_list_insert(
+    struct pcie_ernic_dev_mem_allocator *allocator,
+    struct dev_mem_block *block) {
+  unsigned size_class = dev_mem_size_class(block->size);
+  block->free = true;
+  block->free_prev = NULL;
+  block->free_next = allocator->free_lists[size_class];
+  if (block->free_next != NULL)
+    block->free_next->free_prev = block;
+  allocator->free_lists[size_class] = block;
+}
+
+static void dev_mem_free_list_remove(
+    struct pcie_ernic_dev_mem_allocator *allocator,
+    struct dev_mem_block *block) {
+  if (block->free_prev != NULL)
+    block->free_prev->free_next = block->free_next;
+  else
+    allocator->free_lists[dev_mem_size_class(block->size)] = block->free_next;
+  if (block->free_next != NULL)
+    block->free_next->free_prev = block->free_prev;
+  block->free = false;
+  block->free_prev = NULL;
+  block->free_next = NULL;
+}
+
+// Splits the first `size` bytes of `block` off into their own block, and
+// returns the block holding the rest. Neither block is put on a free list.
+static struct dev_mem_block *dev_mem_split_block(struct dev_mem_block *block,
+                                                 uint64_t size) {
+  struct dev_mem_block *rest =
+      (struct dev_mem_block *)malloc(sizeof(struct dev_mem_block));
+  if (rest == NULL)
+    return NULL;
+  rest->offset = block->offset + size;
+  rest->size = block->size - size;
+  rest->free = false;
+  rest->prev = block;
+  rest->next = block->next;
+  rest->free_prev = NULL;
+  rest->free_next = NULL;
+  if (block->next != NULL)
+    block->next->prev = rest;
+  block->next = rest;
+  block->size = size;
+  return rest;
+}
+
+// Merges `block` with the block following it in address order
+static void dev_mem_merge_next(struct dev_mem_block *block) {
+  struct dev_mem_block *next = block->next;
+  block->size += next->size;
+  block->next = next->next;
+  if (next->next != NULL)
+    next->next->prev = block;
+  free(next);
+}
+
+static struct pcie_ernic_dev_mem_allocator *
+init_dev_mem_allocator_common(void *dev_mem, uint64_t dev_mem_size,
+                              uint64_t dev_mem_global_offset,
+                              uint64_t dev_mem_segment_offset) {
+
+  if (dev_mem_segment_offset >= dev_mem_size) {
+    printf("[ERROR] Device memory segment offset 0x%lx is outside of the %lu "
+           "bytes of device memory\n",
+           dev_mem_segment_offset, dev_mem_size);
+    return NULL;
+  }
 
   // Allocating memory for allocator structure
   struct pcie_ernic_dev_mem_allocator *allocator =
-      (struct pcie_ernic_dev_mem_allocator *)malloc(
-          sizeof(struct pcie_ernic_dev_mem_allocator));
+      (struct pcie_ernic_dev_mem_allocator *)calloc(
+          1, sizeof(struct pcie_ernic_dev_mem_allocator));
+  if (allocator == NULL) {
+    printf("[ERROR] Out of memory, couldn't allocate device memory "
+           "allocator\n");
+    return NULL;
+  }
 
   // Initialize components of the allocator
-  allocator->dev_mem_bar_filename = dev_mem_bar_filename;
+  allocator->dev_mem = dev_mem;
   allocator->dev_mem_ptr = 0;
-  allocator->dev_mem_size = dev_mem_bar_size;
+  allocator->dev_mem_size = dev_mem_size;
   allocator->segment_offset = dev_mem_segment_offset;
   allocator->global_offset = dev_mem_global_offset;
+  allocator->alignment = DEV_MEM_DEFAULT_ALIGNMENT;
+
+  // The whole segment starts out as a single free block
+  struct dev_mem_block *block =
+      (struct dev_mem_block *)calloc(1, sizeof(struct dev_mem_block));
+  if (block == NULL) {
+    printf("[ERROR] Out of memory, couldn't allocate device memory block\n");
+    free(allocator);
+    return NULL;
+  }
+  block->offset = 0;
+  block->size = dev_mem_size - dev_mem_segment_offset;
+  allocator->blocks = block;
+  dev_mem_free_list_insert(allocator, block);
 
-  // Map the
+  return allocator;
+}
+
+struct pcie_ernic_dev_mem_allocator *init_dev_mem_allocator(
+    const char *dev_mem_bar_filename, uint64_t dev_mem_bar_size,
+    uint64_t dev_mem_global_offset, uint64_t dev_mem_segment_offset) {
+
+  // Map the device memory BAR into userspace
   int axib_fd;
   if ((axib_fd = open(dev_mem_bar_filename, O_RDWR | O_SYNC)) == -1) {
     printf("[ERROR] Failed to open device file: %s\n", dev_mem_bar_filename);
@@ -46,12 +149,28 @@ struct pcie_ernic_dev_mem_allocator *init_dev_mem_allocator(
 
   printf("Opening %s with size %lu\n", dev_mem_bar_filename, dev_mem_bar_size);
 
-  allocator->dev_mem = mmap(NULL,                   // virtual address
-                            dev_mem_bar_size,       // length
-                            PROT_READ | PROT_WRITE, // prot
-                            MAP_SHARED,             // flags
-                            axib_fd,                // device fd
-                            0);
+  void *dev_mem = mmap(NULL,                   // virtual address
+                       dev_mem_bar_size,       // length
+                       PROT_READ | PROT_WRITE, // prot
+                       MAP_SHARED,             // flags
+                       axib_fd,                // device fd
+                       0);
+  close(axib_fd);
+  if (dev_mem == MAP_FAILED) {
+    printf("[ERROR] Failed to map device file: %s\n", dev_mem_bar_filename);
+    return NULL;
+  }
+
+  struct pcie_ernic_dev_mem_allocator *allocator =
+      init_dev_mem_allocator_common(dev_mem, dev_mem_bar_size,
+                                    dev_mem_global_offset,
+                                    dev_mem_segment_offset);
+  if (allocator == NULL) {
+    munmap(dev_mem, dev_mem_bar_size);
+    return NULL;
+  }
+  allocator->dev_mem_bar_filename = dev_mem_bar_filename;
+  allocator->owns_dev_mem = true;
 
   printf("[INFO] Device memory mapped into userspace\n");
   printf("\tVA: %p\n", allocator->dev_mem);
@@ -62,13 +181,39 @@ struct pcie_ernic_dev_mem_allocator *init_dev_mem_allocator(
   return allocator;
 }
 
+struct pcie_ernic_dev_mem_allocator *init_dev_mem_allocator_with_mem(
+    void *dev_mem, uint64_t dev_mem_size, uint64_t dev_mem_global_offset,
+    uint64_t dev_mem_segment_offset) {
+
+  if (dev_mem == NULL) {
+    printf("[ERROR] init_dev_mem_allocator_with_mem given NULL memory\n");
+    return NULL;
+  }
+
+  return init_dev_mem_allocator_common(
+      dev_mem, dev_mem_size, dev_mem_global_offset, dev_mem_segment_offset);
+}
+
 void free_dev_mem_allocator(struct pcie_ernic_dev_mem_allocator *allocator) {
 
-  // Setting device memory pointer to zero
-  allocator->dev_mem_ptr = 0;
+  if (allocator == NULL)
+    return;
+
+#ifdef VERBOSE_DEBUG
+  dev_mem_print_stats(allocator);
+#endif
+
+  // Releasing the block bookkeeping
+  struct dev_mem_block *block = allocator->blocks;
+  while (block != NULL) {
+    struct dev_mem_block *next = block->next;
+    free(block);
+    block = next;
+  }
 
-  // Unmapping the device memory
-  if (munmap(allocator->dev_mem, allocator->dev_mem_size) == -1) {
+  // Unmapping the device memory if we mapped it
+  if (allocator->owns_dev_mem &&
+      munmap(allocator->dev_mem, allocator->dev_mem_size) == -1) {
     printf("[ERROR] Failed to unmap device memory\n");
   }
 
@@ -80,14 +225,15 @@ void free_dev_mem_allocator(struct pcie_ernic_dev_mem_allocator *allocator) {
 #endif
 }
 
-// Allocating memory on the device. Since we are treating the memory just like a
-// stack, this is pretty straightforward as we are just giving the user the
-// next portion of memory equal to the size that they want. Also, if user gives
-// a non NULL uint64_t pointer, we will provide the PA which is useful for some
-// applications to know -- Note the PA is the physical address in the device
-// memory map, not the memory map of the CPU.
-void *dev_mem_alloc(struct pcie_ernic_dev_mem_allocator *allocator,
-                    uint32_t size, uint64_t *pa) {
+// Allocating memory on the device. The free lists are searched from the size
+// class of the request upwards for the first block which can hold the request
+// once its start is aligned. Any alignment padding in front and any large
+// enough remainder behind the allocation are returned to the free lists. Also,
+// if user gives a non NULL uint64_t pointer, we will provide the PA which is
+// useful for some applications to know -- Note the PA is the physical address
+// in the device memory map, not the memory map of the CPU.
+void *dev_mem_alloc_aligned(struct pcie_ernic_dev_mem_allocator *allocator,
+                            uint64_t size, uint64_t alignment, uint64_t *pa) {
 
   // Making sure we are given a real allocator
   if (allocator == NULL) {
@@ -95,32 +241,178 @@ void *dev_mem_alloc(struct pcie_ernic_dev_mem_allocator *allocator,
     return NULL;
   }
 
+  if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    printf("[ERROR] dev_mem_alloc given invalid size %lu or alignment %lu\n",
+           size, alignment);
+    return NULL;
+  }
+
+  // Alignment is with respect to the PA the device will use
+  uint64_t base_pa = allocator->segment_offset + allocator->global_offset;
+  struct dev_mem_block *block = NULL;
+  uint64_t padding = 0;
+  for (unsigned size_class = dev_mem_size_class(size);
+       size_class < DEV_MEM_NUM_SIZE_CLASSES && block == NULL; size_class++) {
+    for (struct dev_mem_block *candidate = allocator->free_lists[size_class];
+         candidate != NULL; candidate = candidate->free_next) {
+      uint64_t start = base_pa + candidate->offset;
+      padding = ((start + alignment - 1) & ~(alignment - 1)) - start;
+      if (candidate->size >= size && candidate->size - size >= padding) {
+        block = candidate;
+        break;
+      }
+    }
+  }
+
   // Making sure we have enough space on the device
-  if (size + allocator->dev_mem_ptr + allocator->segment_offset >
-      allocator->dev_mem_size) {
+  if (block == NULL) {
     printf("[ERROR] Device memory cannot accept this allocation due to lack of "
            "space\n");
     return NULL;
   }
 
+  dev_mem_free_list_remove(allocator, block);
+
+  // Give the alignment padding back to the free lists
+  if (padding != 0) {
+    struct dev_mem_block *aligned = dev_mem_split_block(block, padding);
+    if (aligned == NULL) {
+      dev_mem_free_list_insert(allocator, block);
+      printf("[ERROR] Out of memory, couldn't allocate device memory block\n");
+      return NULL;
+    }
+    dev_mem_free_list_insert(allocator, block);
+    block = aligned;
+  }
+
+  // Give the remainder back to the free lists, if it is worth keeping track of
+  if (block->size - size >= DEV_MEM_MIN_BLOCK_SIZE) {
+    struct dev_mem_block *rest = dev_mem_split_block(block, size);
+    if (rest != NULL)
+      dev_mem_free_list_insert(allocator, rest);
+  }
+
+  // Bookkeeping
+  allocator->bytes_in_use += block->size;
+  if (allocator->bytes_in_use > allocator->high_water_mark)
+    allocator->high_water_mark = allocator->bytes_in_use;
+  if (block->offset + block->size > allocator->dev_mem_ptr)
+    allocator->dev_mem_ptr = block->offset + block->size;
+  allocator->num_allocs++;
+
   // If user provided valid pointer, give the physical address
   if (pa != NULL) {
-    *pa = allocator->dev_mem_ptr + allocator->segment_offset +
-          allocator->global_offset /*DEV_MEM_OFFSET*/;
+    *pa = base_pa + block->offset;
   }
 
-  // Setting the user pointer equal to the next portion
-  // of available memory
   void *user_ptr = (void *)((unsigned char *)allocator->dev_mem +
-                            allocator->segment_offset + allocator->dev_mem_ptr);
+                            allocator->segment_offset + block->offset);
 
 #ifdef VERBOSE_DEBUG
-  printf("Giving user %dB starting at dev_mem[0x%lx]\n", size,
-         allocator->dev_mem_ptr + allocator->segment_offset);
+  printf("Giving user %luB starting at dev_mem[0x%lx]\n", size,
+         block->offset + allocator->segment_offset);
 #endif
 
-  // Incrementing pointer by the size of memory allocated
-  allocator->dev_mem_ptr += size;
-
   return user_ptr;
 }
+
+void *dev_mem_alloc(struct pcie_ernic_dev_mem_allocator *allocator,
+                    uint32_t size, uint64_t *pa) {
+
+  if (allocator == NULL) {
+    printf("[ERROR] dev_mem_alloc given NULL allocator\n");
+    return NULL;
+  }
+
+  return dev_mem_alloc_aligned(allocator, size, allocator->alignment, pa);
+}
+
+// Returning memory to the device. The block is coalesced with its free
+// neighbours in address order before being put back on a free list.
+void dev_mem_free(struct pcie_ernic_dev_mem_allocator *allocator, void *ptr) {
+
+  if (allocator == NULL) {
+    printf("[ERROR] dev_mem_free given NULL allocator\n");
+    return;
+  }
+
+  if (ptr == NULL)
+    return;
+
+  uint64_t offset = (unsigned char *)ptr - (unsigned char *)allocator->dev_mem -
+                    allocator->segment_offset;
+  struct dev_mem_block *block = allocator->blocks;
+  while (block != NULL && block->offset != offset)
+    block = block->next;
+  if (block == NULL || block->free) {
+    printf("[ERROR] dev_mem_free given %p which is not an allocation\n", ptr);
+    return;
+  }
+
+  allocator->bytes_in_use -= block->size;
+  allocator->num_frees++;
+
+  if (block->next != NULL && block->next->free) {
+    dev_mem_free_list_remove(allocator, block->next);
+    dev_mem_merge_next(block);
+  }
+  if (block->prev != NULL && block->prev->free) {
+    block = block->prev;
+    dev_mem_free_list_remove(allocator, block);
+    dev_mem_merge_next(block);
+  }
+  dev_mem_free_list_insert(allocator, block);
+
+#ifdef VERBOSE_DEBUG
+  printf("Freeing user memory at dev_mem[0x%lx]\n",
+         offset + allocator->segment_offset);
+#endif
+}
+
+void dev_mem_get_stats(struct pcie_ernic_dev_mem_allocator *allocator,
+                       struct pcie_ernic_dev_mem_stats *stats) {
+
+  if (allocator == NULL || stats == NULL) {
+    printf("[ERROR] dev_mem_get_stats given NULL allocator or stats\n");
+    return;
+  }
+
+  memset(stats, 0, sizeof(struct pcie_ernic_dev_mem_stats));
+  stats->capacity = allocator->dev_mem_size - allocator->segment_offset;
+  stats->bytes_in_use = allocator->bytes_in_use;
+  stats->high_water_mark = allocator->high_water_mark;
+  stats->num_allocs = allocator->num_allocs;
+  stats->num_frees = allocator->num_frees;
+  for (unsigned size_class = 0; size_class < DEV_MEM_NUM_SIZE_CLASSES;
+       size_class++) {
+    for (struct dev_mem_block *block = allocator->free_lists[size_class];
+         block != NULL; block = block->free_next) {
+      stats->bytes_free += block->size;
+      stats->num_free_blocks++;
+      if (block->size > stats->largest_free_block)
+        stats->largest_free_block = block->size;
+    }
+  }
+  if (stats->bytes_free != 0)
+    stats->fragmentation =
+        1.0 - (double)stats->largest_free_block / (double)stats->bytes_free;
+}
+
+void dev_mem_print_stats(struct pcie_ernic_dev_mem_allocator *allocator) {
+
+  if (allocator == NULL)
+    return;
+
+  struct pcie_ernic_dev_mem_stats stats;
+  dev_mem_get_stats(allocator, &stats);
+
+  printf("[INFO] Device memory allocator\n");
+  printf("\tCapacity: %lu\n", stats.capacity);
+  printf("\tIn use: %lu\n", stats.bytes_in_use);
+  printf("\tFree: %lu in %lu blocks\n", stats.bytes_free,
+         stats.num_free_blocks);
+  printf("\tLargest free block: %lu\n", stats.largest_free_block);
+  printf("\tFragmentation: %.3f\n", stats.fragmentation);
+  printf("\tHigh-water mark: %lu\n", stats.high_water_mark);
+  printf("\tAllocations: %lu Frees: %lu\n", stats.num_allocs, stats.num_frees);
+}
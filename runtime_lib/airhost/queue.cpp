@@ -24,10 +24,10 @@
 #include "air_host_impl.h"
 #include "air_queue.h"
 #include "airbin.h"
+#include "airbin_loader.h"
 #include "hsa/hsa.h"
 #include "hsa/hsa_ext_amd.h"
 #include "hsa_ext_air.h"
-#include <gelf.h>
 
 #define DEBUG_QUEUE
 
@@ -38,6 +38,8 @@
 #define DBG_PRINT(...)
 #endif // DEBUG_QUEUE
 
+// Define DEBUG_AIRBIN to print how long each AIRBIN section took to load
+
 #define ALIGN(_x, _size) (((_x) + ((_size)-1)) & ~((_size)-1))
 
 hsa_status_t air_get_agent_info(hsa_agent_t *agent, hsa_queue_t *queue,
@@ -478,172 +480,93 @@ hsa_status_t air_packet_load_airbin(hsa_agent_dispatch_packet_t *pkt,
   return HSA_STATUS_SUCCESS;
 }
 
-/*
-  Load an airbin from a file into a device
-*/
-hsa_status_t air_load_airbin(hsa_agent_t *agent, hsa_queue_t *q,
-                             const char *filename, uint8_t column,
-                             uint32_t device_id) {
-  hsa_status_t ret = HSA_STATUS_SUCCESS;
-  int drv_fd = 0, elf_fd = 0;
-  uint32_t dram_size;
-  uint8_t *dram_ptr = NULL;
-  uint8_t *data_ptr = NULL;
-  struct timespec ts_start;
-  struct timespec ts_end;
-  Elf *inelf = NULL;
-  GElf_Ehdr *ehdr = NULL;
-  GElf_Ehdr ehdr_mem;
-  uint64_t wr_idx = 0;
-  hsa_agent_dispatch_packet_t pkt;
-  size_t shnum;
-  uint32_t table_idx = 0;
-  airbin_table_entry *airbin_table;
-  uint32_t data_offset = 0;
-  uint32_t table_size = 0;
-  struct stat elf_stat;
-
-  auto time_spec_diff = [](struct timespec &start, struct timespec &end) {
-    return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
-  };
-
-  DBG_PRINT("%s fname=%s col=%u\r\n", __func__, filename, column);
-
-  // open the AIRBIN file
-  elf_fd = open(filename, O_RDONLY);
-  if (elf_fd < 0) {
-    printf("Can't open %s\n", filename);
-    ret = HSA_STATUS_ERROR_INVALID_FILE;
-    goto err_elf_open;
+namespace {
+
+// Submits AIRBIN tables as load packets on an AIR queue. All packets share a
+// single completion signal, created with one count per packet, so the number
+// of tables the device finished with can be read back from it.
+class HsaAirbinLoadQueue : public air::AirbinLoadQueue {
+public:
+  HsaAirbinLoadQueue(hsa_agent_t *agent, hsa_queue_t *q, uint16_t column,
+                     uint32_t num_packets)
+      : q_(q), column_(column), num_packets_(num_packets) {
+    hsa_amd_signal_create_on_agent(num_packets, 0, nullptr, agent, 0,
+                                   &signal_);
   }
-
-  // calculate the size needed to load
-  fstat(elf_fd, &elf_stat);
-  // dram_size = elf_stat.st_size;
-  dram_size = 6 * 1024 * 1024;
-  if (table_size > dram_size) {
-    printf("[ERROR] table size is larger than allocated DRAM. Exiting\n");
-    ret = HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-    goto err_elf_open;
+  ~HsaAirbinLoadQueue() { hsa_signal_destroy(signal_); }
+
+  bool Submit(airbin_table_entry *table) override {
+    // don't overrun packets the device has not picked up yet
+    while (submitted_ - Completed() >= q_->size - 1)
+      ;
+    submitted_++;
+
+    uint64_t wr_idx = hsa_queue_add_write_index_relaxed(q_, 1);
+    hsa_agent_dispatch_packet_t pkt;
+    air_packet_load_airbin(&pkt, (uint64_t)table, column_);
+    pkt.completion_signal = signal_;
+    return air_queue_dispatch(q_, wr_idx % q_->size, wr_idx, &pkt) ==
+           HSA_STATUS_SUCCESS;
   }
 
-  // get some DRAM from the device
-  dram_ptr = (uint8_t *)air_malloc(dram_size);
-
-  if (dram_ptr == MAP_FAILED) {
-    printf("Error allocating %u DRAM\n", dram_size);
-    ret = HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-    goto err_dev_mem_alloc;
+  uint32_t Completed() override {
+    return num_packets_ - hsa_signal_load_scacquire(signal_);
   }
 
-  DBG_PRINT("Allocated %u device memory HVA=0x%lx\r\n", dram_size,
-            (uint64_t)dram_ptr);
-
-  // check the characteristics
-  elf_version(EV_CURRENT);
-  inelf = elf_begin(elf_fd, ELF_C_READ, NULL);
-  ehdr = gelf_getehdr(inelf, &ehdr_mem);
-  if (ehdr == NULL) {
-    printf("cannot get ELF header: %s\n", elf_errmsg(-1));
-    ret = HSA_STATUS_ERROR_INVALID_FILE;
-    goto err_elf_read;
-  }
+private:
+  hsa_queue_t *q_;
+  uint16_t column_;
+  uint32_t num_packets_;
+  uint32_t submitted_ = 0;
+  hsa_signal_t signal_;
+};
 
-  // Read data as 64-bit little endian
-  if ((ehdr->e_ident[EI_CLASS] != ELFCLASS64) ||
-      (ehdr->e_ident[EI_DATA] != ELFDATA2LSB)) {
-    printf("unexpected ELF format\n");
-    ret = HSA_STATUS_ERROR_INVALID_FILE;
-    goto err_elf_read;
-  }
+} // namespace
 
-  if (elf_getshdrnum(inelf, &shnum) != 0) {
-    printf("cannot get program header count: %s", elf_errmsg(-1));
-    ret = HSA_STATUS_ERROR_INVALID_FILE;
-    goto err_elf_read;
-  }
+/*
+  Load an airbin from a file into a device
+*/
+hsa_status_t air_load_airbin(hsa_agent_t *agent, hsa_queue_t *q,
+                             const char *filename, uint8_t column,
+                             uint32_t device_id, size_t chunk_size) {
+  DBG_PRINT("%s fname=%s col=%u\r\n", __func__, filename, column);
 
-  /*
-    Even though not all sections are loadable, we use the section count as an
-    upper bound for how much memory the table will take. We can then safely
-    place data after that point and avoid any conflicts. A small amount of
-    memory will be wasted but it is usually only two entries (32 bytes) so
-    not a big deal. This allows us to do only a single pass on the ELF
-    sections so it seems like a good trade-off.
-  */
-  DBG_PRINT("There are %lu sections\n", shnum);
-  table_size = shnum * sizeof(airbin_table_entry);
-  airbin_table = (airbin_table_entry *)dram_ptr;
-  data_offset = table_size; // The data offset starts at the end of the table
-  data_ptr = dram_ptr + table_size;
-
-  // Iterate through all sections to create a table in device-readable format.
-  for (unsigned int ndx = 0; ndx < shnum; ndx++) {
-    GElf_Shdr shdr;
-    Elf_Scn *sec = elf_getscn(inelf, ndx);
-    if (sec == NULL) {
-      printf("cannot get section %d: %s", ndx, elf_errmsg(-1));
-      ret = HSA_STATUS_ERROR_INVALID_FILE;
-      goto err_elf_read;
-    }
-
-    gelf_getshdr(sec, &shdr);
-
-    // for each loadable program header
-    if (shdr.sh_type != SHT_PROGBITS || !(shdr.sh_flags & SHF_ALLOC))
-      continue;
-
-    // copy the data from into device memory
-    Elf_Data *desc;
-    desc = elf_getdata(sec, NULL);
-    if (!desc) {
-      printf("Error reading data for section %u\n", ndx);
-      ret = HSA_STATUS_ERROR_INVALID_FILE;
-      goto err_elf_read;
-    }
-    memcpy(data_ptr, desc->d_buf, desc->d_size);
-
-    airbin_table[table_idx].offset = data_offset;
-    airbin_table[table_idx].size = shdr.sh_size;
-    airbin_table[table_idx].addr = shdr.sh_addr;
-    DBG_PRINT("table[%u] VA=0x%lx offset=0x%lx size=0x%lx addr=0x%lx\n",
-              table_idx, (uint64_t)data_ptr, (uint64_t)data_offset,
-              shdr.sh_size, shdr.sh_addr);
-
-    table_idx++;
-    data_offset += shdr.sh_size;
-    data_ptr += shdr.sh_size;
-
-    if (data_offset > dram_size) {
-      printf("[ERROR] Overwriting allocated DRAM size. Exiting\n");
-      ret = HSA_STATUS_ERROR_OUT_OF_RESOURCES;
-      goto err_elf_read;
-    }
+  // map the AIRBIN file, sections are streamed straight out of the mapping
+  air::AirbinImage image;
+  if (!image.Open(filename))
+    return HSA_STATUS_ERROR_INVALID_FILE;
+
+  air::AirbinLoader loader(image, chunk_size);
+  size_t dram_size = loader.StagingSize();
+  DBG_PRINT("There are %lu loadable sections in %u batches\n",
+            image.sections().size(), loader.NumBatches());
+  if (loader.NumBatches() == 0)
+    return HSA_STATUS_SUCCESS;
+
+  // get exactly as much DRAM from the device as the sections need
+  uint8_t *dram_ptr = (uint8_t *)air_malloc(dram_size);
+  if (dram_ptr == NULL) {
+    printf("Error allocating %lu DRAM\n", dram_size);
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
   }
 
-  // the last entry must be all 0's
-  airbin_table[table_idx].offset = 0;
-  airbin_table[table_idx].size = 0;
-  airbin_table[table_idx].addr = 0;
-
-  // Send configuration packet
-  DBG_PRINT("Notifying device\n");
-  wr_idx = hsa_queue_add_write_index_relaxed(q, 1);
-  air_packet_load_airbin(&pkt, (uint64_t)airbin_table, (uint16_t)column);
+  DBG_PRINT("Allocated %lu device memory HVA=0x%lx\r\n", dram_size,
+            (uint64_t)dram_ptr);
 
-  // clock_gettime(CLOCK_BOOTTIME, &ts_start);
-  air_queue_dispatch_and_wait(agent, q, wr_idx % q->size, wr_idx, &pkt);
-  hsa_signal_destroy(pkt.completion_signal);
-  // clock_gettime(CLOCK_BOOTTIME, &ts_end);
+  // With batching, each batch of sections is handed to the device as soon as
+  // it is copied
+  HsaAirbinLoadQueue load_queue(agent, q, column, loader.NumBatches());
+  hsa_status_t ret = HSA_STATUS_SUCCESS;
+  if (!loader.Load(dram_ptr, &load_queue))
+    ret = HSA_STATUS_ERROR;
 
-  // printf("airbin loading time: %0.8f sec\n", time_spec_diff(ts_start,
-  // ts_end));
+#ifdef DEBUG_AIRBIN
+  loader.PrintTimings();
+#endif
 
-err_elf_read:
-  elf_end(inelf);
-  close(elf_fd);
+  // The device is done reading the airbin once the load packets completed, so
+  // the staging buffer goes back to the runtime's cache for the next load
+  air_free(dram_ptr);
 
-err_elf_open:
-err_dev_mem_alloc:
   return ret;
 }
@@ -19,17 +19,80 @@ void Runtime::Init() {
   runtime_->InitMemSegments();
 }
 
-void Runtime::ShutDown() { delete runtime_; }
+void Runtime::ShutDown() {
+  delete runtime_;
+  runtime_ = nullptr;
+}
 
 void *Runtime::AllocateMemory(size_t size) {
+  return mem_pool_->Allocate(size);
+}
+
+void Runtime::FreeMemory(void *ptr) {
+  if (!mem_pool_->Free(ptr)) {
+    debug_print("Runtime: freeing memory not allocated by the runtime");
+    hsa_amd_memory_pool_free(ptr);
+  }
+}
+
+void Runtime::TrimMemory(size_t max_cached_bytes) {
+  mem_pool_->Trim(max_cached_bytes);
+}
+
+void Runtime::SetMemoryCacheLimit(size_t cache_limit) {
+  mem_pool_->SetCacheLimit(cache_limit);
+}
+
+MemoryPoolStats Runtime::GetMemoryStats() { return mem_pool_->GetStats(); }
+
+void *Runtime::HsaMemoryPoolBackend::Allocate(size_t size) {
   void *mem(nullptr);
 
-  hsa_amd_memory_pool_allocate(global_mem_pool_, size, 0, &mem);
+  hsa_amd_memory_pool_allocate(pool_, size, 0, &mem);
 
   return mem;
 }
 
-void Runtime::FreeMemory(void *ptr) { hsa_amd_memory_pool_free(ptr); }
+void Runtime::HsaMemoryPoolBackend::Free(void *ptr) {
+  hsa_amd_memory_pool_free(ptr);
+}
+
+hsa_signal_t Runtime::AcquireSignal(hsa_agent_t agent,
+                                    hsa_signal_value_t value) {
+  return {signal_pool_.Acquire(agent.handle, value)};
+}
+
+void Runtime::RetainSignal(hsa_signal_t signal) {
+  signal_pool_.Retain(signal.handle);
+}
+
+void Runtime::ReleaseSignal(hsa_signal_t signal) {
+  if (!signal_pool_.Release(signal.handle))
+    debug_print("Runtime: releasing signal not acquired from the runtime");
+}
+
+SignalPoolStats Runtime::GetSignalStats() { return signal_pool_.GetStats(); }
+
+uint64_t Runtime::HsaSignalPoolBackend::Create(uint64_t agent, int64_t value) {
+  hsa_agent_t hsa_agent = {agent};
+  hsa_signal_t signal = {0};
+
+  hsa_amd_signal_create_on_agent(value, 0, nullptr, &hsa_agent, 0, &signal);
+
+  return signal.handle;
+}
+
+void Runtime::HsaSignalPoolBackend::Destroy(uint64_t signal) {
+  hsa_signal_destroy({signal});
+}
+
+int64_t Runtime::HsaSignalPoolBackend::Load(uint64_t signal) {
+  return hsa_signal_load_scacquire({signal});
+}
+
+void Runtime::HsaSignalPoolBackend::Store(uint64_t signal, int64_t value) {
+  hsa_signal_store_screlease({signal}, value);
+}
 
 hsa_status_t Runtime::IterateAgents(hsa_agent_t agent, void *data) {
   hsa_status_t status(HSA_STATUS_SUCCESS);
@@ -79,6 +142,10 @@ void Runtime::InitMemSegments() {
   hsa_amd_agent_iterate_memory_pools(
       aie_agents_.front(), &Runtime::IterateMemPool,
       reinterpret_cast<void *>(&global_mem_pool_));
+
+  mem_pool_.reset();
+  mem_pool_backend_ = std::make_unique<HsaMemoryPoolBackend>(global_mem_pool_);
+  mem_pool_ = std::make_unique<MemoryPool>(mem_pool_backend_.get());
 }
 
 } // namespace rocm
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+
+#include "signal_pool.h"
+
+namespace air {
+namespace rocm {
+
+SignalPool::~SignalPool() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &[agent, signals] : pool_)
+    for (uint64_t signal : signals)
+      backend_->Destroy(signal);
+  // Pending signals may still be written by the device, but nothing will
+  // wait on them any more
+  for (auto &[signal, agent] : pending_)
+    backend_->Destroy(signal);
+}
+
+uint64_t SignalPool::Acquire(uint64_t agent, int64_t value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.acquired++;
+
+  auto &free_signals = pool_[agent];
+  if (free_signals.empty())
+    CollectPendingLocked();
+
+  uint64_t signal(0);
+  if (!free_signals.empty()) {
+    signal = free_signals.back();
+    free_signals.pop_back();
+    backend_->Store(signal, value);
+    stats_.reused++;
+    stats_.pooled--;
+  } else {
+    signal = backend_->Create(agent, value);
+    if (!signal)
+      return 0;
+    stats_.created++;
+  }
+
+  live_[signal] = {agent, 1};
+  stats_.live++;
+  return signal;
+}
+
+void SignalPool::Retain(uint64_t signal) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = live_.find(signal);
+  if (it != live_.end())
+    it->second.refs++;
+}
+
+bool SignalPool::Release(uint64_t signal) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = live_.find(signal);
+  if (it == live_.end())
+    return false;
+  if (--it->second.refs)
+    return true;
+
+  uint64_t agent = it->second.agent;
+  live_.erase(it);
+  stats_.live--;
+  if (backend_->Load(signal) == 0) {
+    pool_[agent].push_back(signal);
+    stats_.pooled++;
+  } else {
+    pending_.push_back({signal, agent});
+    stats_.pending++;
+  }
+  return true;
+}
+
+void SignalPool::Trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CollectPendingLocked();
+  for (auto &[agent, signals] : pool_) {
+    for (uint64_t signal : signals)
+      backend_->Destroy(signal);
+    stats_.destroyed += signals.size();
+    stats_.pooled -= signals.size();
+    signals.clear();
+  }
+}
+
+SignalPoolStats SignalPool::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void SignalPool::CollectPendingLocked() {
+  for (size_t i = 0; i < pending_.size();) {
+    auto [signal, agent] = pending_[i];
+    if (backend_->Load(signal) != 0) {
+      i++;
+      continue;
+    }
+    pool_[agent].push_back(signal);
+    pending_[i] = pending_.back();
+    pending_.pop_back();
+    stats_.pending--;
+    stats_.pooled++;
+  }
+}
+
+} // namespace rocm
+} // namespace air
@@ -0,0 +1,240 @@
+//===- test.cpp -------------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// Exercises the pipelined posting used by air_send/air_recv against a
+// loopback stand-in for the ERNIC queue, so it runs without any hardware. The
+// completion signals come from the runtime's signal pool, backed by plain
+// counters. A device thread copies the RQE sized chunks of posted data
+// packets from a send buffer to a receive buffer, completing them out of
+// order, and decrements each packet's completion signal.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "air_rdma_pipeline.h"
+#include "signal_pool.h"
+
+#define RQE_SIZE 256
+
+using air::rocm::SignalPool;
+using air::rocm::SignalPoolBackend;
+using air::rocm::SignalPoolStats;
+
+int errors = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("[ERROR] %s:%d: %s\n", __FILE__, __LINE__, #cond);                \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+// Signal values shared between the host and the device thread
+class CounterBackend : public SignalPoolBackend {
+public:
+  uint64_t Create(uint64_t /*agent*/, int64_t value) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    values[next] = value;
+    return next++;
+  }
+
+  void Destroy(uint64_t signal) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    values.erase(signal);
+  }
+
+  int64_t Load(uint64_t signal) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    return values[signal];
+  }
+
+  void Store(uint64_t signal, int64_t value) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    values[signal] = value;
+    cv.notify_all();
+  }
+
+  void Decrement(uint64_t signal) {
+    std::lock_guard<std::mutex> lock(mutex);
+    values[signal]--;
+    cv.notify_all();
+  }
+
+  void WaitForZero(uint64_t signal) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return values[signal] == 0; });
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::map<uint64_t, int64_t> values;
+  uint64_t next = 1;
+};
+
+class LoopbackTransport {
+public:
+  LoopbackTransport(CounterBackend &signals, SignalPool &pool,
+                    const uint8_t *src, uint8_t *dst, uint32_t size,
+                    uint32_t depth)
+      : signals(signals), pool(pool), src(src), dst(dst), size(size),
+        depth(depth), num_packets(air::rdma::num_chunks(size, RQE_SIZE)),
+        device([this]() { run(); }) {}
+
+  ~LoopbackTransport() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+    }
+    cv.notify_all();
+    device.join();
+  }
+
+  uint64_t acquire_signal() { return pool.Acquire(/*agent=*/1, 1); }
+
+  void release_signal(uint64_t signal) { CHECK(pool.Release(signal)); }
+
+  void post(uint32_t index, uint64_t signal) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index == num_packets) {
+      // The closing packet must only be posted once all data arrived
+      closing_posted_early = completed != num_packets;
+    } else {
+      uint32_t in_flight = posted - completed;
+      max_in_flight = std::max(max_in_flight, in_flight + 1);
+      // The ERNIC queue would overflow
+      if (in_flight + 1 > depth)
+        overflows++;
+    }
+    posted++;
+    queue.push_back({index, signal});
+    cv.notify_all();
+  }
+
+  void wait(uint64_t signal) { signals.WaitForZero(signal); }
+
+  uint32_t max_in_flight = 0;
+  uint32_t overflows = 0;
+  bool closing_posted_early = false;
+
+private:
+  // Completes the newest posted packet first, so packets complete out of
+  // order whenever more than one is in flight
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&]() { return done || !queue.empty(); });
+      if (queue.empty())
+        return;
+      auto [index, signal] = queue.back();
+      queue.pop_back();
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      if (index < num_packets) {
+        uint32_t offset = index * RQE_SIZE;
+        memcpy(dst + offset, src + offset,
+               std::min<uint32_t>(RQE_SIZE, size - offset));
+      }
+      lock.lock();
+      if (index < num_packets)
+        completed++;
+      signals.Decrement(signal);
+    }
+  }
+
+  CounterBackend &signals;
+  SignalPool &pool;
+  const uint8_t *src;
+  uint8_t *dst;
+  uint32_t size;
+  uint32_t depth;
+  uint32_t num_packets;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::pair<uint32_t, uint64_t>> queue;
+  uint32_t posted = 0;
+  uint32_t completed = 0;
+  bool done = false;
+  std::thread device;
+};
+
+static void check_transfer(uint32_t size, uint32_t window) {
+  std::vector<uint8_t> src(size), dst(size, 0);
+  for (uint32_t i = 0; i < size; i++)
+    src[i] = i * 7 + 3;
+
+  CounterBackend signals;
+  SignalPool pool(&signals);
+  uint32_t num_packets = air::rdma::num_chunks(size, RQE_SIZE);
+  {
+    LoopbackTransport transport(signals, pool, src.data(), dst.data(), size,
+                                window);
+    uint64_t done = air::rdma::post_pipelined(transport, num_packets, window);
+    // Only the closing packet's signal is still referenced
+    CHECK(pool.GetStats().live == 1);
+    transport.wait(done);
+    transport.release_signal(done);
+
+    CHECK(dst == src);
+    CHECK(transport.overflows == 0);
+    CHECK(transport.max_in_flight == std::min(num_packets, window));
+    CHECK(!transport.closing_posted_early);
+  }
+
+  // Every signal went back to the pool, and was recycled along the way
+  SignalPoolStats stats = pool.GetStats();
+  CHECK(stats.acquired == num_packets + 1);
+  CHECK(stats.live == 0 && stats.pending == 0);
+  CHECK(stats.created <= std::min(num_packets, window) + 1);
+}
+
+int main() {
+
+  CHECK(air::rdma::num_chunks(1, RQE_SIZE) == 1);
+  CHECK(air::rdma::num_chunks(RQE_SIZE, RQE_SIZE) == 1);
+  CHECK(air::rdma::num_chunks(RQE_SIZE + 1, RQE_SIZE) == 2);
+
+  // Partial last chunk, window smaller and larger than the transfer
+  check_transfer(100 * RQE_SIZE + 17, 16);
+  check_transfer(10 * RQE_SIZE, 256);
+  // A window of one is the old one RQE at a time behaviour
+  check_transfer(8 * RQE_SIZE, 1);
+
+  // A non-blocking transfer hands the closing packet's signal to the caller,
+  // who waits for it, e.g. through air_wait_all, and releases it
+  {
+    uint32_t size = 64 * RQE_SIZE;
+    std::vector<uint8_t> src(size, 1), dst(size, 0);
+    CounterBackend signals;
+    SignalPool pool(&signals);
+    {
+      LoopbackTransport transport(signals, pool, src.data(), dst.data(),
+                                  size, 256);
+      uint64_t done = air::rdma::post_pipelined(transport, 64, 256);
+      CHECK(dst == src);
+      transport.wait(done);
+      CHECK(pool.Release(done));
+    }
+    CHECK(pool.GetStats().live == 0);
+  }
+
+  if (!errors) {
+    printf("PASS!\n");
+    return 0;
+  } else {
+    printf("fail %d.\n", errors);
+    return -1;
+  }
+}
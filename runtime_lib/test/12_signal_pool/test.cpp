@@ -0,0 +1,143 @@
+//===- test.cpp -------------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// Exercises the runtime's completion signal pool against a fake backend
+// standing in for HSA signals, so it runs without any hardware.
+
+#include <cstdio>
+#include <map>
+
+#include "signal_pool.h"
+
+using air::rocm::SignalPool;
+using air::rocm::SignalPoolBackend;
+using air::rocm::SignalPoolStats;
+
+int errors = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("[ERROR] %s:%d: %s\n", __FILE__, __LINE__, #cond);                \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+class FakeBackend : public SignalPoolBackend {
+public:
+  uint64_t Create(uint64_t agent, int64_t value) override {
+    uint64_t signal = next++;
+    values[signal] = value;
+    agents[signal] = agent;
+    return signal;
+  }
+
+  void Destroy(uint64_t signal) override {
+    CHECK(values.count(signal));
+    values.erase(signal);
+  }
+
+  int64_t Load(uint64_t signal) override { return values[signal]; }
+
+  void Store(uint64_t signal, int64_t value) override {
+    values[signal] = value;
+  }
+
+  // The device completing the packet signalling `signal`
+  void Complete(uint64_t signal) { values[signal]--; }
+
+  std::map<uint64_t, int64_t> values;
+  std::map<uint64_t, uint64_t> agents;
+  uint64_t next = 1;
+};
+
+int main() {
+
+  const uint64_t agent = 0x1000;
+  const uint64_t other_agent = 0x2000;
+
+  // A memcpy followed by the air_wait_all retiring it, many times over, only
+  // ever needs two signals: the memcpy's and the barrier's
+  {
+    FakeBackend backend;
+    SignalPool pool(&backend);
+    for (int i = 0; i < 1000; i++) {
+      uint64_t event = pool.Acquire(agent, 1);
+      uint64_t barrier = pool.Acquire(agent, 1);
+      CHECK(backend.values[event] == 1 && backend.values[barrier] == 1);
+      backend.Complete(event);
+      backend.Complete(barrier);
+      CHECK(pool.Release(barrier));
+      CHECK(pool.Release(event));
+    }
+    SignalPoolStats stats = pool.GetStats();
+    CHECK(stats.acquired == 2000);
+    CHECK(stats.created == 2 && stats.reused == 1998);
+    CHECK(stats.live == 0 && stats.pending == 0 && stats.pooled == 2);
+
+    // Signals not from the pool are rejected
+    CHECK(!pool.Release(12345));
+
+    pool.Trim();
+    stats = pool.GetStats();
+    CHECK(stats.pooled == 0 && stats.destroyed == 2);
+    CHECK(backend.values.empty());
+  }
+
+  // A signal released before its packet completed is not reused until then
+  {
+    FakeBackend backend;
+    SignalPool pool(&backend);
+    uint64_t in_flight = pool.Acquire(agent, 1);
+    pool.Release(in_flight);
+    CHECK(pool.GetStats().pending == 1);
+    uint64_t other = pool.Acquire(agent, 1);
+    CHECK(other != in_flight);
+    backend.Complete(in_flight);
+    pool.Release(other);
+    uint64_t reused = pool.Acquire(agent, 1);
+    CHECK(reused == in_flight || reused == other);
+    SignalPoolStats stats = pool.GetStats();
+    CHECK(stats.pending == 1 || stats.pooled == 1);
+    CHECK(stats.live == 1);
+  }
+
+  // References from several consumers
+  {
+    FakeBackend backend;
+    SignalPool pool(&backend);
+    uint64_t event = pool.Acquire(agent, 1);
+    pool.Retain(event);
+    backend.Complete(event);
+    pool.Release(event);
+    CHECK(pool.GetStats().live == 1);
+    pool.Release(event);
+    CHECK(pool.GetStats().live == 0 && pool.GetStats().pooled == 1);
+    // A stale release after the signal was recycled is ignored
+    CHECK(!pool.Release(event));
+  }
+
+  // Signals are only reused on the agent they were created on
+  {
+    FakeBackend backend;
+    SignalPool pool(&backend);
+    uint64_t a = pool.Acquire(agent, 0);
+    pool.Release(a);
+    uint64_t b = pool.Acquire(other_agent, 0);
+    CHECK(b != a && backend.agents[b] == other_agent);
+    pool.Release(b);
+    CHECK(pool.Acquire(agent, 3) == a && backend.values[a] == 3);
+  }
+
+  if (!errors) {
+    printf("PASS!\n");
+    return 0;
+  } else {
+    printf("fail %d.\n", errors);
+    return -1;
+  }
+}
@@ -0,0 +1,290 @@
+//===- test.cpp -------------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// Loads the portable AIRBINs of 278_portable_airbin_config, and an ELF AIRBIN
+// written by the test, through a mock queue standing in for the device. The
+// mock configures the sections it is handed into a fake AIE address space,
+// which is compared against the AIRBIN decoded independently.
+
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "airbin_loader.h"
+
+using air::AirbinImage;
+using air::AirbinLoader;
+using air::AirbinLoadQueue;
+
+int errors = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("[ERROR] %s:%d: %s\n", __FILE__, __LINE__, #cond);                \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+// Finishes one submitted table every `latency` polls, copying its sections to
+// `memory` the way the device firmware does.
+class MockQueue : public AirbinLoadQueue {
+public:
+  explicit MockQueue(uint32_t latency = 2) : latency(latency) {}
+
+  bool Submit(airbin_table_entry *table) override {
+    if (fail_after && tables.size() == fail_after)
+      return false;
+    if (completed > 0)
+      overlapped = true;
+    tables.push_back(table);
+    return true;
+  }
+
+  uint32_t Completed() override {
+    if (completed < tables.size() && ++polls % latency == 0)
+      Configure(tables[completed++]);
+    return completed;
+  }
+
+  void Configure(airbin_table_entry *table) {
+    for (airbin_table_entry *e = table; e->size; e++) {
+      uint8_t *src = (uint8_t *)table + e->offset;
+      memory[e->addr].assign(src, src + e->size);
+    }
+  }
+
+  std::map<uint64_t, std::vector<uint8_t>> memory;
+  std::vector<airbin_table_entry *> tables;
+  uint32_t latency;
+  uint32_t polls = 0;
+  uint32_t completed = 0;
+  size_t fail_after = 0;
+  // The device finished a table while later ones were still being copied
+  bool overlapped = false;
+};
+
+struct Expected {
+  uint64_t addr;
+  std::vector<uint8_t> data;
+};
+
+// Decodes a portable AIRBIN the same way 278_portable_airbin_config does
+std::vector<Expected> read_portable(const char *filename) {
+  std::vector<Expected> sections;
+  std::ifstream infile(filename);
+  if (!infile) {
+    printf("[ERROR] Can't open %s, run the test from its own directory\n",
+           filename);
+    errors++;
+    return sections;
+  }
+  char field[9] = {0};
+  infile.seekg(22);
+  infile.read(field, 2);
+  field[2] = 0;
+  uint32_t num_ch = std::stoul(field, nullptr, 16);
+  infile.read(field, 8);
+  uint32_t chcfg = std::stoul(field, nullptr, 16);
+
+  for (uint32_t i = 0; i < num_ch; i++) {
+    uint32_t w[8];
+    infile.clear();
+    infile.seekg(chcfg + 1 + i * 72);
+    for (int j = 0; j < 8; j++)
+      infile >> std::hex >> w[j];
+    if (!w[1])
+      continue;
+    uint32_t row = i < 6 ? 0 : 1 + (i - 6) / 8;
+    Expected e;
+    e.addr = ((uint64_t)row << 18) | w[3];
+    e.data.assign(w[7], 0);
+    infile.seekg(w[5]);
+    if (w[0] != 11) {
+      std::string desc;
+      std::getline(infile, desc);
+    }
+    uint32_t *words = (uint32_t *)e.data.data();
+    for (uint32_t j = 0; j < w[7] / 4; j++)
+      if (!(infile >> std::hex >> words[j]))
+        words[j] = 0;
+    sections.push_back(e);
+  }
+  return sections;
+}
+
+// Writes an ELF AIRBIN with two loadable sections, one of them spanning
+// several chunks, and two sections the loader must skip
+std::vector<Expected> write_elf(const char *filename) {
+  const char strtab[] = "\0.text\0.data\0.comment\0.bss\0.shstrtab";
+  std::vector<Expected> loadable = {{0x20000, std::vector<uint8_t>(100)},
+                                    {0x1000, std::vector<uint8_t>(70000)}};
+  for (Expected &e : loadable)
+    for (size_t i = 0; i < e.data.size(); i++)
+      e.data[i] = i * 7 + e.addr;
+  std::vector<uint8_t> comment(16, 'c');
+
+  std::vector<uint8_t> file(sizeof(Elf64_Ehdr));
+  auto append = [&](const void *p, size_t n) {
+    size_t offset = file.size();
+    file.insert(file.end(), (const uint8_t *)p, (const uint8_t *)p + n);
+    return offset;
+  };
+
+  Elf64_Shdr shdrs[6];
+  memset(shdrs, 0, sizeof(shdrs));
+  const uint32_t names[] = {0, 1, 7, 13, 22, 27};
+  for (int i = 0; i < 6; i++)
+    shdrs[i].sh_name = names[i];
+  for (int i = 0; i < 2; i++) {
+    shdrs[i + 1].sh_type = SHT_PROGBITS;
+    shdrs[i + 1].sh_flags = SHF_ALLOC;
+    shdrs[i + 1].sh_addr = loadable[i].addr;
+    shdrs[i + 1].sh_size = loadable[i].data.size();
+    shdrs[i + 1].sh_offset =
+        append(loadable[i].data.data(), loadable[i].data.size());
+  }
+  shdrs[3].sh_type = SHT_PROGBITS;
+  shdrs[3].sh_size = comment.size();
+  shdrs[3].sh_offset = append(comment.data(), comment.size());
+  shdrs[4].sh_type = SHT_NOBITS;
+  shdrs[4].sh_flags = SHF_ALLOC;
+  shdrs[4].sh_size = 4096;
+  shdrs[5].sh_type = SHT_STRTAB;
+  shdrs[5].sh_size = sizeof(strtab);
+  shdrs[5].sh_offset = append(strtab, sizeof(strtab));
+
+  Elf64_Ehdr ehdr;
+  memset(&ehdr, 0, sizeof(ehdr));
+  memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+  ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+  ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+  ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+  ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+  ehdr.e_shentsize = sizeof(Elf64_Shdr);
+  ehdr.e_shnum = 6;
+  ehdr.e_shstrndx = 5;
+  file.resize((file.size() + 7) & ~7);
+  ehdr.e_shoff = append(shdrs, sizeof(shdrs));
+  memcpy(file.data(), &ehdr, sizeof(ehdr));
+
+  std::ofstream out(filename, std::ios::binary);
+  out.write((const char *)file.data(), file.size());
+  return loadable;
+}
+
+// Loads `filename` and compares what the mock device was configured with
+void check_load(const char *filename, const std::vector<Expected> &expected,
+                size_t chunk_size) {
+  AirbinImage image;
+  CHECK(image.Open(filename));
+  CHECK(image.sections().size() == expected.size());
+
+  AirbinLoader loader(image, chunk_size);
+  size_t data_size = 0;
+  for (const Expected &e : expected)
+    data_size += (e.data.size() + 15) & ~15;
+  CHECK(loader.StagingSize() == data_size + (expected.size() +
+                                             loader.NumBatches()) *
+                                                sizeof(airbin_table_entry));
+
+  // Guard bytes past the end catch the staging buffer being undersized
+  std::vector<uint8_t> staging(loader.StagingSize() + 64, 0xa5);
+  MockQueue queue;
+  CHECK(loader.Load(staging.data(), &queue));
+  CHECK(queue.completed == loader.NumBatches());
+  for (size_t i = loader.StagingSize(); i < staging.size(); i++)
+    CHECK(staging[i] == 0xa5);
+
+  for (const Expected &e : expected) {
+    CHECK(queue.memory.count(e.addr));
+    CHECK(queue.memory[e.addr] == e.data);
+  }
+
+  CHECK(loader.timings().size() == expected.size());
+  for (const air::AirbinSectionTiming &t : loader.timings())
+    CHECK(t.config_sec > 0.0);
+  if (loader.NumBatches() > 1)
+    CHECK(queue.overlapped);
+  loader.PrintTimings();
+}
+
+int main(int argc, char **argv) {
+  const char *airbins[] = {"../278_portable_airbin_config/addone.airbin",
+                           "../278_portable_airbin_config/matadd.airbin"};
+  if (argc == 3) {
+    airbins[0] = argv[1];
+    airbins[1] = argv[2];
+  }
+
+  for (const char *airbin : airbins) {
+    std::vector<Expected> expected = read_portable(airbin);
+    CHECK(expected.size() == 17);
+    if (expected.empty())
+      continue;
+
+    // The default single table, one batch, a batch per section and
+    // somewhere in between
+    for (size_t chunk_size : {AirbinLoader::kSingleTable, (size_t)1 << 20,
+                              (size_t)1, (size_t)4096})
+      check_load(airbin, expected, chunk_size);
+    {
+      AirbinImage image;
+      CHECK(image.Open(airbin));
+      CHECK(AirbinLoader(image).NumBatches() == 1);
+    }
+
+    // The program memory of the only core tile with a program
+    AirbinImage image;
+    CHECK(image.Open(airbin));
+    bool found = false;
+    for (const air::AirbinSection &s : image.sections())
+      if (s.name == ".prgm.mem" && s.addr == ((2 << 18) | 0x20000))
+        found = s.size == 0x4000;
+    CHECK(found);
+  }
+
+  const char *elf_name = "test.elf.airbin";
+  std::vector<Expected> expected = write_elf(elf_name);
+  for (size_t chunk_size : {AirbinLoader::kSingleTable, (size_t)4096})
+    check_load(elf_name, expected, chunk_size);
+  {
+    AirbinImage image;
+    CHECK(image.Open(elf_name));
+    CHECK(image.sections().size() == 2);
+    if (image.sections().size() == 2) {
+      CHECK(image.sections()[0].name == ".text");
+      CHECK(image.sections()[1].name == ".data");
+    }
+
+    // A failed submission still waits for the tables already submitted
+    AirbinLoader loader(image, 1);
+    std::vector<uint8_t> staging(loader.StagingSize());
+    MockQueue queue;
+    queue.fail_after = 1;
+    CHECK(!loader.Load(staging.data(), &queue));
+    CHECK(queue.completed == 1);
+  }
+  remove(elf_name);
+
+  AirbinImage image;
+  CHECK(!image.Open("does_not_exist.airbin"));
+  CHECK(!image.Open("Makefile"));
+  CHECK(image.sections().empty());
+
+  if (!errors) {
+    printf("PASS!\n");
+    return 0;
+  } else {
+    printf("fail %d.\n", errors);
+    return -1;
+  }
+}
@@ -0,0 +1,174 @@
+//===- test.cpp -------------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// Exercises the resident module registry against a fake backend standing in
+// for dlopen'd modules, so it runs without any hardware.
+
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+#include "module_registry.h"
+
+using air::rocm::ModuleRegistry;
+using air::rocm::ModuleRegistryBackend;
+using air::rocm::ModuleRegistryStats;
+
+int errors = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("[ERROR] %s:%d: %s\n", __FILE__, __LINE__, #cond);                \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+class FakeBackend : public ModuleRegistryBackend {
+public:
+  void Unload(uint64_t handle) override {
+    CHECK(loaded.count(handle));
+    loaded.erase(handle);
+    unloaded.push_back(handle);
+    // The runtime forgets modules it unloads, which must not deadlock
+    if (registry)
+      CHECK(!registry->Remove(handle));
+  }
+
+  std::set<uint64_t> loaded;
+  std::vector<uint64_t> unloaded;
+  ModuleRegistry *registry = nullptr;
+};
+
+int main() {
+
+  const size_t MB = 1024 * 1024;
+
+  // Modules stay resident and are switched between without unloading. Like
+  // a runtime context does, each switch activates the next module and then
+  // deactivates the previous one.
+  {
+    FakeBackend backend;
+    ModuleRegistry registry(&backend, 10 * MB);
+    backend.registry = &registry;
+
+    for (uint64_t m = 1; m <= 3; m++) {
+      backend.loaded.insert(m);
+      registry.Insert(m, 2 * MB);
+      CHECK(registry.IsActive(m));
+      registry.Deactivate(m);
+      CHECK(!registry.IsActive(m));
+    }
+    CHECK(registry.Resident() == std::vector<uint64_t>({3, 2, 1}));
+
+    CHECK(registry.Activate(1));
+    CHECK(registry.IsActive(1));
+    CHECK(registry.Resident() == std::vector<uint64_t>({1, 3, 2}));
+    CHECK(!registry.Activate(42));
+    CHECK(backend.unloaded.empty());
+
+    ModuleRegistryStats stats = registry.GetStats();
+    CHECK(stats.inserted == 3);
+    CHECK(stats.activations == 1);
+    CHECK(stats.resident == 3);
+    CHECK(stats.bytes_resident == 6 * MB);
+
+    // Going over the budget evicts the least recently activated module
+    backend.loaded.insert(4);
+    registry.Insert(4, 5 * MB);
+    CHECK(backend.unloaded == std::vector<uint64_t>({2}));
+    CHECK(!registry.Contains(2));
+    CHECK(registry.Resident() == std::vector<uint64_t>({4, 1, 3}));
+    CHECK(registry.GetStats().bytes_resident == 9 * MB);
+
+    // Shrinking the budget evicts everything but the active modules
+    registry.Deactivate(4);
+    CHECK(registry.Activate(3));
+    registry.SetBudget(0);
+    CHECK(backend.unloaded == std::vector<uint64_t>({2, 4}));
+    CHECK(registry.Resident() == std::vector<uint64_t>({3, 1}));
+
+    // A module active in two contexts stays resident until both let go, and
+    // is evicted as soon as the last one does since the budget is exceeded
+    CHECK(registry.Activate(3));
+    registry.Deactivate(3);
+    CHECK(registry.IsActive(3));
+    registry.Deactivate(1);
+    CHECK(backend.unloaded == std::vector<uint64_t>({2, 4, 1}));
+    registry.Deactivate(3);
+    CHECK(backend.unloaded == std::vector<uint64_t>({2, 4, 1, 3}));
+    registry.Deactivate(3);
+    stats = registry.GetStats();
+    CHECK(stats.evictions == 4);
+    CHECK(stats.resident == 0);
+    CHECK(stats.bytes_resident == 0);
+  }
+
+  // A module larger than the budget still loads, evicting the others
+  {
+    FakeBackend backend;
+    ModuleRegistry registry(&backend, 4 * MB);
+    backend.loaded = {1, 2};
+    registry.Insert(1, 1 * MB);
+    registry.Deactivate(1);
+    registry.Insert(2, 1 * MB);
+    registry.Deactivate(2);
+    backend.loaded.insert(3);
+    registry.Insert(3, 8 * MB);
+    CHECK(backend.unloaded == std::vector<uint64_t>({1, 2}));
+    CHECK(registry.Resident() == std::vector<uint64_t>({3}));
+  }
+
+  // Removed modules are forgotten without being unloaded, and re-inserting a
+  // resident module updates its size
+  {
+    FakeBackend backend;
+    ModuleRegistry registry(&backend);
+    backend.loaded = {1, 2};
+    registry.Insert(1, 1 * MB);
+    registry.Insert(2, 1 * MB);
+    CHECK(registry.Remove(2));
+    CHECK(!registry.Remove(2));
+    CHECK(!registry.IsActive(2));
+    CHECK(backend.unloaded.empty());
+    registry.Insert(1, 3 * MB);
+    CHECK(registry.IsActive(1));
+    ModuleRegistryStats stats = registry.GetStats();
+    CHECK(stats.inserted == 2);
+    CHECK(stats.resident == 1);
+    CHECK(stats.bytes_resident == 3 * MB);
+  }
+
+  // Switching between resident modules only touches the registry
+  {
+    FakeBackend backend;
+    ModuleRegistry registry(&backend);
+    for (uint64_t m = 1; m <= 8; m++)
+      registry.Insert(m, MB);
+
+    const int iterations = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      registry.Activate(1 + (i + 1) % 8);
+      registry.Deactivate(1 + i % 8);
+    }
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    printf("module switch: %.3f us\n", elapsed.count() / iterations);
+    CHECK(registry.GetStats().activations == iterations);
+    CHECK(registry.GetStats().resident == 8);
+  }
+
+  if (!errors) {
+    printf("PASS!\n");
+    return 0;
+  } else {
+    printf("fail %d.\n", errors);
+    return -1;
+  }
+}
@@ -0,0 +1,201 @@
+//===- test.cpp -------------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// Exercises air_wait_all's barrier packets and the ownership of the events
+// they wait on, against a fake device completing barriers and a fake signal
+// backend, so it runs without any hardware.
+
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "air_wait_all.h"
+#include "signal_pool.h"
+
+using air::rocm::SignalPool;
+using air::rocm::SignalPoolBackend;
+using air::rocm::SignalPoolStats;
+
+int errors = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("[ERROR] %s:%d: %s\n", __FILE__, __LINE__, #cond);                \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+class FakeBackend : public SignalPoolBackend {
+public:
+  uint64_t Create(uint64_t /*agent*/, int64_t value) override {
+    uint64_t signal = next++;
+    values[signal] = value;
+    return signal;
+  }
+
+  void Destroy(uint64_t signal) override { values.erase(signal); }
+
+  int64_t Load(uint64_t signal) override { return values[signal]; }
+
+  void Store(uint64_t signal, int64_t value) override {
+    values[signal] = value;
+  }
+
+  // The device completing the packet signalling `signal`
+  void Complete(uint64_t signal) { values[signal]--; }
+
+  std::map<uint64_t, int64_t> values;
+  uint64_t next = 1;
+};
+
+// Completes a barrier once every signal it depends on reached zero
+class FakeTransport {
+public:
+  FakeTransport(FakeBackend &backend, SignalPool &pool)
+      : backend(backend), pool(pool) {}
+
+  uint64_t acquire_signal() { return pool.Acquire(/*agent=*/1, 1); }
+
+  void release_signal(uint64_t signal) { CHECK(pool.Release(signal)); }
+
+  void post_barrier(const uint64_t *deps, uint64_t signal) {
+    barriers[signal].assign(deps, deps + air::barrier_and_signals);
+    for (size_t i = 0; i < air::barrier_and_signals; i++)
+      null_deps += !deps[i];
+  }
+
+  void wait(uint64_t signal) {
+    CHECK(barriers.count(signal));
+    for (uint64_t dep : barriers[signal])
+      CHECK(!dep || backend.values[dep] == 0);
+    backend.Complete(signal);
+    barriers.erase(signal);
+  }
+
+  std::map<uint64_t, std::vector<uint64_t>> barriers;
+  uint32_t null_deps = 0;
+
+private:
+  FakeBackend &backend;
+  SignalPool &pool;
+};
+
+int main() {
+
+  // One event waited on by two air_wait_all calls is released once, by the
+  // context that issued it
+  {
+    FakeBackend backend;
+    SignalPool pool(&backend);
+    FakeTransport transport(backend, pool);
+
+    air::event_list context_events;
+    uint64_t event = pool.Acquire(/*agent=*/1, 1);
+    context_events.add(event);
+    backend.Complete(event);
+
+    for (int i = 0; i < 2; i++) {
+      air::wait_all(transport, std::vector<uint64_t>{event});
+      context_events.mark_waited({event});
+      context_events.reap([&](uint64_t e) { CHECK(pool.Release(e)); });
+    }
+    CHECK(transport.barriers.empty());
+
+    // Only the event is still referenced, so it is not handed out again
+    SignalPoolStats stats = pool.GetStats();
+    CHECK(stats.acquired == 3);
+    CHECK(stats.live == 1 && stats.pooled == 1);
+    uint64_t other = pool.Acquire(/*agent=*/1, 1);
+    CHECK(other != event);
+    backend.Complete(other);
+    CHECK(pool.Release(other));
+
+    // The context moving on to the next launch
+    context_events.release_all([&](uint64_t e) { CHECK(pool.Release(e)); });
+    CHECK(context_events.size() == 0);
+    stats = pool.GetStats();
+    CHECK(stats.live == 0 && stats.pending == 0);
+    CHECK(stats.pooled == stats.created);
+  }
+
+  // More events than a barrier can wait on take several barriers, and null
+  // events are passed on as null dependencies
+  {
+    FakeBackend backend;
+    SignalPool pool(&backend);
+    FakeTransport transport(backend, pool);
+
+    std::vector<uint64_t> events;
+    for (int i = 0; i < 7; i++) {
+      uint64_t e = pool.Acquire(/*agent=*/1, 1);
+      backend.Complete(e);
+      events.push_back(e);
+    }
+    air::wait_all(transport, events);
+    CHECK(transport.barriers.empty());
+    SignalPoolStats stats = pool.GetStats();
+    CHECK(stats.acquired == 9);
+    CHECK(stats.live == 7);
+    CHECK(transport.null_deps == 3);
+
+    // Nothing to wait on
+    air::wait_all(transport, std::vector<uint64_t>{});
+    CHECK(pool.GetStats().acquired == 9);
+
+    for (uint64_t e : events)
+      CHECK(pool.Release(e));
+    CHECK(pool.GetStats().live == 0);
+  }
+
+  // A launch issuing memcpys and waiting on them over and over only holds on
+  // to a bounded number of signals, and never recycles one that is still
+  // waited on
+  {
+    FakeBackend backend;
+    SignalPool pool(&backend);
+    FakeTransport transport(backend, pool);
+    const size_t max_waited = 8;
+    air::event_list context_events(max_waited);
+    auto release = [&](uint64_t e) { CHECK(pool.Release(e)); };
+
+    // Never waited on, so it stays until the end of the launch
+    uint64_t pinned = pool.Acquire(/*agent=*/1, 1);
+    context_events.add(pinned);
+
+    uint64_t previous = 0;
+    for (int i = 0; i < 1000; i++) {
+      uint64_t event = pool.Acquire(/*agent=*/1, 1);
+      CHECK(event != pinned && event != previous);
+      context_events.add(event);
+      backend.Complete(event);
+      // The previous event is passed to a second wait_all
+      std::vector<uint64_t> events{event};
+      if (previous)
+        events.push_back(previous);
+      air::wait_all(transport, events);
+      context_events.mark_waited(events);
+      context_events.reap(release);
+      CHECK(context_events.size() <= 2 * max_waited + 1);
+      previous = event;
+    }
+    CHECK(pool.GetStats().created <= 2 * max_waited + 3);
+
+    backend.Complete(pinned);
+    context_events.release_all(release);
+    SignalPoolStats stats = pool.GetStats();
+    CHECK(stats.live == 0 && stats.pending == 0);
+  }
+
+  if (!errors) {
+    printf("PASS!\n");
+    return 0;
+  } else {
+    printf("fail %d.\n", errors);
+    return -1;
+  }
+}
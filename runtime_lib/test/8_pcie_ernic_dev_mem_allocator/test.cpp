@@ -0,0 +1,131 @@
+//===- test.cpp -------------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// Exercises the device memory allocator against an anonymous mapping standing
+// in for the device memory BAR, so it runs without any hardware.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "pcie-ernic-dev-mem-allocator.h"
+
+#define DEV_MEM_SIZE 0x100000
+#define SEGMENT_OFFSET 0x1000
+#define GLOBAL_OFFSET 0x800000000
+
+int errors = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("[ERROR] %s:%d: %s\n", __FILE__, __LINE__, #cond);                \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+int main() {
+
+  void *dev_mem = mmap(NULL, DEV_MEM_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (dev_mem == MAP_FAILED) {
+    printf("[ERROR] Failed to map anonymous memory\n");
+    return 1;
+  }
+
+  struct pcie_ernic_dev_mem_allocator *allocator =
+      init_dev_mem_allocator_with_mem(dev_mem, DEV_MEM_SIZE, GLOBAL_OFFSET,
+                                      SEGMENT_OFFSET);
+  CHECK(allocator != NULL);
+  if (allocator == NULL)
+    return 1;
+
+  const uint64_t capacity = DEV_MEM_SIZE - SEGMENT_OFFSET;
+  struct pcie_ernic_dev_mem_stats stats;
+
+  // Allocations are aligned and the PA matches the VA
+  uint64_t pa_a, pa_b, pa_c;
+  void *a = dev_mem_alloc(allocator, 100, &pa_a);
+  void *b = dev_mem_alloc(allocator, 4096, &pa_b);
+  void *c = dev_mem_alloc_aligned(allocator, 256, 4096, &pa_c);
+  CHECK(a != NULL && b != NULL && c != NULL);
+  CHECK(pa_a % DEV_MEM_DEFAULT_ALIGNMENT == 0);
+  CHECK(pa_b % DEV_MEM_DEFAULT_ALIGNMENT == 0);
+  CHECK(pa_c % 4096 == 0);
+  CHECK(pa_b - pa_a == (uint64_t)((char *)b - (char *)a));
+  CHECK(pa_a == GLOBAL_OFFSET + SEGMENT_OFFSET);
+  memset(a, 0xa, 100);
+  memset(b, 0xb, 4096);
+  memset(c, 0xc, 256);
+
+  // Freed memory is reused
+  dev_mem_free(allocator, b);
+  uint64_t pa_d;
+  void *d = dev_mem_alloc(allocator, 2048, &pa_d);
+  CHECK(d == b && pa_d == pa_b);
+
+  // Freeing everything coalesces back into a single block
+  dev_mem_free(allocator, a);
+  dev_mem_free(allocator, c);
+  dev_mem_free(allocator, d);
+  dev_mem_get_stats(allocator, &stats);
+  CHECK(stats.bytes_in_use == 0);
+  CHECK(stats.bytes_free == capacity);
+  CHECK(stats.num_free_blocks == 1);
+  CHECK(stats.fragmentation == 0.0);
+  CHECK(stats.num_allocs == 4 && stats.num_frees == 4);
+
+  // A long running loop of allocations and frees much larger in total than
+  // the device memory does not exhaust it
+  for (int i = 0; i < 10000; i++) {
+    void *p = dev_mem_alloc(allocator, 64 * 1024, NULL);
+    void *q = dev_mem_alloc(allocator, 1000 + i % 3000, NULL);
+    CHECK(p != NULL && q != NULL);
+    dev_mem_free(allocator, p);
+    dev_mem_free(allocator, q);
+  }
+  dev_mem_get_stats(allocator, &stats);
+  CHECK(stats.bytes_in_use == 0 && stats.num_free_blocks == 1);
+  CHECK(stats.high_water_mark < 2 * 64 * 1024);
+
+  // Fill the segment, then free every other buffer: the free space is
+  // fragmented and a request larger than any hole fails
+  void *bufs[16];
+  for (int i = 0; i < 16; i++) {
+    bufs[i] = dev_mem_alloc_aligned(allocator, capacity / 16, 64, NULL);
+    CHECK(bufs[i] != NULL);
+  }
+  CHECK(dev_mem_alloc(allocator, 64, NULL) == NULL);
+  for (int i = 0; i < 16; i += 2)
+    dev_mem_free(allocator, bufs[i]);
+  dev_mem_get_stats(allocator, &stats);
+  CHECK(stats.high_water_mark == capacity);
+  CHECK(stats.num_free_blocks == 8);
+  CHECK(stats.largest_free_block == capacity / 16);
+  CHECK(stats.fragmentation > 0.8);
+  CHECK(dev_mem_alloc(allocator, 2 * capacity / 16, NULL) == NULL);
+
+  // Freeing the rest merges the holes again
+  for (int i = 1; i < 16; i += 2)
+    dev_mem_free(allocator, bufs[i]);
+  dev_mem_get_stats(allocator, &stats);
+  CHECK(stats.num_free_blocks == 1 && stats.largest_free_block == capacity);
+  CHECK(dev_mem_alloc(allocator, capacity, NULL) != NULL);
+
+  dev_mem_print_stats(allocator);
+  free_dev_mem_allocator(allocator);
+  munmap(dev_mem, DEV_MEM_SIZE);
+
+  if (!errors) {
+    printf("PASS!\n");
+    return 0;
+  } else {
+    printf("fail %d.\n", errors);
+    return -1;
+  }
+}
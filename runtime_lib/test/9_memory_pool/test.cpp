@@ -0,0 +1,194 @@
+//===- test.cpp -------------------------------------------------*- C++ -*-===//
+//
+// Copyright (C) 2024, Advanced Micro Devices, Inc.
+// SPDX-License-Identifier: MIT
+//
+//===----------------------------------------------------------------------===//
+
+// Exercises the runtime's caching memory pool against a fake backend standing
+// in for the HSA memory pool, so it runs without any hardware.
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "memory_pool.h"
+
+using air::rocm::MemoryPool;
+using air::rocm::MemoryPoolBackend;
+using air::rocm::MemoryPoolStats;
+
+int errors = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("[ERROR] %s:%d: %s\n", __FILE__, __LINE__, #cond);                \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+// Counts the calls made to it and fails allocations past a capacity
+class FakeBackend : public MemoryPoolBackend {
+public:
+  explicit FakeBackend(size_t capacity = SIZE_MAX) : capacity_(capacity) {}
+
+  void *Allocate(size_t size) override {
+    if (allocated_ + size > capacity_)
+      return nullptr;
+    allocated_ += size;
+    allocations++;
+    void *ptr = malloc(size);
+    sizes_[ptr] = size;
+    return ptr;
+  }
+
+  void Free(void *ptr) override {
+    CHECK(sizes_.count(ptr));
+    allocated_ -= sizes_[ptr];
+    sizes_.erase(ptr);
+    frees++;
+    free(ptr);
+  }
+
+  size_t Outstanding() { return sizes_.size(); }
+
+  int allocations = 0;
+  int frees = 0;
+
+private:
+  size_t capacity_;
+  size_t allocated_ = 0;
+  std::map<void *, size_t> sizes_;
+};
+
+int main() {
+
+  // Bucket sizes
+  CHECK(MemoryPool::BucketSize(1) == MemoryPool::kMinBucketSize);
+  CHECK(MemoryPool::BucketSize(4096) == 4096);
+  CHECK(MemoryPool::BucketSize(4097) == 8192);
+  CHECK(MemoryPool::BucketSize(MemoryPool::kMaxBucketSize) ==
+        MemoryPool::kMaxBucketSize);
+  // Past the largest bucket, sizes are only rounded up to whole pages
+  CHECK(MemoryPool::BucketSize(MemoryPool::kMaxBucketSize + 1) ==
+        MemoryPool::kMaxBucketSize + 4096);
+  CHECK(MemoryPool::BucketSize(6 * 1024 * 1024 + 100) ==
+        6 * 1024 * 1024 + 4096);
+
+  // Steady state: after the first iteration every allocation is a cache hit
+  {
+    FakeBackend backend;
+    MemoryPool pool(&backend);
+    for (int i = 0; i < 100; i++) {
+      void *bounce = pool.Allocate(0x8000);
+      void *input = pool.Allocate(100000);
+      void *output = pool.Allocate(90000);
+      CHECK(bounce && input && output);
+      CHECK(pool.Free(output));
+      CHECK(pool.Free(input));
+      CHECK(pool.Free(bounce));
+    }
+    CHECK(backend.allocations == 3);
+    CHECK(backend.frees == 0);
+    MemoryPoolStats stats = pool.GetStats();
+    CHECK(stats.allocations == 300 && stats.frees == 300);
+    CHECK(stats.hits == 297 && stats.backend_allocations == 3);
+    CHECK(stats.bytes_in_use == 0);
+    CHECK(stats.bytes_cached == 0x8000 + 2 * 131072);
+    CHECK(stats.peak_bytes_in_use == stats.bytes_cached);
+
+    // Pointers the pool did not hand out are rejected
+    int not_from_pool;
+    CHECK(!pool.Free(&not_from_pool));
+
+    pool.Trim();
+    CHECK(backend.frees == 3 && backend.Outstanding() == 0);
+    CHECK(pool.GetStats().bytes_cached == 0);
+  }
+
+  // Large buffers are allocated at their exact size and reused only by
+  // requests of that size
+  {
+    FakeBackend backend;
+    MemoryPool pool(&backend);
+    size_t big = 5 * 1024 * 1024 + 4096;
+    void *a = pool.Allocate(big);
+    CHECK(pool.GetStats().bytes_in_use == big);
+    pool.Free(a);
+    void *b = pool.Allocate(big + 4096);
+    CHECK(b != a && backend.allocations == 2);
+    CHECK(pool.Allocate(big - 100) == a);
+    CHECK(pool.GetStats().bytes_in_use == 2 * big + 4096);
+    pool.Free(a);
+    pool.Free(b);
+    pool.Trim();
+    CHECK(backend.Outstanding() == 0);
+  }
+
+  // The cache limit gives the largest cached buffers back first
+  {
+    FakeBackend backend;
+    MemoryPool pool(&backend, 64 * 1024);
+    void *small = pool.Allocate(4096);
+    void *large = pool.Allocate(64 * 1024);
+    pool.Free(small);
+    pool.Free(large);
+    CHECK(backend.frees == 1);
+    CHECK(pool.GetStats().bytes_cached == 4096);
+    CHECK(pool.Allocate(4096) == small);
+
+    pool.SetCacheLimit(0);
+    void *other = pool.Allocate(8192);
+    pool.Free(other);
+    CHECK(pool.GetStats().bytes_cached == 0);
+    pool.Free(small);
+  }
+
+  // Running out of backend memory releases the cache and retries
+  {
+    FakeBackend backend(64 * 1024);
+    MemoryPool pool(&backend);
+    void *a = pool.Allocate(32 * 1024);
+    void *b = pool.Allocate(32 * 1024);
+    pool.Free(a);
+    pool.Free(b);
+    void *c = pool.Allocate(64 * 1024);
+    CHECK(c != nullptr);
+    CHECK(backend.frees == 2);
+    CHECK(pool.Allocate(64 * 1024) == nullptr);
+    pool.Free(c);
+  }
+
+  // Concurrent users never share a buffer
+  {
+    FakeBackend backend;
+    MemoryPool pool(&backend);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&pool]() {
+        for (int i = 0; i < 1000; i++) {
+          int *p = (int *)pool.Allocate(4096 << (i % 4));
+          *p = i;
+          CHECK(*p == i);
+          pool.Free(p);
+        }
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
+    MemoryPoolStats stats = pool.GetStats();
+    CHECK(stats.allocations == 4000 && stats.bytes_in_use == 0);
+    CHECK(stats.backend_allocations <= 16);
+  }
+
+  if (!errors) {
+    printf("PASS!\n");
+    return 0;
+  } else {
+    printf("fail %d.\n", errors);
+    return -1;
+  }
+}